@@ -173,8 +173,12 @@ typedef enum {
  **Timer Handle structure containing details of a timer.
  */
 typedef struct phOsalNfc_TimerHandle {
-  uint32_t TimerId;     /* ID of the timer */
-  timer_t hTimerHandle; /* Handle of the timer */
+  uint32_t TimerId; /* ID of the timer */
+  uint64_t qwExpiry; /* Expiry tick of the timer wheel, in ms */
+  uint16_t wWheelSlot; /* Wheel slot holding the timer, level * 64 + slot */
+  /* Links in the timer wheel slot, or in the free list while unused */
+  struct phOsalNfc_TimerHandle* pNext;
+  struct phOsalNfc_TimerHandle* pPrev;
   /* Timer callback function to be invoked */
   pphOsalNfc_TimerCallbck_t Application_callback;
   void* pContext; /* Parameter to be passed to the callback function */
@@ -25,6 +25,8 @@
 #include <dlfcn.h>
 #include <phNxpConfig.h>
 #include <string.h>
+/* Stride of the reads faulting the firmware image in */
+#define PHDNLDNFC_PAGE_SIZE (4096U)
 static void*
     pFwLibHandle;    /* Global firmware lib handle used in this file only */
 uint16_t wMwVer = 0; /* Middleware version no */
@@ -943,6 +945,113 @@ void phDnldNfc_CloseFwLibHandle(void) {
   return;
 }
 
+/*******************************************************************************
+**
+** Function         phDnldNfc_GetDefaultFwPath
+**
+** Description      Gives the path of the firmware library of the chip type,
+**                  used when NXP_FW_NAME is not configured
+**
+** Parameters       pPathName - path buffer
+**                  wLen      - size of the path buffer
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phDnldNfc_GetDefaultFwPath(char* pPathName, size_t wLen) {
+#if (defined(__arm64__) || defined(__aarch64__) || defined(_M_ARM64))
+  strlcpy(pPathName, "/vendor/lib64/", wLen);
+#else
+  strlcpy(pPathName, "/vendor/lib/", wLen);
+#endif
+  if (nfcFL.chipType == pn548C2) {
+    strlcat(pPathName, "libpn548ad_fw.so", wLen);
+  } else if (nfcFL.chipType == pn551) {
+    strlcat(pPathName, "libpn551_fw.so", wLen);
+  } else if (nfcFL.chipType == pn553) {
+    strlcat(pPathName, "libpn553_fw.so", wLen);
+  } else if (nfcFL.chipType == pn557) {
+    strlcat(pPathName, "libpn557_fw.so", wLen);
+  } else {
+    strlcat(pPathName, "libpn547_fw.so", wLen);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phDnldNfc_PrefetchFW
+**
+** Description      Maps the firmware library phDnldNfc_InitImgInfo would load
+**                  and reads its image, so that loading it later does not
+**                  wait for storage. The download context is not modified,
+**                  the library stays mapped until
+**                  phDnldNfc_ReleasePrefetchedFW.
+**
+** Parameters       pHandle - library handle, NULL if not mapped
+**
+** Returns          NFC status
+**
+*******************************************************************************/
+NFCSTATUS phDnldNfc_PrefetchFW(void** pHandle) {
+  char fwFileName[128] = {0};
+  char fwpathName[256] = {0};
+  const volatile uint8_t* pImage = NULL;
+  void* pImageInfo = NULL;
+  void* pImageInfoLen = NULL;
+  uint16_t wImageLen;
+  uint8_t bSum = 0;
+  uint32_t i;
+
+  *pHandle = NULL;
+  if (GetNxpStrValue(NAME_NXP_FW_NAME, (char*)fwFileName, sizeof(fwFileName)) ==
+      true) {
+    strlcpy(fwpathName, FW_DLL_ROOT_DIR, sizeof(fwpathName));
+    strlcat(fwpathName, fwFileName, sizeof(fwpathName));
+  } else {
+    phDnldNfc_GetDefaultFwPath(fwpathName, sizeof(fwpathName));
+  }
+
+  *pHandle = dlopen(fwpathName, RTLD_LAZY);
+  if (*pHandle == NULL) {
+    NXPLOG_FWDNLD_E("Prefetch of %s failed", fwpathName);
+    return NFCSTATUS_FAILED;
+  }
+  dlerror(); /* Clear any existing error */
+  pImageInfo = dlsym(*pHandle, "gphDnldNfc_DlSeq");
+  pImageInfoLen = dlsym(*pHandle, "gphDnldNfc_DlSeqSz");
+  if (dlerror() || (NULL == pImageInfo) || (NULL == pImageInfoLen)) {
+    /* Reported when the library is loaded */
+    return NFCSTATUS_SUCCESS;
+  }
+  pImage = *(uint8_t**)pImageInfo;
+  wImageLen = *(uint16_t*)pImageInfoLen;
+  for (i = 0; (pImage != NULL) && (i < wImageLen); i += PHDNLDNFC_PAGE_SIZE) {
+    bSum ^= pImage[i];
+  }
+  NXPLOG_FWDNLD_D("Prefetched %s, %u bytes (%02x)", fwpathName, wImageLen,
+                  bSum);
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         phDnldNfc_ReleasePrefetchedFW
+**
+** Description      Releases the library mapped by phDnldNfc_PrefetchFW, it
+**                  stays mapped if phDnldNfc_LoadFW loaded it meanwhile
+**
+** Parameters       pHandle - library handle
+**
+** Returns          None
+**
+*******************************************************************************/
+void phDnldNfc_ReleasePrefetchedFW(void* pHandle) {
+  if (pHandle != NULL) {
+    dlclose(pHandle);
+    dlerror(); /* Clear any existing error */
+  }
+}
+
 /*******************************************************************************
 **
 ** Function         phDnldNfc_LoadFW
@@ -960,24 +1069,9 @@ NFCSTATUS phDnldNfc_LoadFW(const char* pathName, uint8_t** pImgInfo,
                            uint16_t* pImgInfoLen) {
   void* pImageInfo = NULL;
   void* pImageInfoLen = NULL;
+  char mPathName[50] = {'\0'};
   if (pathName == NULL) {
-    char mPathName[50] = {'\0'};
-    #if (defined(__arm64__) || defined(__aarch64__) || defined(_M_ARM64))
-      strlcpy(mPathName, "/vendor/lib64/", sizeof(mPathName));
-    #else
-      strlcpy(mPathName, "/vendor/lib/", sizeof(mPathName));
-    #endif
-    if(nfcFL.chipType == pn548C2) {
-      strlcat(mPathName, "libpn548ad_fw.so", sizeof(mPathName));
-    } else if(nfcFL.chipType == pn551) {
-      strlcat(mPathName, "libpn551_fw.so", sizeof(mPathName));
-    } else if(nfcFL.chipType == pn553) {
-      strlcat(mPathName, "libpn553_fw.so", sizeof(mPathName));
-    } else if(nfcFL.chipType == pn557) {
-      strlcat(mPathName, "libpn557_fw.so", sizeof(mPathName));
-    } else {
-      strlcat(mPathName, "libpn547_fw.so", sizeof(mPathName));
-    }
+    phDnldNfc_GetDefaultFwPath(mPathName, sizeof(mPathName));
     pathName = mPathName;
   }
 
@@ -1041,24 +1135,9 @@ NFCSTATUS phDnldNfc_LoadRecoveryFW(const char* pathName, uint8_t** pImgInfo,
   void* pImageInfoLen = NULL;
 
   /* check for path name */
+  char mPathName[50] = {'\0'};
   if (pathName == NULL) {
-    char mPathName[50] = {'\0'};
-    #if (defined(__arm64__) || defined(__aarch64__) || defined(_M_ARM64))
-      strlcpy(mPathName, "/vendor/lib64/", sizeof(mPathName));
-    #else
-      strlcpy(mPathName, "/vendor/lib/", sizeof(mPathName));
-    #endif
-    if(nfcFL.chipType == pn548C2) {
-      strlcat(mPathName, "libpn548ad_fw.so", sizeof(mPathName));;
-    } else if(nfcFL.chipType == pn551) {
-      strlcat(mPathName, "libpn551_fw.so", sizeof(mPathName));
-    } else if(nfcFL.chipType == pn553) {
-      strlcat(mPathName, "libpn553_fw.so", sizeof(mPathName));
-    } else if(nfcFL.chipType == pn557) {
-      strlcat(mPathName, "libpn557_fw.so", sizeof(mPathName));
-    } else {
-      strlcat(mPathName, "libpn547_fw.so", sizeof(mPathName));
-    }
+    phDnldNfc_GetDefaultFwPath(mPathName, sizeof(mPathName));
     pathName = mPathName;
   }
   /* check if the handle is not NULL then free the library */
@@ -138,4 +138,6 @@ extern NFCSTATUS phDnldNfc_LoadRecoveryFW(const char* pathName,
                                           uint8_t** pImgInfo,
                                           uint16_t* pImgInfoLen);
 extern NFCSTATUS phDnldNfc_UnloadFW(void);
+extern NFCSTATUS phDnldNfc_PrefetchFW(void** pHandle);
+extern void phDnldNfc_ReleasePrefetchedFW(void* pHandle);
 #endif /* PHDNLDNFC_H */
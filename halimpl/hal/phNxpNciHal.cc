@@ -21,6 +21,7 @@
 #include <phNxpNciHal_Dnld.h>
 #include <phNxpNciHal_Adaptation.h>
 #include <phTmlNfc.h>
+#include <phTmlNfc_stats.h>
 #include <phDnldNfc.h>
 #include <phDal4Nfc_messageQueueLib.h>
 #include <cutils/properties.h>
@@ -90,6 +91,58 @@ static NFCSTATUS phNxpNciHal_FwDwnld(uint16_t aType);
 /* NCI HAL Control structure */
 phNxpNciHal_Control_t nxpncihal_ctrl;
 
+/* Client thread dispatch statistics */
+static phNxpNciHal_DispatchStats_t gDispatchStats;
+static pthread_mutex_t gDispatchStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* CORE_RESET_NTF handed to libnfc-nci once the NFCC is recovered */
+static uint8_t gRecoveryNtf[NCI_MAX_DATA_LEN];
+static uint16_t gRecoveryNtfLen = 0;
+static uint8_t bRecoveryActive = false;
+
+/* Firmware library mapping overlapped with the NFCC initialization */
+static phNxpNciHal_OpenPrefetch_t gOpenPrefetch;
+static pthread_mutex_t gOpenPrefetchMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gOpenPrefetchCond = PTHREAD_COND_INITIALIZER;
+
+/* CORE_SET_CONFIG commands pending during core initialization */
+static phNxpNciHal_SetConfigBatch_t gSetConfigBatch;
+
+/* Parameters of the configuration blocks sent during core initialization */
+#define PHNXPNCIHAL_SENT_PARAMS_MAX 256
+static uint32_t gSentParams[PHNXPNCIHAL_SENT_PARAMS_MAX];
+static uint16_t gSentParamsCount = 0;
+
+/* Data packets queued for the data writer thread */
+static phNxpNciHal_DataTxQueue_t gDataTxQueue;
+static pthread_mutex_t gDataTxMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gDataTxReadyCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t gDataTxDoneCond = PTHREAD_COND_INITIALIZER;
+
+/* Class of the received packets, built for the chip type */
+static uint8_t gRxClass[PHNXPNCIHAL_RX_CLASS_ENTRIES];
+/* Data path workarounds kept in the extension processing */
+static uint8_t gDataExtAllowlist = PHNXPNCIHAL_DATA_EXT_ALL;
+/* Connections whose data packets take the fast path */
+static uint16_t gDataFastConnIds = PHNXPNCIHAL_DATA_FAST_CONN_STATIC_RF;
+
+/* Control packets processed by phNxpNciHal_process_ext_rsp, MT|GID and OID */
+static const uint8_t gRxExtPackets[][2] = {
+    {0x40, 0x00}, /* CORE_RESET_RSP */
+    {0x40, 0x01}, /* CORE_INIT_RSP */
+    {0x40, 0x02}, /* CORE_SET_CONFIG_RSP */
+    {0x41, 0x04}, /* RF_DISCOVER_SELECT_RSP */
+    {0x42, 0x00}, /* NFCEE_DISCOVER_RSP */
+    {0x60, 0x00}, /* CORE_RESET_NTF */
+    {0x61, 0x03}, /* RF_DISCOVER_NTF */
+    {0x61, 0x05}, /* RF_INTF_ACTIVATED_NTF */
+    {0x61, 0x06}, /* RF_DEACTIVATE_NTF */
+    {0x61, 0x07}, /* RF_FIELD_INFO_NTF */
+    {0x61, 0x09}, /* RF_NFCEE_ACTION_NTF */
+    {0x6F, 0x35}, /* LxDebug notifications */
+    {0x6F, 0x36},
+};
+
 /* NXP Poll Profile structure */
 phNxpNciProfile_Control_t nxpprofile_ctrl;
 
@@ -128,6 +181,11 @@ extern uint8_t
     gRecFWDwnld; /* flag  set to true to  indicate dummy FW download */
 static uint8_t gRecFwRetryCount;  // variable to hold dummy FW recovery count
 static uint8_t write_unlocked_status = NFCSTATUS_SUCCESS;
+/* Data packet being written and response built by the extensions, protected
+ * by DATA_LOCK */
+static nci_data_t data_tx;
+static nci_data_t data_rsp;
+/* Last packet received, nxpncihal_ctrl.p_rx_data points here */
 static uint8_t Rx_data[NCI_MAX_DATA_LEN];
 uint32_t timeoutTimerId = 0;
 /*  Used to send Callback Transceive data during Mifare Write.
@@ -145,10 +203,25 @@ static NFCSTATUS phNxpNciHal_fw_download(void);
 tNFC_chipType phNxpNciHal_getChipType(void);
 static void phNxpNciHal_open_complete(NFCSTATUS status);
 static void phNxpNciHal_MinOpen_complete(NFCSTATUS status);
+static int phNxpNciHal_write_data(uint16_t data_len, const uint8_t* p_data);
+static NFCSTATUS phNxpNciHal_write_packet(uint16_t data_len,
+                                          const uint8_t* p_data,
+                                          uint8_t* p_tx_data,
+                                          uint16_t* p_tx_len);
+static void phNxpNciHal_send_icode_eof(void);
+static void phNxpNciHal_data_tx_start(void);
+static void phNxpNciHal_data_tx_stop(void);
+static bool_t phNxpNciHal_data_tx_queue(uint16_t data_len,
+                                        const uint8_t* p_data);
+static void phNxpNciHal_data_tx_flush(void);
 static void phNxpNciHal_write_complete(void* pContext,
                                        phTmlNfc_TransactInfo_t* pInfo);
 static void phNxpNciHal_read_complete(void* pContext,
                                       phTmlNfc_TransactInfo_t* pInfo);
+static void phNxpNciHal_rx_class_init(void);
+static uint8_t phNxpNciHal_rx_class(const uint8_t* p_data, uint16_t data_len);
+static bool phNxpNciHal_rx_ext_required(uint8_t rx_class,
+                                        const uint8_t* p_data);
 static void phNxpNciHal_close_complete(NFCSTATUS status);
 static void phNxpNciHal_core_initialized_complete(NFCSTATUS status);
 static void phNxpNciHal_power_cycle_complete(NFCSTATUS status);
@@ -168,6 +241,8 @@ NFCSTATUS phNxpNciHal_set_china_region_configs(void);
 static void phNxpNciHal_configNciParser(void);
 static void phNxpNciHal_initialize_debug_enabled_flag();
 static void phNxpNciHal_initialize_mifare_flag();
+static void phNxpNciHal_initialize_data_ext_allowlist();
+static void phNxpNciHal_initialize_tml_config(phTmlNfc_Config_t* pConfig);
 static NFCSTATUS phNxpNciHalRFConfigCmdRecSequence();
 static NFCSTATUS phNxpNciHal_CheckRFCmdRespStatus();
 static NFCSTATUS phNxpNciHal_uicc_baud_rate();
@@ -208,132 +283,173 @@ static void phNxpNciHal_initialize_debug_enabled_flag() {
 }
 //static tNfc_featureList phNxpNciHal_getFeatureList();
 /******************************************************************************
- * Function         phNxpNciHal_client_thread
+ * Function         phNxpNciHal_dispatch_msg
  *
- * Description      This function is a thread handler which handles all TML and
- *                  NCI messages.
+ * Description      This function handles one TML or NCI message. Called by
+ *                  the client thread with REENTRANCE_LOCK held.
  *
  * Returns          void
  *
  ******************************************************************************/
-static void* phNxpNciHal_client_thread(void* arg) {
-  phNxpNciHal_Control_t* p_nxpncihal_ctrl = (phNxpNciHal_Control_t*)arg;
-  phLibNfc_Message_t msg;
+static void phNxpNciHal_dispatch_msg(phLibNfc_Message_t* msg) {
+  switch (msg->eMsgType) {
+    case PH_LIBNFC_DEFERREDCALL_MSG: {
+      phLibNfc_DeferredCall_t* deferCall =
+          (phLibNfc_DeferredCall_t*)(msg->pMsgData);
 
-  NXPLOG_NCIHAL_D("thread started");
-
-  p_nxpncihal_ctrl->thread_running = 1;
-
-  while (p_nxpncihal_ctrl->thread_running == 1) {
-    /* Fetch next message from the NFC stack message queue */
-    if (phDal4Nfc_msgrcv(p_nxpncihal_ctrl->gDrvCfg.nClientId, &msg, 0, 0) ==
-        -1) {
-      NXPLOG_NCIHAL_E("NFC client received bad message");
-      continue;
+      deferCall->pCallback(deferCall->pParameter);
+      break;
     }
 
-    if (p_nxpncihal_ctrl->thread_running == 0) {
+    case NCI_HAL_OPEN_CPLT_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        /* Send the event */
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_OPEN_CPLT_EVT,
+                                            HAL_NFC_STATUS_OK);
+      }
       break;
     }
-    switch (msg.eMsgType) {
-      case PH_LIBNFC_DEFERREDCALL_MSG: {
-        phLibNfc_DeferredCall_t* deferCall =
-            (phLibNfc_DeferredCall_t*)(msg.pMsgData);
-
-        REENTRANCE_LOCK();
-        deferCall->pCallback(deferCall->pParameter);
-        REENTRANCE_UNLOCK();
 
-        break;
+    case NCI_HAL_CLOSE_CPLT_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        /* Send the event */
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_CLOSE_CPLT_EVT,
+                                            HAL_NFC_STATUS_OK);
       }
+      phNxpNciHal_kill_client_thread(&nxpncihal_ctrl);
+      break;
+    }
 
-      case NCI_HAL_OPEN_CPLT_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
-          /* Send the event */
-          (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_OPEN_CPLT_EVT,
-                                              HAL_NFC_STATUS_OK);
-        }
-        REENTRANCE_UNLOCK();
-        break;
+    case NCI_HAL_POST_INIT_CPLT_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        /* Send the event */
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_POST_INIT_CPLT_EVT,
+                                            HAL_NFC_STATUS_OK);
       }
+      break;
+    }
 
-      case NCI_HAL_CLOSE_CPLT_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
-          /* Send the event */
-          (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_CLOSE_CPLT_EVT,
-                                              HAL_NFC_STATUS_OK);
-        }
-        phNxpNciHal_kill_client_thread(&nxpncihal_ctrl);
-        REENTRANCE_UNLOCK();
-        break;
+    case NCI_HAL_PRE_DISCOVER_CPLT_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        /* Send the event */
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_PRE_DISCOVER_CPLT_EVT,
+                                            HAL_NFC_STATUS_OK);
       }
+      break;
+    }
 
-      case NCI_HAL_POST_INIT_CPLT_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
-          /* Send the event */
-          (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_POST_INIT_CPLT_EVT,
-                                              HAL_NFC_STATUS_OK);
-        }
-        REENTRANCE_UNLOCK();
-        break;
+    case NCI_HAL_HCI_NETWORK_RESET_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        /* Send the event */
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(
+            (uint32_t)NfcEvent::HCI_NETWORK_RESET, HAL_NFC_STATUS_OK);
       }
+      break;
+    }
 
-      case NCI_HAL_PRE_DISCOVER_CPLT_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
-          /* Send the event */
-          (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_PRE_DISCOVER_CPLT_EVT,
-                                              HAL_NFC_STATUS_OK);
-        }
-        REENTRANCE_UNLOCK();
-        break;
+    case NCI_HAL_ERROR_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        /* Send the event */
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_ERROR_EVT,
+                                            HAL_NFC_STATUS_FAILED);
       }
+      break;
+    }
 
-      case NCI_HAL_HCI_NETWORK_RESET_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
-          /* Send the event */
-          (*nxpncihal_ctrl.p_nfc_stack_cback)(
-              (uint32_t)NfcEvent::HCI_NETWORK_RESET, HAL_NFC_STATUS_OK);
-        }
-        REENTRANCE_UNLOCK();
-        break;
+    case NCI_HAL_RX_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_data_cback != NULL) {
+        (*nxpncihal_ctrl.p_nfc_stack_data_cback)(nxpncihal_ctrl.rsp_len,
+                                                 nxpncihal_ctrl.p_rsp_data);
       }
-
-      case NCI_HAL_ERROR_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
-          /* Send the event */
-          (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_ERROR_EVT,
-                                              HAL_NFC_STATUS_FAILED);
-        }
-        REENTRANCE_UNLOCK();
-        break;
+      break;
+    }
+    case NCI_HAL_POST_MIN_INIT_CPLT_MSG: {
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        /* Send the event */
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_POST_MIN_INIT_CPLT_EVT,
+                                            HAL_NFC_STATUS_OK);
       }
+      break;
+    }
+  }
+}
 
-      case NCI_HAL_RX_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_data_cback != NULL) {
-          (*nxpncihal_ctrl.p_nfc_stack_data_cback)(nxpncihal_ctrl.rsp_len,
-                                                   nxpncihal_ctrl.p_rsp_data);
-        }
-        REENTRANCE_UNLOCK();
-        break;
-      }
-      case NCI_HAL_POST_MIN_INIT_CPLT_MSG: {
-        REENTRANCE_LOCK();
-        if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
-          /* Send the event */
-          (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_POST_MIN_INIT_CPLT_EVT,
-                                              HAL_NFC_STATUS_OK);
-        }
-        REENTRANCE_UNLOCK();
+/******************************************************************************
+ * Function         phNxpNciHal_record_batch
+ *
+ * Description      This function accounts a batch of messages dispatched by
+ *                  the client thread in one wakeup.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpNciHal_record_batch(uint32_t batch) {
+  uint8_t bucket = 0;
+
+  while ((bucket < PHNXPNCIHAL_DISPATCH_BUCKETS - 1) &&
+         ((batch >> (bucket + 1)) != 0)) {
+    bucket++;
+  }
+  pthread_mutex_lock(&gDispatchStatsMutex);
+  gDispatchStats.dwBatches++;
+  gDispatchStats.dwMessages += batch;
+  if (batch > gDispatchStats.dwMaxBatch) {
+    gDispatchStats.dwMaxBatch = batch;
+  }
+  if (batch >= PHNXPNCIHAL_DISPATCH_BATCH_MAX) {
+    gDispatchStats.dwCapped++;
+  }
+  gDispatchStats.aHistogram[bucket]++;
+  pthread_mutex_unlock(&gDispatchStatsMutex);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_client_thread
+ *
+ * Description      This function is a thread handler which handles all TML and
+ *                  NCI messages. Once woken up, it dispatches all the messages
+ *                  already queued, up to PHNXPNCIHAL_DISPATCH_BATCH_MAX, under
+ *                  a single REENTRANCE_LOCK.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void* phNxpNciHal_client_thread(void* arg) {
+  phNxpNciHal_Control_t* p_nxpncihal_ctrl = (phNxpNciHal_Control_t*)arg;
+  phLibNfc_Message_t msg;
+  uint32_t batch;
+
+  NXPLOG_NCIHAL_D("thread started");
+
+  p_nxpncihal_ctrl->thread_running = 1;
+
+  while (p_nxpncihal_ctrl->thread_running == 1) {
+    /* Fetch next message from the NFC stack message queue */
+    if (phDal4Nfc_msgrcv(p_nxpncihal_ctrl->gDrvCfg.nClientId, &msg, 0, 0) ==
+        -1) {
+      if (errno == EIDRM) {
         break;
       }
+      NXPLOG_NCIHAL_E("NFC client received bad message");
+      continue;
     }
+
+    if (p_nxpncihal_ctrl->thread_running == 0) {
+      break;
+    }
+    batch = 0;
+    REENTRANCE_LOCK();
+    do {
+      phNxpNciHal_dispatch_msg(&msg);
+      batch++;
+      /* Drain the messages queued meanwhile, without sleeping */
+    } while ((batch < PHNXPNCIHAL_DISPATCH_BATCH_MAX) &&
+             (p_nxpncihal_ctrl->thread_running == 1) &&
+             (phDal4Nfc_msgrcv(p_nxpncihal_ctrl->gDrvCfg.nClientId, &msg, 0,
+                               IPC_NOWAIT) == 0) &&
+             (p_nxpncihal_ctrl->thread_running == 1));
+    REENTRANCE_UNLOCK();
+    phNxpNciHal_record_batch(batch);
   }
 
   NXPLOG_NCIHAL_D("NxpNciHal thread stopped");
@@ -807,6 +923,7 @@ int phNxpNciHal_MinInit(nfc_stack_callback_t* p_cback,
   tOsalConfig.dwCallbackThreadId = (uintptr_t)nxpncihal_ctrl.gDrvCfg.nClientId;
   tOsalConfig.pLogFile = NULL;
   tTmlConfig.dwGetMsgThreadId = (uintptr_t)nxpncihal_ctrl.gDrvCfg.nClientId;
+  phNxpNciHal_initialize_tml_config(&tTmlConfig);
 
   /* Initialize TML layer */
   status = phTmlNfc_Init(&tTmlConfig);
@@ -867,6 +984,121 @@ int phNxpNciHal_MinInit(nfc_stack_callback_t* p_cback,
   return status;
 }
 
+/******************************************************************************
+ * Function         phNxpNciHal_open_prefetch_thread
+ *
+ * Description      This function maps the firmware library while the NFCC is
+ *                  reset and initialized. Without NXP_FW_NAME the library is
+ *                  named after the chip type, which is known once the NFCC
+ *                  reported its hardware version.
+ *
+ * Returns          NULL.
+ *
+ ******************************************************************************/
+static void* phNxpNciHal_open_prefetch_thread(void* arg) {
+  UNUSED(arg);
+  void* pFwHandle = NULL;
+  bool_t bCancel;
+
+  pthread_mutex_lock(&gOpenPrefetchMutex);
+  while (gOpenPrefetch.bWaitChipType && !gOpenPrefetch.bChipTypeKnown &&
+         !gOpenPrefetch.bCancel) {
+    pthread_cond_wait(&gOpenPrefetchCond, &gOpenPrefetchMutex);
+  }
+  bCancel = gOpenPrefetch.bCancel;
+  pthread_mutex_unlock(&gOpenPrefetchMutex);
+
+  if (!bCancel) {
+    (void)phDnldNfc_PrefetchFW(&pFwHandle);
+  }
+  /* Read by phNxpNciHal_open_prefetch_release after the join */
+  gOpenPrefetch.pFwHandle = pFwHandle;
+  return NULL;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_open_prefetch_start
+ *
+ * Description      This function starts the open prefetch worker. Open does
+ *                  not depend on it, it goes on without it if it cannot be
+ *                  started.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_open_prefetch_start(void) {
+  char fwFileName[128] = {0};
+
+  pthread_mutex_lock(&gOpenPrefetchMutex);
+  gOpenPrefetch.bStarted = false;
+  gOpenPrefetch.bWaitChipType =
+      !GetNxpStrValue(NAME_NXP_FW_NAME, fwFileName, sizeof(fwFileName));
+  gOpenPrefetch.bChipTypeKnown = false;
+  gOpenPrefetch.bCancel = false;
+  gOpenPrefetch.pFwHandle = NULL;
+  pthread_mutex_unlock(&gOpenPrefetchMutex);
+
+  if (pthread_create(&gOpenPrefetch.thread, NULL,
+                     phNxpNciHal_open_prefetch_thread, NULL) != 0) {
+    NXPLOG_NCIHAL_E("Open prefetch thread creation failed");
+    return;
+  }
+  pthread_setname_np(gOpenPrefetch.thread, "NxpOpenPrefetch");
+  gOpenPrefetch.bStarted = true;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_open_prefetch_chip_type_known
+ *
+ * Description      This function lets the open prefetch worker name the
+ *                  firmware library after the chip type just configured.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_open_prefetch_chip_type_known(void) {
+  pthread_mutex_lock(&gOpenPrefetchMutex);
+  gOpenPrefetch.bChipTypeKnown = true;
+  pthread_cond_signal(&gOpenPrefetchCond);
+  pthread_mutex_unlock(&gOpenPrefetchMutex);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_open_prefetch_join
+ *
+ * Description      This function waits for the open prefetch worker. A worker
+ *                  still waiting for the chip type gives up.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_open_prefetch_join(void) {
+  if (!gOpenPrefetch.bStarted) {
+    return;
+  }
+  pthread_mutex_lock(&gOpenPrefetchMutex);
+  gOpenPrefetch.bCancel = true;
+  pthread_cond_signal(&gOpenPrefetchCond);
+  pthread_mutex_unlock(&gOpenPrefetchMutex);
+  pthread_join(gOpenPrefetch.thread, NULL);
+  gOpenPrefetch.bStarted = false;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_open_prefetch_release
+ *
+ * Description      This function releases the firmware library mapped by the
+ *                  open prefetch worker, once the firmware check loaded it.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_open_prefetch_release(void) {
+  phNxpNciHal_open_prefetch_join();
+  phDnldNfc_ReleasePrefetchedFW(gOpenPrefetch.pFwHandle);
+  gOpenPrefetch.pFwHandle = NULL;
+}
+
 /******************************************************************************
  * Function         phNxpNciHal_MinOpen
  *
@@ -941,6 +1173,7 @@ int phNxpNciHal_MinOpen() {
 #endif
   /*nci version NCI_VERSION_UNKNOWN version by default*/
   nxpncihal_ctrl.nci_info.nci_version = NCI_VERSION_UNKNOWN;
+  nxpncihal_ctrl.nci_info.max_ctrl_payload = 0;
 
     /*Structure related to set config management*/
   mGetCfg_info = NULL;
@@ -970,6 +1203,13 @@ int phNxpNciHal_MinOpen() {
   tOsalConfig.dwCallbackThreadId = (uintptr_t)nxpncihal_ctrl.gDrvCfg.nClientId;
   tOsalConfig.pLogFile = NULL;
   tTmlConfig.dwGetMsgThreadId = (uintptr_t)nxpncihal_ctrl.gDrvCfg.nClientId;
+  phNxpNciHal_initialize_tml_config(&tTmlConfig);
+
+  /* Map the firmware library while TML and the NFCC come up */
+  phNxpNciHal_open_prefetch_start();
+
+  phNxpNciHal_rx_class_init();
+  phNxpNciHal_initialize_data_ext_allowlist();
 
   /* Initialize TML layer */
   wConfigStatus = phTmlNfc_Init(&tTmlConfig);
@@ -992,6 +1232,8 @@ int phNxpNciHal_MinOpen() {
     goto minCleanAndreturn;
   }
 
+  phNxpNciHal_data_tx_start();
+
   CONCURRENCY_UNLOCK();
 
   /* call read pending */
@@ -1054,6 +1296,7 @@ init_retry:
   }
   phNxpNciHal_conf_nfc_forum_mode();
 
+  phNxpNciHal_open_prefetch_join();
   if (!nxpncihal_ctrl.bIsForceFwDwnld) {
     phNxpNciHal_CheckFwRegFlashRequired(&fwFlashReq, &rfUpdateReq);
   } else {
@@ -1078,11 +1321,13 @@ init_retry:
     }
   }
 
+  phNxpNciHal_open_prefetch_release();
   phNxpNciHal_MinOpen_complete(wConfigStatus);
   NXPLOG_NCIHAL_D("phNxpNciHal_MinOpen(): exit");
   return wConfigStatus;
 
 force_download:
+  phNxpNciHal_open_prefetch_join();
   wFwVerRsp = 0;
   status = phNxpNciHal_FwDwnld(NFC_STATUS_NOT_INITIALIZED);
   if (status == NFCSTATUS_SUCCESS) {
@@ -1094,6 +1339,8 @@ force_download:
 
 minCleanAndreturn:
   CONCURRENCY_UNLOCK();
+  phNxpNciHal_data_tx_stop();
+  phNxpNciHal_open_prefetch_release();
   if (nfc_dev_node != NULL) {
     free(nfc_dev_node);
     nfc_dev_node = NULL;
@@ -1152,6 +1399,8 @@ int phNxpNciHal_open(nfc_stack_callback_t* p_cback,
   if (nxpncihal_ctrl.halStatus == HAL_STATUS_CLOSE) {
     memset(&nxpncihal_ctrl, 0x00, sizeof(nxpncihal_ctrl));
     memset(&nxpprofile_ctrl, 0, sizeof(phNxpNciProfile_Control_t));
+    /* A recovery of the previous session ends with it */
+    __atomic_store_n(&bRecoveryActive, false, __ATOMIC_RELEASE);
     wConfigStatus = phNxpNciHal_MinOpen();
     if (wConfigStatus != NFCSTATUS_SUCCESS) {
       NXPLOG_NCIHAL_E("phNxpNciHal_MinOpen failed");
@@ -1291,6 +1540,10 @@ int phNxpNciHal_write_internal(uint16_t data_len, const uint8_t* p_data) {
   NFCSTATUS status = NFCSTATUS_FAILED;
   static phLibNfc_Message_t msg;
 
+  if ((p_data[0] & NCI_MT_MASK) == NCI_MT_DATA) {
+    return phNxpNciHal_write_data(data_len, p_data);
+  }
+
   CONCURRENCY_LOCK();
 
   if (nxpncihal_ctrl.halStatus != HAL_STATUS_OPEN) {
@@ -1331,6 +1584,141 @@ int phNxpNciHal_write_internal(uint16_t data_len, const uint8_t* p_data) {
   data_len = phNxpNciHal_write_unlocked(nxpncihal_ctrl.cmd_len,
                                         nxpncihal_ctrl.p_cmd_data);
 
+  phNxpNciHal_send_icode_eof();
+
+clean_and_return:
+  CONCURRENCY_UNLOCK();
+  /* No data written */
+  return data_len;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_tx_ext_required
+ *
+ * Description      This function checks if a data packet has to go through
+ *                  phNxpNciHal_write_ext. Data packets on the fast path
+ *                  connections only do for the allowlisted data path
+ *                  workarounds, the others are written as they are.
+ *
+ * Returns          true if the extensions process the packet.
+ *
+ ******************************************************************************/
+static bool phNxpNciHal_tx_ext_required(uint16_t data_len,
+                                        const uint8_t* p_data) {
+  if (!(gDataFastConnIds & (1 << PHNXPNCIHAL_DATA_CONN_ID(p_data[0])))) {
+    return true;
+  }
+  if ((gDataExtAllowlist & PHNXPNCIHAL_DATA_EXT_ICODE) && icode_detected) {
+    return true;
+  }
+  if ((gDataExtAllowlist & PHNXPNCIHAL_DATA_EXT_T1T_DTA) &&
+      phNxpDta_IsEnable()) {
+    return true;
+  }
+  /* ANY_SET_PARAMETER of the WHITELIST on the HCI admin pipe */
+  return (gDataExtAllowlist & PHNXPNCIHAL_DATA_EXT_HCI) &&
+         (data_len > NCI_HEADER_SIZE + 2) && (p_data[3] == 0x81) &&
+         (p_data[4] == 0x01) && (p_data[5] == 0x03);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_write_data
+ *
+ * Description      This function writes an NCI data packet. Data packets are
+ *                  serialized by DATA_LOCK and use their own buffers, so they
+ *                  are not held back by a command sequence waiting for its
+ *                  response under CONCURRENCY_LOCK. Packets not concerned by
+ *                  the data path workarounds skip the extension processing.
+ *
+ * Returns          It returns number of bytes successfully written to NFCC.
+ *
+ ******************************************************************************/
+static int phNxpNciHal_write_data(uint16_t data_len, const uint8_t* p_data) {
+  NFCSTATUS status = NFCSTATUS_FAILED;
+  static phLibNfc_Message_t msg;
+
+  DATA_LOCK();
+
+  if (nxpncihal_ctrl.halStatus != HAL_STATUS_OPEN) {
+    DATA_UNLOCK();
+    return NFCSTATUS_FAILED;
+  }
+
+  if (data_len + MAX_NXP_HAL_EXTN_BYTES > NCI_MAX_DATA_LEN) {
+    NXPLOG_NCIHAL_D("data_len exceeds limit NCI_MAX_DATA_LEN");
+    goto clean_and_return;
+  }
+
+  if (!phNxpNciHal_tx_ext_required(data_len, p_data)) {
+    /* Fast path, the packet is written as it is */
+    if (!phNxpNciHal_data_tx_queue(data_len, p_data)) {
+      phNxpNciHal_data_tx_flush();
+      if (phNxpNciHal_write_packet(data_len, p_data, data_tx.p_data,
+                                   &data_tx.len) != NFCSTATUS_SUCCESS) {
+        data_len = 0;
+      }
+    }
+    goto clean_and_return;
+  }
+
+  data_tx.len = data_len;
+  memcpy(data_tx.p_data, p_data, data_len);
+
+  /* Check for NXP ext before sending write */
+  status = phNxpNciHal_write_ext(&data_tx.len, data_tx.p_data, &data_rsp.len,
+                                 data_rsp.p_data);
+  if (status != NFCSTATUS_SUCCESS) {
+    /* Do not send packet to PN54X, send response directly */
+    CONCURRENCY_LOCK();
+    nxpncihal_ctrl.rsp_len = data_rsp.len;
+    memcpy(nxpncihal_ctrl.p_rsp_data, data_rsp.p_data, data_rsp.len);
+    CONCURRENCY_UNLOCK();
+    msg.eMsgType = NCI_HAL_RX_MSG;
+    msg.pMsgData = NULL;
+    msg.Size = 0;
+
+    phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId,
+                          (phLibNfc_Message_t*)&msg);
+    goto clean_and_return;
+  }
+
+  if ((icode_send_eof != 1) &&
+      phNxpNciHal_data_tx_queue(data_tx.len, data_tx.p_data)) {
+    goto clean_and_return;
+  }
+  phNxpNciHal_data_tx_flush();
+  if (phNxpNciHal_write_packet(data_tx.len, data_tx.p_data, data_tx.p_data,
+                               &data_tx.len) == NFCSTATUS_SUCCESS) {
+    data_len = data_tx.len;
+  } else {
+    data_len = 0;
+  }
+
+  if (icode_send_eof == 1) {
+    /* The end of frame goes through the command extension path */
+    CONCURRENCY_LOCK();
+    phNxpNciHal_send_icode_eof();
+    CONCURRENCY_UNLOCK();
+  }
+
+clean_and_return:
+  DATA_UNLOCK();
+  return data_len;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_send_icode_eof
+ *
+ * Description      This function sends the ISO15693 end of frame requested by
+ *                  the extension processing of the last packet written.
+ *                  Called with CONCURRENCY_LOCK held.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_send_icode_eof(void) {
+  NFCSTATUS status;
+
   if (icode_send_eof == 1) {
     usleep(10000);
     icode_send_eof = 2;
@@ -1339,11 +1727,212 @@ int phNxpNciHal_write_internal(uint16_t data_len, const uint8_t* p_data) {
        NXPLOG_NCIHAL_E("ICODE end of frame command failed");
     }
   }
+}
 
-clean_and_return:
-  CONCURRENCY_UNLOCK();
-  /* No data written */
-  return data_len;
+/******************************************************************************
+ * Function         phNxpNciHal_data_tx_failed_cb
+ *
+ * Description      This function reports a queued data packet which could not
+ *                  be written to NFCC. The write was already acknowledged to
+ *                  the upper layer, so it gets a CORE_GENERIC_ERROR_NTF.
+ *                  Runs on the client thread, like the received packets.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_data_tx_failed_cb(void* pContext) {
+  static uint8_t generic_error_ntf[] = {0x60, 0x07, 0x01, 0x03};
+  UNUSED(pContext);
+
+  if (nxpncihal_ctrl.p_nfc_stack_data_cback != NULL &&
+      nxpncihal_ctrl.hal_open_status == true) {
+    NXPLOG_NCIHAL_E("Queued data packet not written, notify upper layer");
+    (*nxpncihal_ctrl.p_nfc_stack_data_cback)(sizeof(generic_error_ntf),
+                                             generic_error_ntf);
+  }
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_data_tx_thread
+ *
+ * Description      This function writes the queued data packets to NFCC in
+ *                  order. A packet keeps its slot until it is written, so
+ *                  the queue bounds the packets not yet accepted by NFCC.
+ *
+ * Returns          NULL.
+ *
+ ******************************************************************************/
+static void* phNxpNciHal_data_tx_thread(void* arg) {
+  static phLibNfc_DeferredCall_t tFailedCall;
+  static phLibNfc_Message_t msg;
+  UNUSED(arg);
+  nci_data_t* p_packet;
+  NFCSTATUS status;
+
+  pthread_mutex_lock(&gDataTxMutex);
+  while (1) {
+    while ((gDataTxQueue.bCount == 0) && !gDataTxQueue.bStop) {
+      pthread_cond_wait(&gDataTxReadyCond, &gDataTxMutex);
+    }
+    if (gDataTxQueue.bCount == 0) {
+      break;
+    }
+    p_packet = &gDataTxQueue.aPackets[gDataTxQueue.bHead];
+    pthread_mutex_unlock(&gDataTxMutex);
+
+    status = phNxpNciHal_write_packet(p_packet->len, p_packet->p_data,
+                                      p_packet->p_data, &p_packet->len);
+    /* A failure after the retries is already reported with a reset NTF */
+    if ((status != NFCSTATUS_SUCCESS) &&
+        (status != NFCSTATUS_BOARD_COMMUNICATION_ERROR)) {
+      tFailedCall.pCallback = &phNxpNciHal_data_tx_failed_cb;
+      tFailedCall.pParameter = NULL;
+      msg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
+      msg.pMsgData = &tFailedCall;
+      msg.Size = sizeof(tFailedCall);
+      phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId, &msg);
+    }
+
+    pthread_mutex_lock(&gDataTxMutex);
+    if (status == NFCSTATUS_SUCCESS) {
+      gDataTxQueue.dwWritten++;
+    } else {
+      gDataTxQueue.dwFailed++;
+    }
+    gDataTxQueue.bHead = (gDataTxQueue.bHead + 1) % PHNXPNCIHAL_DATA_TX_WINDOW;
+    gDataTxQueue.bCount--;
+    pthread_cond_broadcast(&gDataTxDoneCond);
+  }
+  /* Later packets are written by their caller */
+  gDataTxQueue.bRunning = false;
+  pthread_cond_broadcast(&gDataTxDoneCond);
+  pthread_mutex_unlock(&gDataTxMutex);
+  return NULL;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_data_tx_start
+ *
+ * Description      This function starts the data writer thread if
+ *                  NXP_ASYNC_DATA_WRITE is enabled. Data packets are written
+ *                  by their caller if it cannot be started.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_data_tx_start(void) {
+  unsigned long num = 0;
+
+  if (!GetNxpNumValue(NAME_NXP_ASYNC_DATA_WRITE, &num, sizeof(num)) ||
+      (num != 0x01)) {
+    return;
+  }
+  pthread_mutex_lock(&gDataTxMutex);
+  if (gDataTxQueue.bRunning) {
+    pthread_mutex_unlock(&gDataTxMutex);
+    return;
+  }
+  memset(&gDataTxQueue, 0x00, sizeof(gDataTxQueue));
+  gDataTxQueue.bRunning = true;
+
+  if (pthread_create(&gDataTxQueue.thread, NULL, phNxpNciHal_data_tx_thread,
+                     NULL) != 0) {
+    NXPLOG_NCIHAL_E("Data writer thread creation failed");
+    gDataTxQueue.bRunning = false;
+    pthread_mutex_unlock(&gDataTxMutex);
+    return;
+  }
+  pthread_mutex_unlock(&gDataTxMutex);
+  pthread_setname_np(gDataTxQueue.thread, "NxpDataTx");
+  NXPLOG_NCIHAL_D("Asynchronous data write enabled");
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_data_tx_stop
+ *
+ * Description      This function lets the data writer thread write the
+ *                  queued packets and waits for it to exit.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_data_tx_stop(void) {
+  pthread_mutex_lock(&gDataTxMutex);
+  if (!gDataTxQueue.bRunning) {
+    pthread_mutex_unlock(&gDataTxMutex);
+    return;
+  }
+  gDataTxQueue.bStop = true;
+  pthread_cond_signal(&gDataTxReadyCond);
+  pthread_mutex_unlock(&gDataTxMutex);
+
+  pthread_join(gDataTxQueue.thread, NULL);
+  NXPLOG_NCIHAL_D(
+      "Data writer: %u written, %u failed, %u waits, max depth %u",
+      gDataTxQueue.dwWritten, gDataTxQueue.dwFailed, gDataTxQueue.dwWaits,
+      gDataTxQueue.dwMaxDepth);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_data_tx_queue
+ *
+ * Description      This function queues a data packet for the data writer
+ *                  thread, waiting for a free slot if the queue is full.
+ *                  Called with DATA_LOCK held.
+ *
+ * Returns          TRUE if the packet is queued, FALSE if it has to be
+ *                  written by the caller.
+ *
+ ******************************************************************************/
+static bool_t phNxpNciHal_data_tx_queue(uint16_t data_len,
+                                        const uint8_t* p_data) {
+  nci_data_t* p_packet;
+
+  pthread_mutex_lock(&gDataTxMutex);
+  if (!gDataTxQueue.bRunning || gDataTxQueue.bStop) {
+    pthread_mutex_unlock(&gDataTxMutex);
+    return FALSE;
+  }
+  if (gDataTxQueue.bCount == PHNXPNCIHAL_DATA_TX_WINDOW) {
+    gDataTxQueue.dwWaits++;
+    do {
+      pthread_cond_wait(&gDataTxDoneCond, &gDataTxMutex);
+    } while ((gDataTxQueue.bCount == PHNXPNCIHAL_DATA_TX_WINDOW) &&
+             gDataTxQueue.bRunning);
+    if (!gDataTxQueue.bRunning) {
+      pthread_mutex_unlock(&gDataTxMutex);
+      return FALSE;
+    }
+  }
+  p_packet = &gDataTxQueue.aPackets[(gDataTxQueue.bHead +
+                                     gDataTxQueue.bCount) %
+                                    PHNXPNCIHAL_DATA_TX_WINDOW];
+  p_packet->len = data_len;
+  memcpy(p_packet->p_data, p_data, data_len);
+  gDataTxQueue.bCount++;
+  if (gDataTxQueue.bCount > gDataTxQueue.dwMaxDepth) {
+    gDataTxQueue.dwMaxDepth = gDataTxQueue.bCount;
+  }
+  pthread_cond_signal(&gDataTxReadyCond);
+  pthread_mutex_unlock(&gDataTxMutex);
+  return TRUE;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_data_tx_flush
+ *
+ * Description      This function waits until the queued data packets are
+ *                  written, so that the next packet is written after them.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_data_tx_flush(void) {
+  pthread_mutex_lock(&gDataTxMutex);
+  while ((gDataTxQueue.bCount != 0) && gDataTxQueue.bRunning) {
+    pthread_cond_wait(&gDataTxDoneCond, &gDataTxMutex);
+  }
+  pthread_mutex_unlock(&gDataTxMutex);
 }
 
 /******************************************************************************
@@ -1358,56 +1947,120 @@ clean_and_return:
  *
  ******************************************************************************/
 int phNxpNciHal_write_unlocked(uint16_t data_len, const uint8_t* p_data) {
-  NFCSTATUS status = NFCSTATUS_INVALID_PARAMETER;
-  phNxpNciHal_Sem_t cb_data;
-  nxpncihal_ctrl.retry_cnt = 0;
+  /* Commands follow the data packets written before them. The client thread
+   * cannot wait, it delivers the write completions of the writer thread. */
+  if (!pthread_equal(pthread_self(), nxpncihal_ctrl.client_thread)) {
+    phNxpNciHal_data_tx_flush();
+  }
+  if (phNxpNciHal_write_packet(data_len, p_data, nxpncihal_ctrl.p_cmd_data,
+                               &nxpncihal_ctrl.cmd_len) != NFCSTATUS_SUCCESS) {
+    return 0;
+  }
+  return nxpncihal_ctrl.cmd_len;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_write_reset_cb
+ *
+ * Description      This function sends a CORE_RESET_NTF to the upper layer
+ *                  once NFCC was reset for not accepting a packet, which
+ *                  triggers the recovery. Runs on the client thread, like
+ *                  the received packets.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_write_reset_cb(void* pContext) {
   static uint8_t reset_ntf[] = {0x60, 0x00, 0x06, 0xA0, 0x00,
                                 0xC7, 0xD4, 0x00, 0x00};
+  UNUSED(pContext);
+
+  if (nxpncihal_ctrl.p_nfc_stack_data_cback != NULL &&
+      nxpncihal_ctrl.hal_open_status == true) {
+    if (nxpncihal_ctrl.p_rx_data != NULL) {
+      NXPLOG_NCIHAL_D(
+          "Send the Core Reset NTF to upper layer, which will trigger the "
+          "recovery\n");
+      nxpncihal_ctrl.rx_data_len = sizeof(reset_ntf);
+      memcpy(nxpncihal_ctrl.p_rx_data, reset_ntf, sizeof(reset_ntf));
+      (*nxpncihal_ctrl.p_nfc_stack_data_cback)(nxpncihal_ctrl.rx_data_len,
+                                               nxpncihal_ctrl.p_rx_data);
+    } else {
+      (*nxpncihal_ctrl.p_nfc_stack_data_cback)(0x00, NULL);
+    }
+  }
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_write_packet
+ *
+ * Description      This function copies a packet to the given transmit buffer
+ *                  and writes it to NFCC. It waits till write callback
+ *                  provide the result of write process. WRITE_LOCK is held
+ *                  while the packet is pending in TML, the command and data
+ *                  paths use separate transmit buffers. If NFCC does not
+ *                  accept the packet after the retries, it is reset and the
+ *                  reset NTF is posted to the client thread.
+ *
+ * Returns          NFCSTATUS_SUCCESS if the packet was written,
+ *                  NFCSTATUS_BOARD_COMMUNICATION_ERROR if NFCC was reset,
+ *                  NFCSTATUS_FAILED otherwise.
+ *
+ ******************************************************************************/
+static NFCSTATUS phNxpNciHal_write_packet(uint16_t data_len,
+                                          const uint8_t* p_data,
+                                          uint8_t* p_tx_data,
+                                          uint16_t* p_tx_len) {
+  NFCSTATUS status = NFCSTATUS_INVALID_PARAMETER;
+  NFCSTATUS write_status = NFCSTATUS_FAILED;
+  phNxpNciHal_Sem_t cb_data;
+  uint16_t retry_cnt = 0;
+  static phLibNfc_DeferredCall_t tResetCall;
+  static phLibNfc_Message_t msg;
 
   /* Create the local semaphore */
   if (phNxpNciHal_init_cb_data(&cb_data, NULL) != NFCSTATUS_SUCCESS) {
-    NXPLOG_NCIHAL_D("phNxpNciHal_write_unlocked Create cb data failed");
-    data_len = 0;
-    goto clean_and_return;
+    NXPLOG_NCIHAL_D("phNxpNciHal_write_packet Create cb data failed");
+    return NFCSTATUS_FAILED;
   }
 
   /* Create local copy of cmd_data */
-  memcpy(nxpncihal_ctrl.p_cmd_data, p_data, data_len);
-  nxpncihal_ctrl.cmd_len = data_len;
+  if (p_tx_data != p_data) {
+    memcpy(p_tx_data, p_data, data_len);
+  }
+  *p_tx_len = data_len;
 
 
   /* check for write synchronyztion */
-  if(phNxpNciHal_check_ncicmd_write_window(nxpncihal_ctrl.cmd_len,
-                         nxpncihal_ctrl.p_cmd_data) != NFCSTATUS_SUCCESS) {
+  if(phNxpNciHal_check_ncicmd_write_window(*p_tx_len,
+                         p_tx_data) != NFCSTATUS_SUCCESS) {
     NXPLOG_NCIHAL_D("phNxpNciHal_write_unlocked write synchronization failed");
-    data_len = 0;
     goto clean_and_return;
   }
 
-retry:
+  WRITE_LOCK();
 
-  data_len = nxpncihal_ctrl.cmd_len;
+retry:
 
   status = phTmlNfc_Write(
-      (uint8_t*)nxpncihal_ctrl.p_cmd_data, (uint16_t)nxpncihal_ctrl.cmd_len,
+      p_tx_data, *p_tx_len,
       (pphTmlNfc_TransactCompletionCb_t)&phNxpNciHal_write_complete,
       (void*)&cb_data);
   if (status != NFCSTATUS_PENDING) {
+    WRITE_UNLOCK();
     NXPLOG_NCIHAL_E("write_unlocked status error");
-    data_len = 0;
     goto clean_and_return;
   }
 
   /* Wait for callback response */
   if (SEM_WAIT(cb_data)) {
+    WRITE_UNLOCK();
     NXPLOG_NCIHAL_E("write_unlocked semaphore error");
-    data_len = 0;
     goto clean_and_return;
   }
 
   if (cb_data.status != NFCSTATUS_SUCCESS) {
-    data_len = 0;
-    if (nxpncihal_ctrl.retry_cnt++ < MAX_RETRY_COUNT) {
+    if (retry_cnt++ < MAX_RETRY_COUNT) {
       NXPLOG_NCIHAL_D(
           "write_unlocked failed - PN54X Maybe in Standby Mode - Retry");
       if(nfcFL.nfccFL._NFCC_I2C_READ_WRITE_IMPROVEMENT) {
@@ -1419,10 +2072,11 @@ retry:
 }
       goto retry;
     } else {
+      WRITE_UNLOCK();
       NXPLOG_NCIHAL_E(
           "write_unlocked failed - PN54X Maybe in Standby Mode (max count = "
           "0x%x)",
-          nxpncihal_ctrl.retry_cnt);
+          retry_cnt);
       sem_post(&(nxpncihal_ctrl.syncSpiNfc));
 
       status = phTmlNfc_IoCtl(phTmlNfc_e_ResetDevice);
@@ -1434,54 +2088,150 @@ retry:
       }
       if (nxpncihal_ctrl.p_nfc_stack_data_cback != NULL &&
           nxpncihal_ctrl.hal_open_status == true) {
-        if (nxpncihal_ctrl.p_rx_data != NULL) {
-          NXPLOG_NCIHAL_D(
-              "Send the Core Reset NTF to upper layer, which will trigger the "
-              "recovery\n");
-          // Send the Core Reset NTF to upper layer, which will trigger the
-          // recovery.
-          nxpncihal_ctrl.rx_data_len = sizeof(reset_ntf);
-          memcpy(nxpncihal_ctrl.p_rx_data, reset_ntf, sizeof(reset_ntf));
-          (*nxpncihal_ctrl.p_nfc_stack_data_cback)(nxpncihal_ctrl.rx_data_len,
-                                                   nxpncihal_ctrl.p_rx_data);
-        } else {
-          (*nxpncihal_ctrl.p_nfc_stack_data_cback)(0x00, NULL);
-        }
-        write_unlocked_status = NFCSTATUS_FAILED;
+        /* The upper layer and nxpncihal_ctrl.p_rx_data belong to the client
+         * thread, the reset NTF is sent from there */
+        tResetCall.pCallback = &phNxpNciHal_write_reset_cb;
+        tResetCall.pParameter = NULL;
+        msg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
+        msg.pMsgData = &tResetCall;
+        msg.Size = sizeof(tResetCall);
+        phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId, &msg);
+        __atomic_store_n(&write_unlocked_status, NFCSTATUS_FAILED,
+                         __ATOMIC_RELAXED);
       }
+      write_status = NFCSTATUS_BOARD_COMMUNICATION_ERROR;
     }
   } else {
-    write_unlocked_status = NFCSTATUS_SUCCESS;
+    WRITE_UNLOCK();
+    __atomic_store_n(&write_unlocked_status, NFCSTATUS_SUCCESS,
+                     __ATOMIC_RELAXED);
+    write_status = NFCSTATUS_SUCCESS;
+  }
+
+clean_and_return:
+  phNxpNciHal_cleanup_cb_data(&cb_data);
+  return write_status;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_write_complete
+ *
+ * Description      This function handles write callback.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_write_complete(void* pContext,
+                                       phTmlNfc_TransactInfo_t* pInfo) {
+  phNxpNciHal_Sem_t* p_cb_data = (phNxpNciHal_Sem_t*)pContext;
+
+  if (pInfo->wStatus == NFCSTATUS_SUCCESS) {
+    NXPLOG_NCIHAL_D("write successful status = 0x%x", pInfo->wStatus);
+  } else {
+    NXPLOG_NCIHAL_E("write error status = 0x%x", pInfo->wStatus);
+  }
+
+  p_cb_data->status = pInfo->wStatus;
+
+  SEM_POST(p_cb_data);
+
+  return;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_rx_class_init
+ *
+ * Description      This function builds the class table of the received
+ *                  packets for the chip type and features in nfcFL. It is
+ *                  rebuilt whenever the NFCC reports its chip type.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_rx_class_init(void) {
+  uint16_t i;
+
+  memset(gRxClass, 0x00, sizeof(gRxClass));
+  /* Data packets, any connection */
+  for (i = 0; i < PHNXPNCIHAL_RX_CLASS_INDEX(NCI_MT_CMD, 0); i++) {
+    gRxClass[i] = PHNXPNCIHAL_RX_DATA;
+  }
+  /* Reserved message types are left to the extensions */
+  for (i = PHNXPNCIHAL_RX_CLASS_INDEX(0x80, 0); i < PHNXPNCIHAL_RX_CLASS_ENTRIES;
+       i++) {
+    gRxClass[i] = PHNXPNCIHAL_RX_EXT;
+  }
+  for (i = 0; i < sizeof(gRxExtPackets) / sizeof(gRxExtPackets[0]); i++) {
+    gRxClass[PHNXPNCIHAL_RX_CLASS_INDEX(gRxExtPackets[i][0],
+                                        gRxExtPackets[i][1])] |=
+        PHNXPNCIHAL_RX_EXT;
+  }
+  gRxClass[PHNXPNCIHAL_RX_CLASS_INDEX(0x4F, 0x01)] |= PHNXPNCIHAL_RX_OMAPI;
+  if (nfcFL.nfccFL._NFCC_FORCE_NCI1_0_INIT) {
+    for (i = 0; i <= NCI_OID_MASK; i++) {
+      gRxClass[PHNXPNCIHAL_RX_CLASS_INDEX(NCI_MT_NTF, i)] |=
+          PHNXPNCIHAL_RX_CORE_NTF;
+    }
+  }
+  if (nfcFL.chipType == pn557) {
+    gRxClass[PHNXPNCIHAL_RX_CLASS_INDEX(0x62, 0x00)] |=
+        PHNXPNCIHAL_RX_NFCEE_DISC;
   }
-
-clean_and_return:
-  phNxpNciHal_cleanup_cb_data(&cb_data);
-  return data_len;
 }
 
 /******************************************************************************
- * Function         phNxpNciHal_write_complete
+ * Function         phNxpNciHal_rx_class
  *
- * Description      This function handles write callback.
+ * Description      This function classifies a packet received from NFCC.
+ *                  Segments and control packets with RFU bits set only keep
+ *                  the extension and data classes, the other classes are
+ *                  single segment packets.
  *
- * Returns          void.
+ * Returns          PHNXPNCIHAL_RX_XXX flags of the packet.
  *
  ******************************************************************************/
-static void phNxpNciHal_write_complete(void* pContext,
-                                       phTmlNfc_TransactInfo_t* pInfo) {
-  phNxpNciHal_Sem_t* p_cb_data = (phNxpNciHal_Sem_t*)pContext;
+static uint8_t phNxpNciHal_rx_class(const uint8_t* p_data, uint16_t data_len) {
+  uint8_t rx_class;
 
-  if (pInfo->wStatus == NFCSTATUS_SUCCESS) {
-    NXPLOG_NCIHAL_D("write successful status = 0x%x", pInfo->wStatus);
-  } else {
-    NXPLOG_NCIHAL_E("write error status = 0x%x", pInfo->wStatus);
+  if (data_len < NCI_HEADER_SIZE) {
+    return PHNXPNCIHAL_RX_EXT;
   }
+  rx_class = gRxClass[PHNXPNCIHAL_RX_CLASS_INDEX(p_data[0], p_data[1])];
+  if ((p_data[0] & NCI_PBF_MASK) ||
+      (((p_data[0] & NCI_MT_MASK) != NCI_MT_DATA) &&
+       (p_data[1] & ~NCI_OID_MASK))) {
+    rx_class &= (PHNXPNCIHAL_RX_EXT | PHNXPNCIHAL_RX_DATA);
+  }
+  return rx_class;
+}
 
-  p_cb_data->status = pInfo->wStatus;
-
-  SEM_POST(p_cb_data);
-
-  return;
+/******************************************************************************
+ * Function         phNxpNciHal_rx_ext_required
+ *
+ * Description      This function checks if a received packet has to go
+ *                  through phNxpNciHal_process_ext_rsp. Data packets on
+ *                  the fast path connections only do for the allowlisted
+ *                  data path workarounds.
+ *
+ * Returns          true if the extensions process the packet.
+ *
+ ******************************************************************************/
+static bool phNxpNciHal_rx_ext_required(uint8_t rx_class,
+                                        const uint8_t* p_data) {
+  if (rx_class & PHNXPNCIHAL_RX_EXT) {
+    return true;
+  }
+  if (!(rx_class & PHNXPNCIHAL_RX_DATA)) {
+    return icode_detected;
+  }
+  if (!(gDataFastConnIds & (1 << PHNXPNCIHAL_DATA_CONN_ID(p_data[0])))) {
+    return true;
+  }
+  if ((gDataExtAllowlist & PHNXPNCIHAL_DATA_EXT_ICODE) && icode_detected) {
+    return true;
+  }
+  return (gDataExtAllowlist & PHNXPNCIHAL_DATA_EXT_MIFARE) &&
+         bDisableLegacyMfcExtns && bEnableMfcExtns;
 }
 
 /******************************************************************************
@@ -1493,7 +2243,10 @@ static void phNxpNciHal_write_complete(void* pContext,
  *                  using data callback of libnfc-nci.
  *                  There is a pending read called from each
  *                  phNxpNciHal_read_complete so each a packet received from
- *                  NFCC can be provide to libnfc-nci.
+ *                  NFCC can be provide to libnfc-nci. The packet is copied
+ *                  out of the TML receive slot, as nxpncihal_ctrl.p_rx_data
+ *                  is read by the HAL commands after this function returns,
+ *                  and the read is re-issued once the packet is processed.
  *
  * Returns          void.
  *
@@ -1503,6 +2256,7 @@ static void phNxpNciHal_read_complete(void* pContext,
   NFCSTATUS status = NFCSTATUS_FAILED;
   UNUSED(pContext);
   int sem_val;
+  uint8_t rx_class;
   if (nxpncihal_ctrl.read_retry_cnt == 1) {
     nxpncihal_ctrl.read_retry_cnt = 0;
   }
@@ -1517,35 +2271,54 @@ static void phNxpNciHal_read_complete(void* pContext,
       return;
   }
 
+  if ((pInfo->wStatus == NFCSTATUS_SUCCESS) &&
+      (pInfo->wLength > NCI_MAX_DATA_LEN)) {
+    NXPLOG_NCIHAL_E("read length 0x%x exceeds the receive buffer",
+                    pInfo->wLength);
+    pInfo->wStatus = NFCSTATUS_FAILED;
+  }
+
   if (pInfo->wStatus == NFCSTATUS_SUCCESS) {
     NXPLOG_NCIHAL_D("read successful status = 0x%x", pInfo->wStatus);
 
+    /* The TML receive slot is reused once this function returns */
+    memcpy(Rx_data, pInfo->pBuff, pInfo->wLength);
     sem_getvalue(&(nxpncihal_ctrl.syncSpiNfc), &sem_val);
-    if (((pInfo->pBuff[0] & NCI_MT_MASK) == NCI_MT_RSP) && sem_val == 0) {
+    if (((Rx_data[0] & NCI_MT_MASK) == NCI_MT_RSP) && sem_val == 0) {
       sem_post(&(nxpncihal_ctrl.syncSpiNfc));
     }
-    nxpncihal_ctrl.p_rx_data = pInfo->pBuff;
+    nxpncihal_ctrl.p_rx_data = Rx_data;
     nxpncihal_ctrl.rx_data_len = pInfo->wLength;
+    rx_class = phNxpNciHal_rx_class(Rx_data, pInfo->wLength);
     /*Check the Omapi command response and store in dedicated buffer to solve
      * sync issue*/
-    if (pInfo->pBuff[0] == 0x4F && pInfo->pBuff[1] == 0x01 &&
-        pInfo->pBuff[2] == 0x01) {
-      nxpncihal_ctrl.p_rx_ese_data = pInfo->pBuff;
+    if ((rx_class & PHNXPNCIHAL_RX_OMAPI) && Rx_data[2] == 0x01) {
+      nxpncihal_ctrl.p_rx_ese_data = Rx_data;
       nxpncihal_ctrl.rx_ese_data_len = pInfo->wLength;
       SEM_POST(&(nxpncihal_ctrl.ext_cb_data));
     } else {
-      nxpncihal_ctrl.p_rx_data = pInfo->pBuff;
-      nxpncihal_ctrl.rx_data_len = pInfo->wLength;
-      status = phNxpNciHal_process_ext_rsp(nxpncihal_ctrl.p_rx_data,
-                                           &nxpncihal_ctrl.rx_data_len);
+#ifdef ENABLE_ESE_CLIENT
+      /* The eSE HAL is connected on any packet received, not only on the
+       * packets processed by phNxpNciHal_process_ext_rsp */
+      gpEseAdapt = &EseAdaptation::GetInstance();
+      gpEseAdapt->Initialize();
+#endif
+      if (phNxpNciHal_rx_ext_required(rx_class, Rx_data)) {
+        status = phNxpNciHal_process_ext_rsp(nxpncihal_ctrl.p_rx_data,
+                                             &nxpncihal_ctrl.rx_data_len);
+        /* The chip type is configured on CORE_RESET_NTF and CORE_INIT_RSP */
+        rx_class = phNxpNciHal_rx_class(Rx_data, pInfo->wLength);
+      } else {
+        status = NFCSTATUS_SUCCESS;
+      }
     }
 
-    phNxpNciHal_print_res_status(pInfo->pBuff, &pInfo->wLength);
+    phNxpNciHal_print_res_status(Rx_data, &pInfo->wLength);
 
     /* Notification Checking */
-    if (nfcFL.nfccFL._NFCC_FORCE_NCI1_0_INIT && ((nxpncihal_ctrl.hal_ext_enabled == 1) &&
-        (nxpncihal_ctrl.p_rx_data[0x00] == 0x60) &&
-        (nxpncihal_ctrl.p_rx_data[0x03] == 0x02))) {
+    if ((rx_class & PHNXPNCIHAL_RX_CORE_NTF) &&
+        (nxpncihal_ctrl.hal_ext_enabled == 1) &&
+        (nxpncihal_ctrl.p_rx_data[0x03] == 0x02)) {
       nxpncihal_ctrl.ext_cb_data.status = NFCSTATUS_SUCCESS;
       SEM_POST(&(nxpncihal_ctrl.ext_cb_data));
     } else if (nxpncihal_ctrl.hal_ext_enabled == TRUE && /* Check if response should go to hal module only */
@@ -1581,8 +2354,7 @@ static void phNxpNciHal_read_complete(void* pContext,
                                                nxpncihal_ctrl.p_rx_data);
       /* sending NFCEE_RF_DISC NTF to upper layer if eSE DISCT_NTF with
        * connected & enabled. */
-      if ((nfcFL.chipType == pn557) && nxpncihal_ctrl.p_rx_data[0] == 0x62 &&
-          nxpncihal_ctrl.p_rx_data[1] == 0x00 &&
+      if ((rx_class & PHNXPNCIHAL_RX_NFCEE_DISC) &&
           nxpncihal_ctrl.p_rx_data[3] == 0xC0 &&
           nxpncihal_ctrl.p_rx_data[4] == 0x00) {
         uint8_t nfcee_notifiations[3][9] = {
@@ -1601,23 +2373,329 @@ static void phNxpNciHal_read_complete(void* pContext,
     NXPLOG_NCIHAL_E("read error status = 0x%x", pInfo->wStatus);
   }
 
+  /* The packet may have closed the HAL or cleared wait_for_ntf, the next
+   * read is decided on the state left by its processing */
   if (nxpncihal_ctrl.halStatus == HAL_STATUS_CLOSE &&
     nxpncihal_ctrl.nci_info.wait_for_ntf == FALSE) {
     NXPLOG_NCIHAL_D(" Ignoring read , HAL close triggered");
-    return;
-  }
-  /* Read again because read must be pending always.*/
-  status = phTmlNfc_Read(
-      Rx_data, NCI_MAX_DATA_LEN,
-      (pphTmlNfc_TransactCompletionCb_t)&phNxpNciHal_read_complete, NULL);
-  if (status != NFCSTATUS_PENDING) {
-    NXPLOG_NCIHAL_E("read status error status = %x", status);
-    /* TODO: Not sure how to handle this ? */
+  } else {
+    /* Read again because read must be pending always.*/
+    NFCSTATUS readStatus = phTmlNfc_Read(
+        Rx_data, NCI_MAX_DATA_LEN,
+        (pphTmlNfc_TransactCompletionCb_t)&phNxpNciHal_read_complete, NULL);
+    if (readStatus == PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_BUSY)) {
+      /* A read was already re-issued while the packet was processed */
+      NXPLOG_NCIHAL_D("read already pending");
+    } else if (readStatus != NFCSTATUS_PENDING) {
+      /* No packet can be received anymore, let the stack recover */
+      NXPLOG_NCIHAL_E("read status error status = %x", readStatus);
+      if (nxpncihal_ctrl.p_nfc_stack_cback != NULL) {
+        (*nxpncihal_ctrl.p_nfc_stack_cback)(HAL_NFC_ERROR_EVT,
+                                            HAL_NFC_STATUS_FAILED);
+      }
+    }
   }
 
   return;
 }
 
+/******************************************************************************
+ * Function         phNxpNciHal_set_config_param_len
+ *
+ * Description      This function gives the length of a CORE_SET_CONFIG
+ *                  parameter, proprietary 0xA0XX ids included.
+ *
+ * Returns          Length of the id, length and value fields.
+ *
+ ******************************************************************************/
+static uint16_t phNxpNciHal_set_config_param_len(const uint8_t* p_param) {
+  if (p_param[0] == 0xA0) {
+    return p_param[2] + 3;
+  }
+  return p_param[1] + 2;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_set_config_is_valid
+ *
+ * Description      This function checks that a command is a well formed
+ *                  CORE_SET_CONFIG_CMD, whose parameters can be coalesced.
+ *
+ * Returns          true if the command can be coalesced.
+ *
+ ******************************************************************************/
+static bool phNxpNciHal_set_config_is_valid(uint16_t cmd_len,
+                                            const uint8_t* p_cmd) {
+  uint16_t offset = NCI_HEADER_SIZE + 1;
+  uint8_t i;
+
+  if ((cmd_len <= offset) || (p_cmd[0] != NCI_MT_CMD) ||
+      (p_cmd[1] != NCI_MSG_CORE_SET_CONFIG) ||
+      (p_cmd[2] != cmd_len - NCI_HEADER_SIZE) || (p_cmd[3] == 0)) {
+    return false;
+  }
+  for (i = 0; i < p_cmd[3]; i++) {
+    if ((offset + 2 > cmd_len) ||
+        ((p_cmd[offset] == 0xA0) && (offset + 3 > cmd_len))) {
+      return false;
+    }
+    offset += phNxpNciHal_set_config_param_len(&p_cmd[offset]);
+  }
+  return (offset == cmd_len);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_set_config_ext_match
+ *
+ * Description      This function checks if a well formed CORE_SET_CONFIG_CMD
+ *                  sets the NFC profile (A0 44) or has one of the layouts
+ *                  matched by phNxpNciHal_write_ext and phNxpNHal_DtaUpdate.
+ *                  Such commands are sent as they are, and coalesced
+ *                  commands must not take one of these layouts. The bytes
+ *                  tested are within the length given by p_cmd[2].
+ *
+ * Returns          true if the extensions match the command.
+ *
+ ******************************************************************************/
+static bool phNxpNciHal_set_config_ext_match(const uint8_t* p_cmd) {
+  const uint8_t* p = &p_cmd[NCI_HEADER_SIZE + 1];
+  uint8_t i;
+
+  for (i = 0; i < p_cmd[3]; i++) {
+    if ((p[0] == 0xA0) && (p[1] == 0x44)) {
+      return true;
+    }
+    p += phNxpNciHal_set_config_param_len(p);
+  }
+  /* Dirty set config layouts of phNxpNciHal_write_ext */
+  if ((p_cmd[2] == 0x09 && p_cmd[3] == 0x04) ||
+      (p_cmd[2] == 0x07 && p_cmd[3] == 0x03) ||
+      (p_cmd[2] == 0x03 && p_cmd[3] == 0x01 && p_cmd[4] == 0x32) ||
+      (p_cmd[2] == 0x04 && p_cmd[3] == 0x01 && p_cmd[4] == 0x32 &&
+       p_cmd[5] == 0x00)) {
+    return true;
+  }
+  /* DTA layouts of phNxpNHal_DtaUpdate */
+  return (p_cmd[2] == 0x17 && p_cmd[3] == 0x01 && p_cmd[4] == 0x29 &&
+          p_cmd[5] == 0x14) ||
+         (p_cmd[2] == 0x10 && p_cmd[3] == 0x05 && p_cmd[10] == 0x32 &&
+          p_cmd[12] == 0x00) ||
+         (p_cmd[2] == 0x0D && p_cmd[3] == 0x04 && p_cmd[10] == 0x32 &&
+          (p_cmd[12] == 0x00 || p_cmd[12] == 0x20)) ||
+         (p_cmd[2] == 0x0D && p_cmd[3] == 0x04 && p_cmd[4] == 0x32 &&
+          p_cmd[5] == 0x01 && p_cmd[6] == 0x00) ||
+         (p_cmd[2] == 0x04 && p_cmd[3] == 0x01 && p_cmd[4] == 0x50 &&
+          p_cmd[5] == 0x01 && p_cmd[6] == 0x00) ||
+         (p_cmd[2] == 0x07 && p_cmd[3] == 0x78 && p_cmd[4] == 0x00 &&
+          p_cmd[5] == 0x00);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_set_config_batch_has_param
+ *
+ * Description      This function checks if the pending CORE_SET_CONFIG_CMD
+ *                  already sets the parameter of p_param.
+ *
+ * Returns          true if the parameter is pending.
+ *
+ ******************************************************************************/
+static bool phNxpNciHal_set_config_batch_has_param(
+    const phNxpNciHal_SetConfigBatch_t* pBatch, const uint8_t* p_param) {
+  const uint8_t* p = &pBatch->aCmd[NCI_HEADER_SIZE + 1];
+  uint8_t i;
+
+  for (i = 0; i < pBatch->aCmd[3]; i++) {
+    if ((p[0] == p_param[0]) && ((p[0] != 0xA0) || (p[1] == p_param[1]))) {
+      return true;
+    }
+    p += phNxpNciHal_set_config_param_len(p);
+  }
+  return false;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_set_config_batch_flush
+ *
+ * Description      This function sends the pending CORE_SET_CONFIG_CMD, if
+ *                  any, and empties the batch.
+ *
+ * Returns          NFCSTATUS_SUCCESS if nothing was pending or the command
+ *                  succeeded.
+ *
+ ******************************************************************************/
+static NFCSTATUS phNxpNciHal_set_config_batch_flush(
+    phNxpNciHal_SetConfigBatch_t* pBatch) {
+  NFCSTATUS status = NFCSTATUS_SUCCESS;
+
+  if (pBatch->wLen > 0) {
+    if (pBatch->wCommands > 1) {
+      NXPLOG_NCIHAL_D("Set config: %u commands coalesced, %u params",
+                      pBatch->wCommands, pBatch->aCmd[3]);
+    }
+    status = phNxpNciHal_send_ext_cmd(pBatch->wLen, pBatch->aCmd);
+    if (status != NFCSTATUS_SUCCESS) {
+      NXPLOG_NCIHAL_E("Set config of %u commands failed", pBatch->wCommands);
+    }
+  }
+  pBatch->wLen = 0;
+  pBatch->wCommands = 0;
+  return status;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_set_config_batch_add
+ *
+ * Description      This function queues a command sent during core
+ *                  initialization. The parameters of consecutive
+ *                  CORE_SET_CONFIG_CMDs are coalesced into one command, up to
+ *                  the max control packet payload of the NFCC. The pending
+ *                  command is sent first if it already sets one of the
+ *                  parameters, so the last value set still wins. Other
+ *                  commands, and those matched by the extensions, are sent
+ *                  right after the pending one. Parameters are not coalesced
+ *                  into a command the extensions would match.
+ *
+ * Returns          NFCSTATUS_SUCCESS if the command is queued or sent.
+ *
+ ******************************************************************************/
+static NFCSTATUS phNxpNciHal_set_config_batch_add(
+    phNxpNciHal_SetConfigBatch_t* pBatch, uint16_t cmd_len, uint8_t* p_cmd) {
+  NFCSTATUS status = NFCSTATUS_SUCCESS;
+  uint16_t max_payload = nxpncihal_ctrl.nci_info.max_ctrl_payload;
+  uint16_t offset = NCI_HEADER_SIZE + 1;
+  bool flush = false;
+  uint8_t i;
+
+  if ((max_payload == 0) || (cmd_len - NCI_HEADER_SIZE > max_payload) ||
+      !phNxpNciHal_set_config_is_valid(cmd_len, p_cmd) ||
+      phNxpNciHal_set_config_ext_match(p_cmd)) {
+    status = phNxpNciHal_set_config_batch_flush(pBatch);
+    if (status != NFCSTATUS_SUCCESS) {
+      return status;
+    }
+    return phNxpNciHal_send_ext_cmd(cmd_len, p_cmd);
+  }
+
+  if (pBatch->wLen > 0) {
+    flush = (pBatch->wLen + cmd_len - offset - NCI_HEADER_SIZE > max_payload);
+    for (i = 0; !flush && (i < p_cmd[3]); i++) {
+      flush = phNxpNciHal_set_config_batch_has_param(pBatch, &p_cmd[offset]);
+      offset += phNxpNciHal_set_config_param_len(&p_cmd[offset]);
+    }
+    if (flush) {
+      status = phNxpNciHal_set_config_batch_flush(pBatch);
+      if (status != NFCSTATUS_SUCCESS) {
+        return status;
+      }
+    }
+  }
+
+  if (pBatch->wLen > 0) {
+    offset = NCI_HEADER_SIZE + 1;
+    memcpy(&pBatch->aCmd[pBatch->wLen], &p_cmd[offset], cmd_len - offset);
+    pBatch->aCmd[2] = pBatch->wLen + cmd_len - offset - NCI_HEADER_SIZE;
+    pBatch->aCmd[3] += p_cmd[3];
+    if (!phNxpNciHal_set_config_ext_match(pBatch->aCmd)) {
+      pBatch->wLen += cmd_len - offset;
+      pBatch->wCommands++;
+      return NFCSTATUS_SUCCESS;
+    }
+    /* Send the pending parameters alone */
+    pBatch->aCmd[2] = pBatch->wLen - NCI_HEADER_SIZE;
+    pBatch->aCmd[3] -= p_cmd[3];
+    status = phNxpNciHal_set_config_batch_flush(pBatch);
+    if (status != NFCSTATUS_SUCCESS) {
+      return status;
+    }
+  }
+
+  memcpy(pBatch->aCmd, p_cmd, cmd_len);
+  pBatch->wLen = cmd_len;
+  pBatch->wCommands = 1;
+  return NFCSTATUS_SUCCESS;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_set_config_param_key
+ *
+ * Description      This function identifies the setting changed by a
+ *                  CORE_SET_CONFIG parameter. RF register writes are told
+ *                  apart by their target and register address.
+ *
+ * Returns          Key of the setting.
+ *
+ ******************************************************************************/
+static uint32_t phNxpNciHal_set_config_param_key(const uint8_t* p_param) {
+  uint32_t key;
+
+  if (p_param[0] != 0xA0) {
+    return p_param[0];
+  }
+  key = 0xA000 | p_param[1];
+  if ((p_param[1] == 0x0D) && (p_param[2] >= 2)) {
+    key |= ((uint32_t)p_param[3] << 24) | ((uint32_t)p_param[4] << 16);
+  }
+  return key;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_config_block_required
+ *
+ * Description      This function decides if a configuration block is sent
+ *                  during core initialization. A block is sent if forced, if
+ *                  it differs from the block the NFCC last accepted in the
+ *                  same slot, or if it sets again a parameter of a block
+ *                  sent before it, so the NFCC keeps the value of the last
+ *                  block. Sent blocks are recorded for
+ *                  updateNxpConfigBlockState().
+ *
+ * Returns          true if the block has to be sent.
+ *
+ ******************************************************************************/
+static bool phNxpNciHal_config_block_required(const char* pSlot,
+                                              uint8_t* p_cmd, long len,
+                                              bool force) {
+  bool valid;
+  bool required;
+  uint16_t offset = NCI_HEADER_SIZE + 1;
+  uint32_t key;
+  uint16_t j;
+  uint8_t i;
+
+  if (len <= 0) {
+    setNxpConfigBlockApplied(pSlot, NULL, 0);
+    return false;
+  }
+  valid = phNxpNciHal_set_config_is_valid(len, p_cmd);
+  required = force || isNxpConfigBlockModified(pSlot, p_cmd, len) ||
+             (gSentParamsCount == PHNXPNCIHAL_SENT_PARAMS_MAX);
+  for (i = 0; valid && !required && (i < p_cmd[3]); i++) {
+    key = phNxpNciHal_set_config_param_key(&p_cmd[offset]);
+    for (j = 0; !required && (j < gSentParamsCount); j++) {
+      required = (gSentParams[j] == key);
+    }
+    offset += phNxpNciHal_set_config_param_len(&p_cmd[offset]);
+  }
+  if (!required) {
+    NXPLOG_NCIHAL_D("%s not modified, not sent", pSlot);
+    return false;
+  }
+
+  offset = NCI_HEADER_SIZE + 1;
+  for (i = 0; valid && (i < p_cmd[3]); i++) {
+    key = phNxpNciHal_set_config_param_key(&p_cmd[offset]);
+    for (j = 0; (j < gSentParamsCount) && (gSentParams[j] != key); j++)
+      ;
+    if ((j == gSentParamsCount) &&
+        (gSentParamsCount < PHNXPNCIHAL_SENT_PARAMS_MAX)) {
+      gSentParams[gSentParamsCount++] = key;
+    }
+    offset += phNxpNciHal_set_config_param_len(&p_cmd[offset]);
+  }
+  setNxpConfigBlockApplied(pSlot, p_cmd, len);
+  return true;
+}
+
 /******************************************************************************
  * Function         phNxpNciHal_core_initialized
  *
@@ -1634,6 +2712,7 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
   uint8_t* buffer = NULL;
   uint8_t isfound = false;
   uint8_t setConfigAlways = false;
+  bool forceConfig = false;
   char valueStr[PROPERTY_VALUE_MAX] = {0};
   bool persist_hci_network_reset_req =false;
   bool persist_core_reset_debug_info_req = false;
@@ -1689,6 +2768,9 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
   retry_core_init:
     *p_core_init_rsp_params = init_param;
     config_access = false;
+    gSetConfigBatch.wLen = 0;
+    gSetConfigBatch.wCommands = 0;
+    updateNxpConfigBlockState(false);
     if (mGetCfg_info != NULL) {
       mGetCfg_info->isGetcfg = false;
     }
@@ -1789,8 +2871,9 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
     }
   }
 
-  status = phNxpNciHal_send_ext_cmd(sizeof(cmd_ven_pulld_enable_nci),
-                                    cmd_ven_pulld_enable_nci);
+  status = phNxpNciHal_set_config_batch_add(
+      &gSetConfigBatch, sizeof(cmd_ven_pulld_enable_nci),
+      cmd_ven_pulld_enable_nci);
   if (status != NFCSTATUS_SUCCESS) {
     NXPLOG_NCIHAL_E("cmd_ven_pulld_enable_nci: Failed");
     retry_core_init_cnt++;
@@ -1802,8 +2885,8 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
     if (GetNxpNumValue(NAME_NXP_MF_CLT_JCOP_CFG, (void *)&retlen,
                        sizeof(retlen))) {
       cmd_mf_clt_jcop_cfg[7] = 0x01 & retlen;
-      status = phNxpNciHal_send_ext_cmd(sizeof(cmd_mf_clt_jcop_cfg),
-                                        cmd_mf_clt_jcop_cfg);
+      status = phNxpNciHal_set_config_batch_add(
+          &gSetConfigBatch, sizeof(cmd_mf_clt_jcop_cfg), cmd_mf_clt_jcop_cfg);
       if (status != NFCSTATUS_SUCCESS) {
         NXPLOG_NCIHAL_E("cmd_mf_clt_jcop_cfg: Failed");
         retry_core_init_cnt++;
@@ -1811,6 +2894,11 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
       }
     }
   }
+  status = phNxpNciHal_set_config_batch_flush(&gSetConfigBatch);
+  if (status != NFCSTATUS_SUCCESS) {
+    retry_core_init_cnt++;
+    goto retry_core_init;
+  }
 
   if(nfcFL.eseFL._ESE_SVDD_SYNC) {
       if (GetNxpNumValue(NAME_NXP_SVDD_SYNC_OFF_DELAY, (void*)&gSvddSyncOff_Delay,
@@ -1966,6 +3054,9 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
   }
   NXPLOG_NCIHAL_D("fw_download_success : 0x%02x SetConfigAlways flag : 0x%02x",
                   fw_download_success, setConfigAlways);
+  /* Blocks not modified since the NFCC accepted them are not sent again */
+  forceConfig = (true == fw_download_success) || (true == setConfigAlways);
+  gSentParamsCount = 0;
 
   if ((true == fw_download_success) || (true == setConfigAlways) ||
        isNxpConfigModified()) {
@@ -2008,9 +3099,11 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
     config_access = true;
     isfound = GetNxpByteArrayValue(NAME_NXP_NFC_PROFILE_EXTN, (char*) buffer,
         bufflen, &retlen);
-    if (retlen > 0) {
+    if (phNxpNciHal_config_block_required(NAME_NXP_NFC_PROFILE_EXTN, buffer,
+                                          retlen, forceConfig)) {
       /* NXP ACT Proprietary Ext */
-      status = phNxpNciHal_send_ext_cmd(retlen, buffer);
+      status = phNxpNciHal_set_config_batch_add(&gSetConfigBatch, retlen,
+                                                buffer);
       if (status != NFCSTATUS_SUCCESS) {
         NXPLOG_NCIHAL_E("NXP ACT Proprietary Ext failed");
         NXP_NCI_HAL_CORE_INIT_RECOVER(retry_core_init_cnt, retry_core_init);
@@ -2025,8 +3118,11 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
       if (isfound > 0 && (num > 0 && num <= 3)) {
         isfound = GetNxpByteArrayValue(TVDD_CONFIG_LIST[num - 1],
             (char*) buffer, bufflen, &retlen);
-        if (retlen > 0) {
-          status = phNxpNciHal_send_ext_cmd(retlen, buffer);
+        /* The TVDD blocks share one slot, only the selected one is sent */
+        if (phNxpNciHal_config_block_required(NAME_NXP_EXT_TVDD_CFG, buffer,
+                                              retlen, forceConfig)) {
+          status = phNxpNciHal_set_config_batch_add(&gSetConfigBatch, retlen,
+                                                    buffer);
           if (status != NFCSTATUS_SUCCESS) {
             NXPLOG_NCIHAL_E("EXT TVDD CFG 1 Settings failed");
             NXP_NCI_HAL_CORE_INIT_RECOVER(retry_core_init_cnt, retry_core_init);
@@ -2036,6 +3132,10 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
         NXPLOG_NCIHAL_E("Wrong Configuration Value %ld", num);
       }
     }
+    status = phNxpNciHal_set_config_batch_flush(&gSetConfigBatch);
+    if (status != NFCSTATUS_SUCCESS) {
+      NXP_NCI_HAL_CORE_INIT_RECOVER(retry_core_init_cnt, retry_core_init);
+    }
   }
 
     retlen = 0;
@@ -2045,13 +3145,16 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
           config_access = false;
       }
       uint8_t numOfBlocks = sizeof(RF_BLOCK_LIST)/sizeof(RF_BLOCK_LIST[0]);
+      /* All the blocks may be up to date */
+      status = NFCSTATUS_SUCCESS;
       for(int i=0; i< numOfBlocks; i++)
       {
         retlen = 0;
         NXPLOG_NCIHAL_D("Performing RF Settings BLK %u", i+1);
         isfound = GetNxpByteArrayValue(RF_BLOCK_LIST[i], (char*)buffer,
                                        bufflen, &retlen);
-        if (retlen > 0) {
+        if (phNxpNciHal_config_block_required(RF_BLOCK_LIST[i], buffer, retlen,
+                                              forceConfig)) {
           status = phNxpNciHal_send_ext_cmd(retlen, buffer);
           if ((nfcFL.chipType != pn547C2) && (status == NFCSTATUS_SUCCESS)) {
               status = phNxpNciHal_CheckRFCmdRespStatus();
@@ -2079,9 +3182,11 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
       NXPLOG_NCIHAL_D("Performing NAME_NXP_CORE_CONF_EXTN Settings");
       isfound = GetNxpByteArrayValue(NAME_NXP_CORE_CONF_EXTN, (char*)buffer,
                                      bufflen, &retlen);
-      if (retlen > 0) {
+      if (phNxpNciHal_config_block_required(NAME_NXP_CORE_CONF_EXTN, buffer,
+                                            retlen, forceConfig)) {
         /* NXP ACT Proprietary Ext */
-        status = phNxpNciHal_send_ext_cmd(retlen, buffer);
+        status = phNxpNciHal_set_config_batch_add(&gSetConfigBatch, retlen,
+                                                  buffer);
         if (status != NFCSTATUS_SUCCESS) {
           NXPLOG_NCIHAL_E("NXP Core configuration failed");
           NXP_NCI_HAL_CORE_INIT_RECOVER(retry_core_init_cnt, retry_core_init);
@@ -2092,14 +3197,20 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
       retlen = 0;
       isfound = GetNxpByteArrayValue(NAME_NXP_CORE_CONF, (char*)buffer, bufflen,
                                      &retlen);
-      if (retlen > 0) {
+      if (phNxpNciHal_config_block_required(NAME_NXP_CORE_CONF, buffer, retlen,
+                                            forceConfig)) {
         /* NXP ACT Proprietary Ext */
-        status = phNxpNciHal_send_ext_cmd(retlen, buffer);
+        status = phNxpNciHal_set_config_batch_add(&gSetConfigBatch, retlen,
+                                                  buffer);
         if (status != NFCSTATUS_SUCCESS) {
           NXPLOG_NCIHAL_E("Core Set Config failed");
           NXP_NCI_HAL_CORE_INIT_RECOVER(retry_core_init_cnt, retry_core_init);
         }
       }
+      status = phNxpNciHal_set_config_batch_flush(&gSetConfigBatch);
+      if (status != NFCSTATUS_SUCCESS) {
+        NXP_NCI_HAL_CORE_INIT_RECOVER(retry_core_init_cnt, retry_core_init);
+      }
     }
 
   if ((true == fw_download_success) || (true == setConfigAlways)
@@ -2163,7 +3274,8 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
     retlen = 0;
     isfound = GetNxpByteArrayValue(NAME_NXP_CORE_MFCKEY_SETTING, (char*) buffer,
         bufflen, &retlen);
-    if (retlen > 0) {
+    if (phNxpNciHal_config_block_required(NAME_NXP_CORE_MFCKEY_SETTING, buffer,
+                                          retlen, forceConfig)) {
       /* NXP ACT Proprietary Ext */
       status = phNxpNciHal_send_ext_cmd(retlen, buffer);
       if (status != NFCSTATUS_SUCCESS) {
@@ -2178,7 +3290,8 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
     }
     isfound = GetNxpByteArrayValue(NAME_NXP_CORE_RF_FIELD, (char*) buffer,
         bufflen, &retlen);
-    if (retlen > 0) {
+    if (phNxpNciHal_config_block_required(NAME_NXP_CORE_RF_FIELD, buffer,
+                                          retlen, forceConfig)) {
       /* NXP ACT Proprietary Ext */
       status = phNxpNciHal_send_ext_cmd(retlen, buffer);
       if ((nfcFL.chipType != pn547C2) && (status == NFCSTATUS_SUCCESS)) {
@@ -2255,7 +3368,8 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
     /* SWP FULL PWR MODE SETTING ON */
     if (GetNxpNumValue(NAME_NXP_SWP_FULL_PWR_ON, (void*) &num, sizeof(num))) {
       if (1 == num) {
-        status = phNxpNciHal_send_ext_cmd(sizeof(swp_full_pwr_mode_on_cmd),
+        status = phNxpNciHal_set_config_batch_add(
+            &gSetConfigBatch, sizeof(swp_full_pwr_mode_on_cmd),
             swp_full_pwr_mode_on_cmd);
         if (status != NFCSTATUS_SUCCESS) {
           NXPLOG_NCIHAL_E("SWP FULL PWR MODE SETTING ON CMD FAILED");
@@ -2263,7 +3377,8 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
         }
       } else {
         swp_full_pwr_mode_on_cmd[7] = 0x00;
-        status = phNxpNciHal_send_ext_cmd(sizeof(swp_full_pwr_mode_on_cmd),
+        status = phNxpNciHal_set_config_batch_add(
+            &gSetConfigBatch, sizeof(swp_full_pwr_mode_on_cmd),
             swp_full_pwr_mode_on_cmd);
         if (status != NFCSTATUS_SUCCESS) {
           NXPLOG_NCIHAL_E("SWP FULL PWR MODE SETTING OFF CMD FAILED");
@@ -2277,8 +3392,8 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
       if (GetNxpNumValue(NAME_AID_MATCHING_PLATFORM, (void*) &num,
           sizeof(num))) {
         if (1 == num) {
-          status = phNxpNciHal_send_ext_cmd(
-              sizeof(android_l_aid_matching_mode_on_cmd),
+          status = phNxpNciHal_set_config_batch_add(
+              &gSetConfigBatch, sizeof(android_l_aid_matching_mode_on_cmd),
               android_l_aid_matching_mode_on_cmd);
           if (status != NFCSTATUS_SUCCESS) {
             NXPLOG_NCIHAL_E("Android L AID Matching Platform Setting Failed");
@@ -2286,8 +3401,8 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
           }
         } else if (2 == num) {
           android_l_aid_matching_mode_on_cmd[7] = 0x00;
-          status = phNxpNciHal_send_ext_cmd(
-              sizeof(android_l_aid_matching_mode_on_cmd),
+          status = phNxpNciHal_set_config_batch_add(
+              &gSetConfigBatch, sizeof(android_l_aid_matching_mode_on_cmd),
               android_l_aid_matching_mode_on_cmd);
           if (status != NFCSTATUS_SUCCESS) {
             NXPLOG_NCIHAL_E("Android L AID Matching Platform Setting Failed");
@@ -2296,8 +3411,15 @@ int phNxpNciHal_core_initialized(uint8_t* p_core_init_rsp_params) {
         }
       }
     }
+    status = phNxpNciHal_set_config_batch_flush(&gSetConfigBatch);
+    if (status != NFCSTATUS_SUCCESS) {
+      NXP_NCI_HAL_CORE_INIT_RECOVER(retry_core_init_cnt, retry_core_init);
+    }
   }
 
+  /* Keep the blocks sent only if the NFCC accepted all of them */
+  updateNxpConfigBlockState(config_success);
+
   if (persist_hci_network_reset_req) {
     phNxpNciHal_hci_network_reset();
   }
@@ -2974,6 +4096,9 @@ int phNxpNciHal_close(bool bShutdown) {
     return NFCSTATUS_FAILED;
   }
 
+  phNxpNciHal_logNciStats();
+  phNxpNciHal_data_tx_stop();
+  DATA_LOCK();
   CONCURRENCY_LOCK();
   phNxpNciHal_sendRfEvtToEseHal(0x00);
   if (nfcFL.nfccFL._NFCC_I2C_READ_WRITE_IMPROVEMENT &&
@@ -3054,13 +4179,19 @@ close_and_return:
 
     status = phTmlNfc_Shutdown();
 
-    if (0 != pthread_join(nxpncihal_ctrl.client_thread, (void **)NULL)) {
+    bool client_joined =
+        (0 == pthread_join(nxpncihal_ctrl.client_thread, (void **)NULL));
+    if (!client_joined) {
       NXPLOG_TML_E("Fail to kill client thread!");
     }
 
     phTmlNfc_CleanUp();
 
     phDal4Nfc_msgrelease(nxpncihal_ctrl.gDrvCfg.nClientId);
+    /* Only freed once its consumer, the client thread, has exited */
+    if (client_joined) {
+      (void)phDal4Nfc_msgctl(nxpncihal_ctrl.gDrvCfg.nClientId, IPC_RMID, NULL);
+    }
 
     memset(&nxpncihal_ctrl, 0x00, sizeof(nxpncihal_ctrl));
 
@@ -3068,9 +4199,11 @@ close_and_return:
   }
 
   CONCURRENCY_UNLOCK();
+  DATA_UNLOCK();
 
   phNxpNciHal_cleanup_monitor();
   write_unlocked_status = NFCSTATUS_SUCCESS;
+  __atomic_store_n(&bRecoveryActive, false, __ATOMIC_RELEASE);
   phNxpNciHal_release_info();
   /* reset config cache */
   resetNxpConfig();
@@ -3091,6 +4224,8 @@ int phNxpNciHal_Minclose(void) {
   NFCSTATUS status;
   /*NCI_RESET_CMD*/
   uint8_t cmd_reset_nci[] = {0x20, 0x00, 0x01, 0x00};
+  phNxpNciHal_data_tx_stop();
+  DATA_LOCK();
   CONCURRENCY_LOCK();
   nxpncihal_ctrl.halStatus = HAL_STATUS_CLOSE;
   status = phNxpNciHal_send_ext_cmd(sizeof(cmd_reset_nci), cmd_reset_nci);
@@ -3108,13 +4243,19 @@ int phNxpNciHal_Minclose(void) {
 
     status = phTmlNfc_Shutdown();
 
-    if (0 != pthread_join(nxpncihal_ctrl.client_thread, (void **)NULL)) {
+    bool client_joined =
+        (0 == pthread_join(nxpncihal_ctrl.client_thread, (void **)NULL));
+    if (!client_joined) {
       NXPLOG_TML_E("Fail to kill client thread!");
     }
 
     phTmlNfc_CleanUp();
 
     phDal4Nfc_msgrelease(nxpncihal_ctrl.gDrvCfg.nClientId);
+    /* Only freed once its consumer, the client thread, has exited */
+    if (client_joined) {
+      (void)phDal4Nfc_msgctl(nxpncihal_ctrl.gDrvCfg.nClientId, IPC_RMID, NULL);
+    }
 
     memset(&nxpncihal_ctrl, 0x00, sizeof(nxpncihal_ctrl));
 
@@ -3122,10 +4263,12 @@ int phNxpNciHal_Minclose(void) {
   }
 
   CONCURRENCY_UNLOCK();
+  DATA_UNLOCK();
 
   phNxpNciHal_cleanup_monitor();
 
   write_unlocked_status = NFCSTATUS_SUCCESS;
+  __atomic_store_n(&bRecoveryActive, false, __ATOMIC_RELEASE);
   phNxpNciHal_release_info();
   /* reset config cache */
   resetNxpConfig();
@@ -4579,6 +5722,8 @@ void phNxpNciHal_configFeatureList(uint8_t* msg, uint16_t msg_len) {
     tNFC_chipType chipType = nxpncihal_ctrl.chipType;
     CONFIGURE_FEATURELIST(chipType);
     NXPLOG_NCIHAL_D("NFC_GetFeatureList ()chipType = %d", chipType);
+    phNxpNciHal_rx_class_init();
+    phNxpNciHal_open_prefetch_chip_type_known();
 }
 
 /*******************************************************************************
@@ -4794,6 +5939,95 @@ static void phNxpNciHal_initialize_mifare_flag() {
   }
 }
 
+/******************************************************************************
+ * Function         phNxpNciHal_initialize_data_ext_allowlist
+ *
+ * Description      This function reads the connections whose data packets
+ *                  take the fast path, and the data path workarounds which
+ *                  keep them in the extension processing.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpNciHal_initialize_data_ext_allowlist() {
+  unsigned long num = PHNXPNCIHAL_DATA_EXT_ALL;
+  //Bit set: data packets concerned by the workaround go through the extns.
+  //Bit cleared: data packets bypass the extns for that workaround.
+  if (GetNxpNumValue(NAME_NXP_DATA_EXT_ALLOWLIST, &num, sizeof(num))) {
+    num &= PHNXPNCIHAL_DATA_EXT_ALL;
+  }
+  gDataExtAllowlist = (uint8_t)num;
+  NXPLOG_NCIHAL_D("NXP_DATA_EXT_ALLOWLIST : 0x%02x", gDataExtAllowlist);
+
+  num = PHNXPNCIHAL_DATA_FAST_CONN_STATIC_RF;
+  //Bit n set: data packets on conn id n take the fast path.
+  if (GetNxpNumValue(NAME_NXP_DATA_FAST_PATH_CONN_IDS, &num, sizeof(num))) {
+    num &= 0xFFFF;
+  }
+  gDataFastConnIds = (uint16_t)num;
+  NXPLOG_NCIHAL_D("NXP_DATA_FAST_PATH_CONN_IDS : 0x%04x", gDataFastConnIds);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_initialize_tml_config
+ *
+ * Description      This function reads the optional TML settings from the
+ *                  config file into the TML configuration.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpNciHal_initialize_tml_config(phTmlNfc_Config_t* pConfig) {
+  /* TML copies what it needs from the file names during phTmlNfc_Init */
+  static char captureFile[260];
+  static char replayFile[260];
+  unsigned long num = 0;
+  //1: Serve TML reads, writes and retransmission from one epoll thread.
+  //0: Use the dedicated TML reader and writer threads.
+  if (GetNxpNumValue(NAME_NXP_TML_EVENT_LOOP, &num, sizeof(num))) {
+    pConfig->bEventLoop = (num == 0) ? false : true;
+  }
+  NXPLOG_NCIHAL_D("NXP_TML_EVENT_LOOP : %d", pConfig->bEventLoop);
+  num = 0;
+  //1: Keep reading from the NFCC into the TML receive slots.
+  //0: Read from the NFCC only when the HAL requests a packet.
+  if (GetNxpNumValue(NAME_NXP_TML_READ_AHEAD, &num, sizeof(num))) {
+    pConfig->bReadAhead = (num == 0) ? false : true;
+  }
+  NXPLOG_NCIHAL_D("NXP_TML_READ_AHEAD : %d", pConfig->bReadAhead);
+  num = 0;
+  //2: Replay the NCI capture file NXP_NCI_REPLAY_FILE.
+  //1: Answer NCI commands from the in-process virtual NFCC.
+  //0: Talk to the NFCC through the PN54X kernel driver.
+  if (GetNxpNumValue(NAME_NXP_TML_TRANSPORT, &num, sizeof(num))) {
+    if (num == 0x01) {
+      pConfig->eTransport = phTmlNfc_e_TransportVirtual;
+    } else if (num == 0x02) {
+      pConfig->eTransport = phTmlNfc_e_TransportReplay;
+    } else {
+      pConfig->eTransport = phTmlNfc_e_TransportI2c;
+    }
+  }
+  NXPLOG_NCIHAL_D("NXP_TML_TRANSPORT : %d", pConfig->eTransport);
+  num = 0;
+  //1: Read a whole NCI frame, or several, with one I2C read call.
+  //0: Read the NCI header and the payload with separate read calls.
+  if (GetNxpNumValue(NAME_NXP_I2C_SINGLE_READ, &num, sizeof(num))) {
+    pConfig->bSingleRead = (num == 0) ? false : true;
+  }
+  NXPLOG_NCIHAL_D("NXP_I2C_SINGLE_READ : %d", pConfig->bSingleRead);
+  if (GetNxpStrValue(NAME_NXP_NCI_CAPTURE_FILE, captureFile,
+                     sizeof(captureFile))) {
+    pConfig->pCaptureFile = (int8_t*)captureFile;
+    NXPLOG_NCIHAL_D("NXP_NCI_CAPTURE_FILE : %s", captureFile);
+  }
+  if (GetNxpStrValue(NAME_NXP_NCI_REPLAY_FILE, replayFile,
+                     sizeof(replayFile))) {
+    pConfig->pReplayFile = (int8_t*)replayFile;
+    NXPLOG_NCIHAL_D("NXP_NCI_REPLAY_FILE : %s", replayFile);
+  }
+}
+
 /******************************************************************************
  * Function         phNxpNciHal_ReleaseSVDDWait
  *
@@ -4982,6 +6216,7 @@ bool phNxpNciHal_Abort() {
      we need to abort the libnfc , this can be done only by check the p_nfc_stack_cback_backup
      pointer which is assigned before the JCOP download.*/
   if (p_nfc_stack_cback_backup != NULL){
+      phNxpLog_AsyncFlush();
       abort();
   }
   else {
@@ -5036,3 +6271,202 @@ void phNxpNciHal_nciTransceive(phNxpNci_Extn_Cmd_t *in, phNxpNci_Extn_Resp_t *ou
     NXPLOG_NCIHAL_D("%s Exit ", __func__);
     return;
 }
+
+/******************************************************************************
+ * Function         phNxpNciHal_logNciStats
+ *
+ * Description      This function logs the client thread dispatch statistics,
+ *                  the monitor lock contention and the NCI command statistics,
+ *                  one line per GID/OID.
+ *
+ * Returns          void.
+ *
+ *******************************************************************************/
+void phNxpNciHal_logNciStats(void) {
+  phTmlNfc_NciStats_t tStats[PH_TMLNFC_STATS_MAX_OPS];
+  uint8_t bCount = phTmlNfc_GetNciStats(tStats, PH_TMLNFC_STATS_MAX_OPS);
+  phNxpNciHal_DispatchStats_t tDispatch;
+
+  phNxpNciHal_getDispatchStats(&tDispatch);
+  NXPLOG_NCIHAL_D(
+      "Dispatch: batches=%u msgs=%u max=%u capped=%u sizes=%u/%u/%u/%u/%u",
+      tDispatch.dwBatches, tDispatch.dwMessages, tDispatch.dwMaxBatch,
+      tDispatch.dwCapped, tDispatch.aHistogram[0], tDispatch.aHistogram[1],
+      tDispatch.aHistogram[2], tDispatch.aHistogram[3],
+      tDispatch.aHistogram[4]);
+
+  for (uint8_t i = 0; i < phNxpNciHal_e_LockCount; i++) {
+    static const char* const kLockNames[phNxpNciHal_e_LockCount] = {
+        "reentrance", "data", "concurrency", "write"};
+    phNxpNciHal_LockStats_t tLock;
+    phNxpNciHal_getLockStats((phNxpNciHal_LockId_t)i, &tLock);
+    NXPLOG_NCIHAL_D(
+        "Lock %s: taken=%u contended=%u wait=%lluus maxwait=%lluus "
+        "hold=%lluus maxhold=%lluus",
+        kLockNames[i], tLock.dwAcquired, tLock.dwContended,
+        (unsigned long long)(tLock.qwWaitNs / 1000),
+        (unsigned long long)(tLock.qwMaxWaitNs / 1000),
+        (unsigned long long)(tLock.qwHoldNs / 1000),
+        (unsigned long long)(tLock.qwMaxHoldNs / 1000));
+  }
+
+  for (uint8_t i = 0; i < bCount; i++) {
+    NXPLOG_NCIHAL_D(
+        "NCI %02X/%02X: count=%u p50=%uus p99=%uus max=%uus retx=%u "
+        "retry=%u unanswered=%u",
+        tStats[i].bGid, tStats[i].bOid, tStats[i].dwCount, tStats[i].dwP50Us,
+        tStats[i].dwP99Us, tStats[i].dwMaxUs, tStats[i].dwRetransmissions,
+        tStats[i].dwWriteRetries, tStats[i].dwUnanswered);
+  }
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_getDispatchStats
+ *
+ * Description      This function reads the batch size statistics of the
+ *                  client thread message dispatch, kept across HAL sessions.
+ *
+ * Returns          void.
+ *
+ *******************************************************************************/
+void phNxpNciHal_getDispatchStats(phNxpNciHal_DispatchStats_t* pStats) {
+  if (pStats == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&gDispatchStatsMutex);
+  *pStats = gDispatchStats;
+  pthread_mutex_unlock(&gDispatchStatsMutex);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_recovery_forward_ntf
+ *
+ * Description      This function runs on the client thread once the NFCC
+ *                  answers CORE_RESET/CORE_INIT again. It hands the
+ *                  CORE_RESET_NTF that started the recovery to libnfc-nci,
+ *                  which re-initializes the NFCC through
+ *                  phNxpNciHal_core_initialized with the configuration and
+ *                  chip information still cached by the open HAL.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+static void phNxpNciHal_recovery_forward_ntf(void* pParam) {
+  UNUSED(pParam);
+
+  if (nxpncihal_ctrl.p_nfc_stack_data_cback != NULL) {
+    (*nxpncihal_ctrl.p_nfc_stack_data_cback)(gRecoveryNtfLen, gRecoveryNtf);
+  }
+  __atomic_store_n(&bRecoveryActive, false, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_recovery_thread
+ *
+ * Description      This function brings the NFCC back after an unrecoverable
+ *                  error, trying the cheaper stage first:
+ *                  1. CORE_RESET/CORE_INIT over the current link,
+ *                  2. VEN toggle through phTmlNfc_IoCtl, then
+ *                     CORE_RESET/CORE_INIT,
+ *                  3. re-initialization by libnfc-nci, see
+ *                     phNxpNciHal_recovery_forward_ntf.
+ *                  The HAL is aborted only if the NFCC does not answer after
+ *                  the VEN toggle. Runs on its own thread as the responses
+ *                  are received by the client thread.
+ *
+ * Returns          NULL.
+ *
+ ******************************************************************************/
+static void* phNxpNciHal_recovery_thread(void* arg) {
+  static phLibNfc_DeferredCall_t tForwardCall;
+  static phLibNfc_Message_t msg;
+  NFCSTATUS status = NFCSTATUS_FAILED;
+  UNUSED(arg);
+
+  DATA_LOCK();
+  CONCURRENCY_LOCK();
+  if (nxpncihal_ctrl.halStatus == HAL_STATUS_CLOSE) {
+    /* Closed meanwhile, the NFCC is reset on the next open */
+    NXPLOG_NCIHAL_W("%s: HAL closed, nothing to recover", __func__);
+    CONCURRENCY_UNLOCK();
+    DATA_UNLOCK();
+    __atomic_store_n(&bRecoveryActive, false, __ATOMIC_RELEASE);
+    return NULL;
+  }
+
+  NXPLOG_NCIHAL_W("%s: stage 1, NCI reset", __func__);
+  status = phNxpNciHal_nfcc_core_reset_init();
+  if (status != NFCSTATUS_SUCCESS) {
+    NXPLOG_NCIHAL_W("%s: stage 2, VEN toggle", __func__);
+    status = phTmlNfc_IoCtl(phTmlNfc_e_ResetDevice);
+    if (status == NFCSTATUS_SUCCESS) {
+      status = phNxpNciHal_nfcc_core_reset_init();
+    }
+  }
+  if (status != NFCSTATUS_SUCCESS) {
+    NXPLOG_NCIHAL_E("%s: NFCC not recovered, abort()", __func__);
+    phNxpLog_AsyncFlush();
+    abort();
+  }
+
+  NXPLOG_NCIHAL_W("%s: stage 3, re-initialization by the stack", __func__);
+  tForwardCall.pCallback = phNxpNciHal_recovery_forward_ntf;
+  tForwardCall.pParameter = NULL;
+  msg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
+  msg.pMsgData = &tForwardCall;
+  msg.Size = sizeof(tForwardCall);
+  if (phDal4Nfc_msgsnd(nxpncihal_ctrl.gDrvCfg.nClientId, &msg, 0) != 0) {
+    /* The NFCC is usable again, allow the next error to recover it */
+    NXPLOG_NCIHAL_E("%s: stage 3 not posted", __func__);
+    __atomic_store_n(&bRecoveryActive, false, __ATOMIC_RELEASE);
+  }
+
+  CONCURRENCY_UNLOCK();
+  DATA_UNLOCK();
+  return NULL;
+}
+
+/******************************************************************************
+ * Function         phNxpNciHal_emergency_recovery
+ *
+ * Description      This function is called when the NFCC reports an
+ *                  unrecoverable error. It starts the staged recovery of
+ *                  phNxpNciHal_recovery_thread and returns, further calls are
+ *                  ignored until that recovery completes. The HAL is aborted
+ *                  if it is not open or if the recovery cannot be started.
+ *
+ * Returns          void.
+ *
+ ******************************************************************************/
+void phNxpNciHal_emergency_recovery(const uint8_t* p_ntf, uint16_t len) {
+  pthread_t recovery_thread;
+  pthread_attr_t attr;
+  uint8_t bExpected = false;
+  int ret;
+
+  phNxpNciHal_dump_packet_trace();
+  if (!__atomic_compare_exchange_n(&bRecoveryActive, &bExpected, true, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    NXPLOG_NCIHAL_W("%s: recovery already running", __func__);
+    return;
+  }
+  if (nxpncihal_ctrl.halStatus == HAL_STATUS_CLOSE) {
+    NXPLOG_NCIHAL_E("%s: HAL not open, abort()", __func__);
+    phNxpLog_AsyncFlush();
+    abort();
+  }
+
+  gRecoveryNtfLen = (len < sizeof(gRecoveryNtf)) ? len : sizeof(gRecoveryNtf);
+  memcpy(gRecoveryNtf, p_ntf, gRecoveryNtfLen);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  ret = pthread_create(&recovery_thread, &attr, phNxpNciHal_recovery_thread,
+                       NULL);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    NXPLOG_NCIHAL_E("%s: pthread_create failed, abort()", __func__);
+    phNxpLog_AsyncFlush();
+    abort();
+  }
+}
@@ -68,6 +68,7 @@ typedef void(phNxpNciHal_control_granted_callback_t)();
 
 
 /* NCI Data */
+#define NCI_MT_DATA 0x00
 #define NCI_MT_CMD  0x20
 #define NCI_MT_RSP  0x40
 #define NCI_MT_NTF  0x60
@@ -76,7 +77,10 @@ typedef void(phNxpNciHal_control_granted_callback_t)();
 #define CORE_RESET_TRIGGER_TYPE_POWERED_ON              0x01
 #define NCI_MSG_CORE_RESET           0x00
 #define NCI_MSG_CORE_INIT            0x01
+#define NCI_MSG_CORE_SET_CONFIG      0x02
 #define NCI_MT_MASK                  0xE0
+#define NCI_PBF_MASK                 0x10
+#define NCI_GID_MASK                 0x0F
 #define NCI_OID_MASK                 0x3F
 
 #define NXP_MAX_CONFIG_STRING_LEN 260
@@ -116,6 +120,78 @@ typedef struct phNxpNciGpioInfo {
   uint8_t values[2];
 } phNxpNciGpioInfo_t;
 
+/* Messages dispatched by the client thread per wakeup, at most */
+#define PHNXPNCIHAL_DISPATCH_BATCH_MAX 16
+/* Batch size histogram buckets: 1, 2-3, 4-7, 8-15, 16 and above */
+#define PHNXPNCIHAL_DISPATCH_BUCKETS 5
+
+/* Client thread message dispatch statistics */
+typedef struct phNxpNciHal_DispatchStats {
+  uint32_t dwBatches;  /* Wakeups dispatching at least one message */
+  uint32_t dwMessages; /* Messages dispatched */
+  uint32_t dwMaxBatch; /* Largest batch */
+  uint32_t dwCapped;   /* Batches ended by PHNXPNCIHAL_DISPATCH_BATCH_MAX */
+  uint32_t aHistogram[PHNXPNCIHAL_DISPATCH_BUCKETS];
+} phNxpNciHal_DispatchStats_t;
+
+/* CORE_SET_CONFIG commands coalesced into one during core initialization */
+typedef struct phNxpNciHal_SetConfigBatch {
+  uint8_t aCmd[NCI_MAX_DATA_LEN]; /* Pending CORE_SET_CONFIG_CMD */
+  uint16_t wLen;                  /* 0 if nothing is pending */
+  uint16_t wCommands;             /* Commands coalesced into aCmd */
+} phNxpNciHal_SetConfigBatch_t;
+
+/* Open work done by a worker while TML and the NFCC come up */
+typedef struct phNxpNciHal_OpenPrefetch {
+  pthread_t thread;
+  bool_t bStarted;
+  bool_t bWaitChipType; /* Firmware library named after the chip type */
+  bool_t bChipTypeKnown;
+  bool_t bCancel;       /* Results needed, stop waiting for the chip type */
+  void* pFwHandle;      /* Firmware library mapped by the worker */
+} phNxpNciHal_OpenPrefetch_t;
+
+#define PHNXPNCIHAL_DATA_TX_WINDOW 4
+
+/* Data packets written to NFCC by the data writer thread, in order */
+typedef struct phNxpNciHal_DataTxQueue {
+  pthread_t thread;
+  bool_t bRunning;
+  bool_t bStop;     /* Exit once the queue is empty */
+  uint8_t bHead;    /* Packet being written */
+  uint8_t bCount;   /* Packets queued, including the one being written */
+  nci_data_t aPackets[PHNXPNCIHAL_DATA_TX_WINDOW];
+  uint32_t dwWritten;  /* Packets written */
+  uint32_t dwFailed;   /* Packets not accepted by NFCC */
+  uint32_t dwWaits;    /* Packets queued after waiting for a free slot */
+  uint32_t dwMaxDepth; /* Largest number of packets queued */
+} phNxpNciHal_DataTxQueue_t;
+
+/* Classes of the packets received from NFCC */
+#define PHNXPNCIHAL_RX_EXT 0x01        /* Processed by the HAL extensions */
+#define PHNXPNCIHAL_RX_OMAPI 0x02      /* OMAPI response of the eSE client */
+#define PHNXPNCIHAL_RX_CORE_NTF 0x04   /* Core notification, NCI 1.0 init */
+#define PHNXPNCIHAL_RX_NFCEE_DISC 0x08 /* NFCEE_DISCOVER_NTF, pn557 */
+#define PHNXPNCIHAL_RX_DATA 0x10       /* Data packet */
+
+/* Received packets are classified by MT, GID and OID, PBF excluded */
+#define PHNXPNCIHAL_RX_CLASS_ENTRIES (8 * 16 * 64)
+#define PHNXPNCIHAL_RX_CLASS_INDEX(hdr0, hdr1)                        \
+  ((((((hdr0) & NCI_MT_MASK) >> 1) | ((hdr0) & NCI_GID_MASK)) << 6) | \
+   ((hdr1) & NCI_OID_MASK))
+
+/* Data path workarounds of the HAL extensions, NXP_DATA_EXT_ALLOWLIST */
+#define PHNXPNCIHAL_DATA_EXT_MIFARE 0x01  /* MIFARE Classic responses */
+#define PHNXPNCIHAL_DATA_EXT_ICODE 0x02   /* ISO15693 frames */
+#define PHNXPNCIHAL_DATA_EXT_T1T_DTA 0x04 /* T1T commands in DTA mode */
+#define PHNXPNCIHAL_DATA_EXT_HCI 0x08     /* HCI WHITELIST, admin pipe */
+#define PHNXPNCIHAL_DATA_EXT_ALL 0x0F
+
+/* Connections whose data packets may bypass the HAL extensions, one bit per
+ * conn id, NXP_DATA_FAST_PATH_CONN_IDS */
+#define PHNXPNCIHAL_DATA_FAST_CONN_STATIC_RF 0x0001 /* Static RF conn id 0 */
+#define PHNXPNCIHAL_DATA_CONN_ID(hdr0) ((hdr0) & 0x0F)
+
 #ifdef ENABLE_ESE_CLIENT
 extern ESE_UPDATE_STATE eseUpdateSpi;
 extern ESE_UPDATE_STATE eseUpdateDwp;
@@ -128,6 +204,7 @@ extern ESE_UPDATE_STATE eseUpdateDwp;
 typedef struct phNxpNciInfo {
   uint8_t   nci_version;
   bool_t    wait_for_ntf;
+  uint8_t   max_ctrl_payload; /* From CORE_INIT_RSP, 0 if not known */
 }phNxpNciInfo_t;
 /* NCI Control structure */
 typedef struct phNxpNciHal_Control {
@@ -539,3 +616,38 @@ NFCSTATUS phNxpNciHal_resetEse();
  *
  *******************************************************************************/
 void phNxpNciHal_nciTransceive(phNxpNci_Extn_Cmd_t *in, phNxpNci_Extn_Resp_t *out);
+
+/******************************************************************************
+ * Function         phNxpNciHal_logNciStats
+ *
+ * Description      This function logs the client thread dispatch statistics,
+ *                  the monitor lock contention and the NCI command statistics.
+ *
+ * Returns          void.
+ *
+ *******************************************************************************/
+void phNxpNciHal_logNciStats(void);
+
+/******************************************************************************
+ * Function         phNxpNciHal_getDispatchStats
+ *
+ * Description      This function reads the batch size statistics of the
+ *                  client thread message dispatch.
+ *
+ * Returns          void.
+ *
+ *******************************************************************************/
+void phNxpNciHal_getDispatchStats(phNxpNciHal_DispatchStats_t* pStats);
+
+/******************************************************************************
+ * Function         phNxpNciHal_emergency_recovery
+ *
+ * Description      This function recovers the NFCC after it reported an
+ *                  unrecoverable error with the given CORE_RESET_NTF.
+ *                  Recovery runs asynchronously, the HAL is aborted only if
+ *                  it fails.
+ *
+ * Returns          void.
+ *
+ *******************************************************************************/
+void phNxpNciHal_emergency_recovery(const uint8_t* p_ntf, uint16_t len);
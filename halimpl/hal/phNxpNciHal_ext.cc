@@ -136,10 +136,6 @@ void phNxpNciHal_sendRfEvtToEseHal(uint8_t /* rfEvtType */ ) {
 NFCSTATUS phNxpNciHal_process_ext_rsp(uint8_t* p_ntf, uint16_t* p_len) {
   NFCSTATUS status = NFCSTATUS_SUCCESS;
   uint16_t rf_technology_length_param = 0;
-#ifdef ENABLE_ESE_CLIENT
-  gpEseAdapt = &EseAdaptation::GetInstance();
-  gpEseAdapt->Initialize();
-#endif
   /*parse and decode LxDebug Notifications*/
     if(p_ntf[0] == 0x6F && (p_ntf[1] == 0x35 || p_ntf[1] == 0x36))
     {
@@ -423,7 +419,7 @@ if(nfcFL.nfccFL._NFCC_FORCE_NCI1_0_INIT == true) {
   } else if (p_ntf[0] == 0x60 && p_ntf[1] == 0x00 && p_ntf[2] == 0x09 &&
              p_ntf[3] == 0x00 && nxpncihal_ctrl.is_wait_for_ce_ntf) {
     NXPLOG_NCIHAL_E("CORE_RESET_NTF 2 reason Unrecoverable error received !");
-    phNxpNciHal_emergency_recovery();
+    phNxpNciHal_emergency_recovery(p_ntf, *p_len);
   } else if (p_ntf[0] == 0x40 && p_ntf[1] == 0x01 &&
              nxpncihal_ctrl.is_wait_for_ce_ntf) {
     NXPLOG_NCIHAL_D("CORE_INIT_RSP 2 received !");
@@ -573,14 +569,19 @@ static NFCSTATUS phNxpNciHal_ext_process_nfc_init_rsp(uint8_t* p_ntf, uint16_t*
             /*Retreive reset ntf reason code irrespective of NCI 1.0 or 2.0*/
             if (p_ntf[3] == FW_DBG_REASON_AVAILABLE)
               property_set("persist.vendor.nfc.core_reset_debug_info", "true");
-        phNxpNciHal_emergency_recovery();
+        phNxpNciHal_emergency_recovery(p_ntf, *p_len);
         status = NFCSTATUS_FAILED;
       } /* Parsing CORE_INIT_RSP*/
     } else if (p_ntf[0] == NCI_MT_RSP && ((p_ntf[1] & NCI_OID_MASK) == NCI_MSG_CORE_INIT)) {
       if (nxpncihal_ctrl.nci_info.nci_version == NCI_VERSION_2_0) {
         NXPLOG_NCIHAL_D("CORE_INIT_RSP NCI2.0 received !");
+        if (*p_len > 11)
+          nxpncihal_ctrl.nci_info.max_ctrl_payload = p_ntf[11];
       } else {
         NXPLOG_NCIHAL_D("CORE_INIT_RSP NCI1.0 received !");
+        /* Max control payload follows the list of RF interfaces */
+        if ((*p_len > 8) && (*p_len > 12 + p_ntf[8]))
+          nxpncihal_ctrl.nci_info.max_ctrl_payload = p_ntf[12 + p_ntf[8]];
         int len = p_ntf[2] + 2; /*include 2 byte header*/
         wFwVerRsp = (((uint32_t)p_ntf[len - 2]) << 16U) |
                     (((uint32_t)p_ntf[len - 1]) << 8U) | p_ntf[len];
@@ -204,6 +204,39 @@ static void phNxpLog_SetNciTxLogLevel(uint8_t level) {
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         phNxpLog_SetAsync
+ *
+ * Description      Starts the asynchronous logging backend if NXPLOG_ASYNC is
+ *                  set in libnfc-nxp.conf or by the Android property
+ *                  nfc.nxp_log_async. Once started, the backend keeps running
+ *                  for the life of the process and the switch only selects
+ *                  whether the NXPLOG_* macros use it.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+static void phNxpLog_SetAsync(void) {
+  unsigned long num = 0;
+  int len;
+  char valueStr[PROPERTY_VALUE_MAX] = {0};
+
+  GetNxpNumValue(NAME_NXPLOG_ASYNC, &num, sizeof(num));
+
+  len = property_get(PROP_NAME_NXPLOG_ASYNC, valueStr, "");
+  if (len > 0) {
+    /* let Android property override .conf variable */
+    sscanf(valueStr, "%lu", &num);
+  }
+
+  if (num != 0) {
+    phNxpLog_AsyncStart();
+  } else {
+    gLog_async = false;
+  }
+}
+
 /******************************************************************************
  * Function         phNxpLog_InitializeLogLevel
  *
@@ -225,6 +258,7 @@ static void phNxpLog_SetNciTxLogLevel(uint8_t level) {
  *log
  *                      nfc.nxp_log_level_tml       * TML module log
  *                      nfc.nxp_log_level_nci       * NCI transaction log
+ *                      nfc.nxp_log_async           * asynchronous logging
  *
  *                  Log Level values:
  *                      NXPLOG_LOG_SILENT_LOGLEVEL  0        * No trace to show
@@ -244,13 +278,14 @@ void phNxpLog_InitializeLogLevel(void) {
   phNxpLog_SetTmlLogLevel(level);
   phNxpLog_SetDnldLogLevel(level);
   phNxpLog_SetNciTxLogLevel(level);
+  phNxpLog_SetAsync();
 
   ALOGD(
       "%s: global =%u, Fwdnld =%u, extns =%u, \
                 hal =%u, tml =%u, ncir =%u, \
-                ncix =%u",
+                ncix =%u, async =%u",
       __func__, gLog_level.global_log_level, gLog_level.dnld_log_level,
       gLog_level.extns_log_level, gLog_level.hal_log_level,
       gLog_level.tml_log_level, gLog_level.ncir_log_level,
-      gLog_level.ncix_log_level);
+      gLog_level.ncix_log_level, gLog_async);
 }
\ No newline at end of file
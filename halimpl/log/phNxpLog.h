@@ -18,6 +18,7 @@
 #define NXPLOG__H_INCLUDED
 
 #include <log/log.h>
+#include <phNxpLog_async.h>
 #include <phNxpNciHal_utils.h>
 typedef struct nci_log_level {
   uint8_t global_log_level;
@@ -52,6 +53,7 @@ extern bool nfc_debug_enabled;
 #define NAME_NXPLOG_NCIR_LOGLEVEL "NXPLOG_NCIR_LOGLEVEL"
 #define NAME_NXPLOG_FWDNLD_LOGLEVEL "NXPLOG_FWDNLD_LOGLEVEL"
 #define NAME_NXPLOG_TML_LOGLEVEL "NXPLOG_TML_LOGLEVEL"
+#define NAME_NXPLOG_ASYNC "NXPLOG_ASYNC"
 
 /* ####################### Set the log module name by Android property
  * ########################## */
@@ -61,6 +63,7 @@ extern bool nfc_debug_enabled;
 #define PROP_NAME_NXPLOG_NCI_LOGLEVEL "nfc.nxp_log_level_nci"
 #define PROP_NAME_NXPLOG_FWDNLD_LOGLEVEL "nfc.nxp_log_level_dnld"
 #define PROP_NAME_NXPLOG_TML_LOGLEVEL "nfc.nxp_log_level_tml"
+#define PROP_NAME_NXPLOG_ASYNC "nfc.nxp_log_async"
 
 /* ####################### Set the logging level for EVERY COMPONENT here
  * ######################## :START: */
@@ -102,6 +105,14 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
   LOG_PRI(ANDROID_LOG_VERBOSE, (COMP), "-:%s", (__func__))
 #endif /*NXP_VRBS_REQ*/
 
+/* Emits a log statement through the asynchronous backend when it is running
+ * and can take the statement, through liblog otherwise */
+#define NXPLOG_PRI(priority, tag, ...)                                  \
+  do {                                                                  \
+    if (!(gLog_async && phNxpLog_AsyncLog(priority, tag, __VA_ARGS__))) \
+      LOG_PRI(priority, tag, __VA_ARGS__);                              \
+  } while (0)
+
 /* ################################################################################################################
  */
 /* ######################################## Logging APIs of actual modules
@@ -110,22 +121,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
  */
 /* Logging APIs used by NxpExtns module */
 #if (ENABLE_EXTNS_TRACES == true)
-#define NXPLOG_EXTNS_D(...)                                       \
-  {                                                               \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
+#define NXPLOG_EXTNS_D(...)                                          \
+  {                                                                  \
+    if ((nfc_debug_enabled) ||                                       \
+      gLog_level.extns_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
   }
-#define NXPLOG_EXTNS_W(...)                                       \
-  {                                                               \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.extns_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)     \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_EXTNS, __VA_ARGS__);  \
+#define NXPLOG_EXTNS_W(...)                                         \
+  {                                                                 \
+    if ((nfc_debug_enabled) ||                                      \
+      gLog_level.extns_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
   }
-#define NXPLOG_EXTNS_E(...)                                        \
-  {                                                               \
-    if (gLog_level.extns_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
+#define NXPLOG_EXTNS_E(...)                                          \
+  {                                                                  \
+    if (gLog_level.extns_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_EXTNS, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_EXTNS_D(...)
@@ -135,22 +146,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpNciHal module */
 #if (ENABLE_HAL_TRACES == true)
-#define NXPLOG_NCIHAL_D(...)                                       \
-  {                                                                \
-    if ((nfc_debug_enabled) ||                                     \
-      gLog_level.hal_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)       \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
+#define NXPLOG_NCIHAL_D(...)                                          \
+  {                                                                   \
+    if ((nfc_debug_enabled) ||                                        \
+      gLog_level.hal_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)          \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
   }
-#define NXPLOG_NCIHAL_W(...)                                      \
-  {                                                               \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.hal_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)       \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
+#define NXPLOG_NCIHAL_W(...)                                         \
+  {                                                                  \
+    if ((nfc_debug_enabled) ||                                       \
+      gLog_level.hal_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)          \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
   }
-#define NXPLOG_NCIHAL_E(...)                                       \
-  {                                                                \
-    if (gLog_level.hal_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
+#define NXPLOG_NCIHAL_E(...)                                          \
+  {                                                                   \
+    if (gLog_level.hal_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)        \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIHAL, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_NCIHAL_D(...)
@@ -160,20 +171,20 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpNciX module */
 #if (ENABLE_NCIX_TRACES == true)
-#define NXPLOG_NCIX_D(...)                                       \
-  {                                                              \
-    if (gLog_level.ncix_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
+#define NXPLOG_NCIX_D(...)                                          \
+  {                                                                 \
+    if (gLog_level.ncix_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
   }
-#define NXPLOG_NCIX_W(...)                                      \
-  {                                                             \
-    if (gLog_level.ncix_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
+#define NXPLOG_NCIX_W(...)                                         \
+  {                                                                \
+    if (gLog_level.ncix_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
   }
-#define NXPLOG_NCIX_E(...)                                       \
-  {                                                              \
-    if (gLog_level.ncix_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
+#define NXPLOG_NCIX_E(...)                                          \
+  {                                                                 \
+    if (gLog_level.ncix_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIX, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_NCIX_D(...)
@@ -183,22 +194,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpNciR module */
 #if (ENABLE_NCIR_TRACES == true)
-#define NXPLOG_NCIR_D(...)                                       \
-  {                                                              \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.ncir_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)     \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
+#define NXPLOG_NCIR_D(...)                                          \
+  {                                                                 \
+    if ((nfc_debug_enabled) ||                                      \
+      gLog_level.ncir_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
   }
-#define NXPLOG_NCIR_W(...)                                      \
-  {                                                             \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.ncir_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
+#define NXPLOG_NCIR_W(...)                                         \
+  {                                                                \
+    if ((nfc_debug_enabled) ||                                     \
+      gLog_level.ncir_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
   }
-#define NXPLOG_NCIR_E(...)                                       \
-  {                                                              \
-    if (gLog_level.ncir_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
+#define NXPLOG_NCIR_E(...)                                          \
+  {                                                                 \
+    if (gLog_level.ncir_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_NCIR, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_NCIR_D(...)
@@ -208,22 +219,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpFwDnld module */
 #if (ENABLE_FWDNLD_TRACES == true)
-#define NXPLOG_FWDNLD_D(...)                                       \
-  {                                                                \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)     \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_FWDNLD_D(...)                                          \
+  {                                                                   \
+    if ((nfc_debug_enabled) ||                                        \
+      gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)         \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_FWDNLD_W(...)                                      \
-  {                                                               \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)      \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_FWDNLD_W(...)                                         \
+  {                                                                  \
+    if ((nfc_debug_enabled) ||                                       \
+      gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)         \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_FWDNLD_E(...)                                       \
-  {                                                                \
-    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_FWDNLD_E(...)                                          \
+  {                                                                   \
+    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_FWDNLD_D(...)
@@ -233,22 +244,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpTml module */
 #if (ENABLE_TML_TRACES == true)
-#define NXPLOG_TML_D(...)                                       \
-  {                                                             \
-    if ((nfc_debug_enabled) ||                                  \
-      gLog_level.tml_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_TML, __VA_ARGS__); \
+#define NXPLOG_TML_D(...)                                          \
+  {                                                                \
+    if ((nfc_debug_enabled) ||                                     \
+      gLog_level.tml_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_TML, __VA_ARGS__); \
   }
-#define NXPLOG_TML_W(...)                                      \
-  {                                                            \
-    if ((nfc_debug_enabled) ||                                 \
-      gLog_level.tml_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_TML, __VA_ARGS__); \
+#define NXPLOG_TML_W(...)                                         \
+  {                                                               \
+    if ((nfc_debug_enabled) ||                                    \
+      gLog_level.tml_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_TML, __VA_ARGS__); \
   }
-#define NXPLOG_TML_E(...)                                       \
-  {                                                             \
-    if (gLog_level.tml_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)  \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_TML, __VA_ARGS__); \
+#define NXPLOG_TML_E(...)                                          \
+  {                                                                \
+    if (gLog_level.tml_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)     \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_TML, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_TML_D(...)
@@ -259,22 +270,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 #ifdef NXP_HCI_REQ
 /* Logging APIs used by NxpHcpX module */
 #if (ENABLE_HCPX_TRACES == true)
-#define NXPLOG_HCPX_D(...)                                         \
-  {                                                                \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)     \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPX_D(...)                                            \
+  {                                                                   \
+    if ((nfc_debug_enabled) ||                                        \
+      gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)         \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPX_W(...)                                        \
-  {                                                               \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)      \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPX_W(...)                                           \
+  {                                                                  \
+    if ((nfc_debug_enabled) ||                                       \
+      gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)         \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPX_E(...)                                         \
-  {                                                                \
-    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPX_E(...)                                            \
+  {                                                                   \
+    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_HCPX_D(...)
@@ -284,22 +295,22 @@ extern const char* NXPLOG_ITEM_HCPR; /* Android logging tag for NxpHcpR   */
 
 /* Logging APIs used by NxpHcpR module */
 #if (ENABLE_HCPR_TRACES == true)
-#define NXPLOG_HCPR_D(...)                                         \
-  {                                                                \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)     \
-      LOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPR_D(...)                                            \
+  {                                                                   \
+    if ((nfc_debug_enabled) ||                                        \
+      gLog_level.dnld_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)         \
+      NXPLOG_PRI(ANDROID_LOG_DEBUG, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPR_W(...)                                        \
-  {                                                               \
-    if ((nfc_debug_enabled) ||                                    \
-      gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)      \
-      LOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPR_W(...)                                           \
+  {                                                                  \
+    if ((nfc_debug_enabled) ||                                       \
+      gLog_level.dnld_log_level >= NXPLOG_LOG_WARN_LOGLEVEL)         \
+      NXPLOG_PRI(ANDROID_LOG_WARN, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
-#define NXPLOG_HCPR_E(...)                                         \
-  {                                                                \
-    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)    \
-      LOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
+#define NXPLOG_HCPR_E(...)                                            \
+  {                                                                   \
+    if (gLog_level.dnld_log_level >= NXPLOG_LOG_ERROR_LOGLEVEL)       \
+      NXPLOG_PRI(ANDROID_LOG_ERROR, NXPLOG_ITEM_FWDNLD, __VA_ARGS__); \
   }
 #else
 #define NXPLOG_HCPR_D(...)
@@ -0,0 +1,672 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Asynchronous logging backend of the NXPLOG_* macros.
+ *
+ * A statement costs a clock read and a copy of its arguments on the calling
+ * thread, typically the TML reader or the HAL client thread, while the
+ * formatting and the liblog write are left to the drain thread.
+ *
+ * A thread gets a ring of its own on its first statement, so statements of
+ * one thread stay in order without any lock and the drain thread merges the
+ * rings by timestamp. Rings are taken from a fixed set of ASYNC_MAX_RINGS;
+ * the ring of an exited thread is reused once the drain thread emptied it.
+ * The drain thread runs every ASYNC_DRAIN_PERIOD_MS, earlier when a burst
+ * of statements fills half of a ring.
+ */
+#include <ctype.h>
+#include <log/log.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <phNxpLog_async.h>
+
+/* Records per ring, power of two */
+#define ASYNC_RING_RECORDS (0x20)
+#define ASYNC_RING_MASK (ASYNC_RING_RECORDS - 1)
+/* Rings available, threads logging once all are taken log synchronously */
+#define ASYNC_MAX_RINGS (16)
+/* Drain period when no ring fills up */
+#define ASYNC_DRAIN_PERIOD_MS (50)
+/* Longest message emitted */
+#define ASYNC_MAX_MESSAGE (1024)
+/* Thread specific value of a thread that did not get a ring */
+#define ASYNC_NO_RING ((void*)1)
+/* Longest conversion specification formatted */
+#define ASYNC_MAX_SPEC (24)
+
+typedef struct phNxpLog_AsyncRing {
+  phNxpLog_AsyncRecord_t aRecords[ASYNC_RING_RECORDS];
+  uint32_t dwHead;  /* Next record written, advanced by the owner */
+  uint32_t dwTail;  /* Next record drained, advanced by the drain thread */
+  uint8_t bInUse;   /* Owned by a thread or holding its records */
+  uint8_t bExited;  /* Owner exited, released once drained */
+} phNxpLog_AsyncRing_t;
+
+bool gLog_async = false;
+
+static phNxpLog_AsyncRing_t* gAsyncRings[ASYNC_MAX_RINGS];
+static pthread_mutex_t asyncMutex = PTHREAD_MUTEX_INITIALIZER;
+/* Serializes the drain thread and phNxpLog_AsyncFlush */
+static pthread_mutex_t asyncDrainMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t asyncRingKey;
+static pthread_t asyncThread;
+static sem_t asyncSemaphore;
+static bool bAsyncStarted = false;
+/* Statements logged synchronously because the ring of their thread was full
+ */
+static uint32_t dwAsyncOverflow = 0;
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncThreadExit
+**
+** Description      Destructor of the ring key, hands the ring of an exiting
+**                  thread over to the drain thread
+**
+** Parameters       pValue - ring of the thread
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpLog_AsyncThreadExit(void* pValue) {
+  phNxpLog_AsyncRing_t* pRing = (phNxpLog_AsyncRing_t*)pValue;
+
+  if (pValue != ASYNC_NO_RING) {
+    __atomic_store_n(&pRing->bExited, true, __ATOMIC_RELEASE);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncGetRing
+**
+** Description      Gets the ring of the calling thread, taking a free ring on
+**                  its first statement
+**
+** Parameters       None
+**
+** Returns          Ring of the thread, NULL if all rings are taken
+**
+*******************************************************************************/
+static phNxpLog_AsyncRing_t* phNxpLog_AsyncGetRing(void) {
+  void* pValue = pthread_getspecific(asyncRingKey);
+  phNxpLog_AsyncRing_t* pRing = NULL;
+  int i;
+
+  if (pValue == ASYNC_NO_RING) {
+    return NULL;
+  }
+  if (pValue != NULL) {
+    return (phNxpLog_AsyncRing_t*)pValue;
+  }
+
+  pthread_mutex_lock(&asyncMutex);
+  for (i = 0; i < ASYNC_MAX_RINGS; i++) {
+    if (gAsyncRings[i] == NULL) {
+      pRing = (phNxpLog_AsyncRing_t*)calloc(1, sizeof(phNxpLog_AsyncRing_t));
+      if (pRing != NULL) {
+        pRing->bInUse = true;
+        __atomic_store_n(&gAsyncRings[i], pRing, __ATOMIC_RELEASE);
+      }
+      break;
+    }
+    if (!gAsyncRings[i]->bInUse) {
+      pRing = gAsyncRings[i];
+      pRing->bExited = false;
+      pRing->bInUse = true;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&asyncMutex);
+
+  pthread_setspecific(asyncRingKey, (pRing != NULL) ? pRing : ASYNC_NO_RING);
+  return pRing;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncBegin
+**
+** Description      Reserves the next record of the ring of the calling thread
+**                  and fills its header
+**
+** Parameters       nPriority - Android log priority
+**                  pTag      - log tag
+**                  pFormat   - format string of the statement
+**
+** Returns          Record to be filled with the arguments and committed, NULL
+**                  if the statement has to be logged synchronously
+**
+*******************************************************************************/
+phNxpLog_AsyncRecord_t* phNxpLog_AsyncBegin(int nPriority, const char* pTag,
+                                            const char* pFormat) {
+  phNxpLog_AsyncRing_t* pRing = phNxpLog_AsyncGetRing();
+  phNxpLog_AsyncRecord_t* pRecord;
+  struct timespec tNow;
+
+  if (pRing == NULL) {
+    return NULL;
+  }
+  if ((pRing->dwHead - __atomic_load_n(&pRing->dwTail, __ATOMIC_ACQUIRE)) >=
+      ASYNC_RING_RECORDS) {
+    __atomic_fetch_add(&dwAsyncOverflow, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &tNow);
+  pRecord = &pRing->aRecords[pRing->dwHead & ASYNC_RING_MASK];
+  pRecord->qwTimestampNs = (uint64_t)tNow.tv_sec * 1000000000ULL + tNow.tv_nsec;
+  pRecord->pFormat = pFormat;
+  pRecord->pTag = pTag;
+  pRecord->nTid = gettid();
+  pRecord->bPriority = (uint8_t)nPriority;
+  pRecord->bArgs = 0;
+  pRecord->bPoolOverflow = false;
+  pRecord->wPoolUsed = 0;
+  return pRecord;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncSkipSpec
+**
+** Description      Skips the flags, width, precision and length modifier of
+**                  a conversion specification and its conversion character
+**
+** Parameters       pFormat  - format, after the '%' of the specification
+**                  ppLength - set to the length modifier
+**
+** Returns          Format after the specification, NULL if the format ends
+**                  before its conversion character
+**
+*******************************************************************************/
+static const char* phNxpLog_AsyncSkipSpec(const char* pFormat,
+                                          const char** ppLength) {
+  while ((*pFormat != '\0') && (strchr("-+ #0", *pFormat) != NULL)) {
+    pFormat++;
+  }
+  while (isdigit((unsigned char)*pFormat) || (*pFormat == '.') ||
+         (*pFormat == '*')) {
+    pFormat++;
+  }
+  *ppLength = pFormat;
+  while ((*pFormat != '\0') && (strchr("hljztL", *pFormat) != NULL)) {
+    pFormat++;
+  }
+  if (*pFormat == '\0') {
+    return NULL;
+  }
+  return pFormat + 1;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncStringsCaptured
+**
+** Description      Checks that every "%s" argument of a record was copied.
+**                  A pointer other than char* printed with "%s", such as a
+**                  uint8_t buffer, cannot be read by the drain thread.
+**                  Arguments are matched as phNxpLog_AsyncFormat does.
+**
+** Parameters       pRecord - record filled by the calling thread
+**
+** Returns          true if the record can be formatted by the drain thread
+**
+*******************************************************************************/
+static bool phNxpLog_AsyncStringsCaptured(
+    const phNxpLog_AsyncRecord_t* pRecord) {
+  const char* pFormat = pRecord->pFormat;
+  const char* pStart;
+  const char* pLength;
+  uint8_t bArg = 0;
+  uint8_t i;
+
+  for (i = 0; i < pRecord->bArgs; i++) {
+    if ((pRecord->aTypes[i] == phNxpLog_e_ArgPointer) &&
+        (pRecord->aArgs[i].pPointer != NULL)) {
+      break;
+    }
+  }
+  if (i == pRecord->bArgs) {
+    return true;
+  }
+
+  while ((pFormat = strchr(pFormat, '%')) != NULL) {
+    pStart = pFormat++;
+    if (*pFormat == '%') {
+      pFormat++;
+      continue;
+    }
+    pFormat = phNxpLog_AsyncSkipSpec(pFormat, &pLength);
+    if ((pFormat == NULL) || (bArg >= pRecord->bArgs)) {
+      break;
+    }
+    if (((size_t)(pFormat - pStart) >= ASYNC_MAX_SPEC) ||
+        (memchr(pStart, '*', pFormat - pStart) != NULL)) {
+      continue;
+    }
+    if ((pFormat[-1] == 's') &&
+        (pRecord->aTypes[bArg] == phNxpLog_e_ArgPointer) &&
+        (pRecord->aArgs[bArg].pPointer != NULL)) {
+      return false;
+    }
+    bArg++;
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncCommit
+**
+** Description      Publishes the record reserved by phNxpLog_AsyncBegin to
+**                  the drain thread
+**
+** Parameters       pRecord - record filled by the calling thread
+**
+** Returns          true if published, false if the statement has to be
+**                  logged synchronously, the record is then left unused
+**
+*******************************************************************************/
+bool phNxpLog_AsyncCommit(phNxpLog_AsyncRecord_t* pRecord) {
+  phNxpLog_AsyncRing_t* pRing =
+      (phNxpLog_AsyncRing_t*)pthread_getspecific(asyncRingKey);
+  uint32_t dwHead = pRing->dwHead + 1;
+
+  if (pRecord->bPoolOverflow || !phNxpLog_AsyncStringsCaptured(pRecord)) {
+    return false;
+  }
+  __atomic_store_n(&pRing->dwHead, dwHead, __ATOMIC_RELEASE);
+  if ((dwHead - __atomic_load_n(&pRing->dwTail, __ATOMIC_ACQUIRE)) ==
+      (ASYNC_RING_RECORDS / 2)) {
+    sem_post(&asyncSemaphore);
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncInteger
+**
+** Description      Gets an argument as an integer, whatever its type
+**
+** Parameters       pRecord - record
+**                  bArg    - index of the argument
+**
+** Returns          Value of the argument
+**
+*******************************************************************************/
+static uint64_t phNxpLog_AsyncInteger(const phNxpLog_AsyncRecord_t* pRecord,
+                                      uint8_t bArg) {
+  switch (pRecord->aTypes[bArg]) {
+    case phNxpLog_e_ArgDouble:
+      return (uint64_t)(int64_t)pRecord->aArgs[bArg].dValue;
+    case phNxpLog_e_ArgPointer:
+      return (uintptr_t)pRecord->aArgs[bArg].pPointer;
+    default:
+      return pRecord->aArgs[bArg].qwUnsigned;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncFormatArg
+**
+** Description      Formats one argument with its conversion specification.
+**                  Integers are converted to the type the length modifier
+**                  and conversion expect, as printf would have read them.
+**
+** Parameters       pRecord - record
+**                  bArg    - index of the argument
+**                  pSpec   - conversion specification, NUL terminated
+**                  pLength - length modifier within pSpec
+**                  pOut    - output
+**                  nSize   - space left in pOut
+**
+** Returns          Number of characters snprintf would have written
+**
+*******************************************************************************/
+static int phNxpLog_AsyncFormatArg(const phNxpLog_AsyncRecord_t* pRecord,
+                                   uint8_t bArg, const char* pSpec,
+                                   const char* pLength, char* pOut,
+                                   size_t nSize) {
+  char cConv = pSpec[strlen(pSpec) - 1];
+  uint64_t qwValue = phNxpLog_AsyncInteger(pRecord, bArg);
+  const char* pString;
+
+  switch (cConv) {
+    case 'd':
+    case 'i':
+      if (0 == strncmp(pLength, "hh", 2)) {
+        return snprintf(pOut, nSize, pSpec, (signed char)qwValue);
+      } else if (pLength[0] == 'h') {
+        return snprintf(pOut, nSize, pSpec, (short)qwValue);
+      } else if ((0 == strncmp(pLength, "ll", 2)) || (pLength[0] == 'j')) {
+        return snprintf(pOut, nSize, pSpec, (long long)qwValue);
+      } else if (pLength[0] == 'l') {
+        return snprintf(pOut, nSize, pSpec, (long)qwValue);
+      } else if ((pLength[0] == 'z') || (pLength[0] == 't')) {
+        return snprintf(pOut, nSize, pSpec, (ssize_t)qwValue);
+      }
+      return snprintf(pOut, nSize, pSpec, (int)qwValue);
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+      if (0 == strncmp(pLength, "hh", 2)) {
+        return snprintf(pOut, nSize, pSpec, (unsigned char)qwValue);
+      } else if (pLength[0] == 'h') {
+        return snprintf(pOut, nSize, pSpec, (unsigned short)qwValue);
+      } else if ((0 == strncmp(pLength, "ll", 2)) || (pLength[0] == 'j')) {
+        return snprintf(pOut, nSize, pSpec, (unsigned long long)qwValue);
+      } else if (pLength[0] == 'l') {
+        return snprintf(pOut, nSize, pSpec, (unsigned long)qwValue);
+      } else if ((pLength[0] == 'z') || (pLength[0] == 't')) {
+        return snprintf(pOut, nSize, pSpec, (size_t)qwValue);
+      }
+      return snprintf(pOut, nSize, pSpec, (unsigned int)qwValue);
+    case 'c':
+      return snprintf(pOut, nSize, pSpec, (int)qwValue);
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      if (pRecord->aTypes[bArg] != phNxpLog_e_ArgDouble) {
+        return snprintf(pOut, nSize, "(?)");
+      }
+      if (pLength[0] == 'L') {
+        return snprintf(pOut, nSize, pSpec,
+                        (long double)pRecord->aArgs[bArg].dValue);
+      }
+      return snprintf(pOut, nSize, pSpec, pRecord->aArgs[bArg].dValue);
+    case 'p':
+      return snprintf(pOut, nSize, pSpec, (void*)(uintptr_t)qwValue);
+    case 's':
+      if (pRecord->aTypes[bArg] == phNxpLog_e_ArgString) {
+        pString = &pRecord->aPool[pRecord->aArgs[bArg].qwUnsigned];
+      } else if ((pRecord->aTypes[bArg] == phNxpLog_e_ArgPointer) &&
+                 (pRecord->aArgs[bArg].pPointer == NULL)) {
+        pString = "(null)";
+      } else {
+        /* Not copied when logged, cannot be read now */
+        pString = "(?)";
+      }
+      return snprintf(pOut, nSize, pSpec, pString);
+    default:
+      return 0;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncFormat
+**
+** Description      Formats the message of a record. Conversions without an
+**                  argument and '*' widths are copied as they are.
+**
+** Parameters       pRecord - record
+**                  pOut    - output
+**                  nSize   - size of pOut
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpLog_AsyncFormat(const phNxpLog_AsyncRecord_t* pRecord,
+                                 char* pOut, size_t nSize) {
+  const char* pFormat = pRecord->pFormat;
+  const char* pStart;
+  const char* pLength;
+  char aSpec[ASYNC_MAX_SPEC];
+  size_t nUsed = 0;
+  size_t nSpecLen;
+  uint8_t bArg = 0;
+  int nWritten;
+
+  while ((*pFormat != '\0') && (nUsed < nSize - 1)) {
+    if (*pFormat != '%') {
+      pOut[nUsed++] = *pFormat++;
+      continue;
+    }
+    pStart = pFormat++;
+    if (*pFormat == '%') {
+      pOut[nUsed++] = *pFormat++;
+      continue;
+    }
+    pFormat = phNxpLog_AsyncSkipSpec(pFormat, &pLength);
+    if (pFormat == NULL) {
+      break;
+    }
+    nSpecLen = pFormat - pStart;
+
+    if ((bArg >= pRecord->bArgs) || (nSpecLen >= sizeof(aSpec)) ||
+        (memchr(pStart, '*', nSpecLen) != NULL)) {
+      nWritten = snprintf(&pOut[nUsed], nSize - nUsed, "%.*s", (int)nSpecLen,
+                          pStart);
+    } else {
+      memcpy(aSpec, pStart, nSpecLen);
+      aSpec[nSpecLen] = '\0';
+      nWritten = phNxpLog_AsyncFormatArg(pRecord, bArg++, aSpec,
+                                         &aSpec[pLength - pStart],
+                                         &pOut[nUsed], nSize - nUsed);
+    }
+    if (nWritten > 0) {
+      nUsed += ((size_t)nWritten < nSize - nUsed) ? (size_t)nWritten
+                                                  : (nSize - nUsed - 1);
+    }
+  }
+  pOut[nUsed] = '\0';
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncEmit
+**
+** Description      Writes the message of a record through liblog. liblog
+**                  stamps it with the drain thread id and time, so the
+**                  message is prefixed with the thread id of the statement.
+**
+** Parameters       pRecord  - record
+**                  pMessage - output, for the formatted message
+**                  nSize    - size of pMessage
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpLog_AsyncEmit(const phNxpLog_AsyncRecord_t* pRecord,
+                               char* pMessage, size_t nSize) {
+  int nPrefix;
+
+  if (!__android_log_is_loggable(pRecord->bPriority, pRecord->pTag,
+                                 ANDROID_LOG_VERBOSE)) {
+    return;
+  }
+  nPrefix = snprintf(pMessage, nSize, "[%d] ", (int)pRecord->nTid);
+  if ((nPrefix < 0) || ((size_t)nPrefix >= nSize)) {
+    nPrefix = 0;
+  }
+  phNxpLog_AsyncFormat(pRecord, &pMessage[nPrefix], nSize - nPrefix);
+  __android_log_buf_write(LOG_ID_MAIN, pRecord->bPriority, pRecord->pTag,
+                          pMessage);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncDrain
+**
+** Description      Emits the records of all rings in timestamp order and
+**                  releases the rings of exited threads once empty. Called
+**                  with asyncDrainMutex held.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpLog_AsyncDrain(void) {
+  static char aMessage[ASYNC_MAX_MESSAGE];
+  static uint32_t dwOverflowReported = 0;
+  phNxpLog_AsyncRing_t* pOldest;
+  phNxpLog_AsyncRing_t* pRing;
+  phNxpLog_AsyncRecord_t* pRecord;
+  uint32_t dwOverflow;
+  int i;
+
+  while (true) {
+    pOldest = NULL;
+    for (i = 0; i < ASYNC_MAX_RINGS; i++) {
+      pRing = __atomic_load_n(&gAsyncRings[i], __ATOMIC_ACQUIRE);
+      if (pRing == NULL) {
+        continue;
+      }
+      if (pRing->dwTail == __atomic_load_n(&pRing->dwHead, __ATOMIC_ACQUIRE)) {
+        continue;
+      }
+      if ((pOldest == NULL) ||
+          (pRing->aRecords[pRing->dwTail & ASYNC_RING_MASK].qwTimestampNs <
+           pOldest->aRecords[pOldest->dwTail & ASYNC_RING_MASK]
+               .qwTimestampNs)) {
+        pOldest = pRing;
+      }
+    }
+    if (pOldest == NULL) {
+      break;
+    }
+    pRecord = &pOldest->aRecords[pOldest->dwTail & ASYNC_RING_MASK];
+    phNxpLog_AsyncEmit(pRecord, aMessage, sizeof(aMessage));
+    __atomic_store_n(&pOldest->dwTail, pOldest->dwTail + 1, __ATOMIC_RELEASE);
+  }
+
+  /* Release the rings of exited threads, all their records are drained */
+  pthread_mutex_lock(&asyncMutex);
+  for (i = 0; i < ASYNC_MAX_RINGS; i++) {
+    pRing = gAsyncRings[i];
+    if ((pRing != NULL) && pRing->bInUse &&
+        __atomic_load_n(&pRing->bExited, __ATOMIC_ACQUIRE) &&
+        (pRing->dwTail == __atomic_load_n(&pRing->dwHead, __ATOMIC_ACQUIRE))) {
+      __atomic_store_n(&pRing->bInUse, false, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&asyncMutex);
+
+  dwOverflow = __atomic_load_n(&dwAsyncOverflow, __ATOMIC_RELAXED);
+  if (dwOverflow != dwOverflowReported) {
+    LOG_PRI(ANDROID_LOG_WARN, "NxpHal",
+            "Async log: %u statements logged synchronously, ring full",
+            dwOverflow - dwOverflowReported);
+    dwOverflowReported = dwOverflow;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncThread
+**
+** Description      Drain thread, emits the records of all threads every
+**                  ASYNC_DRAIN_PERIOD_MS or once a ring is half full
+**
+** Parameters       pParam - unused
+**
+** Returns          NULL
+**
+*******************************************************************************/
+static void* phNxpLog_AsyncThread(void* pParam) {
+  struct timespec tDeadline;
+  (void)pParam;
+
+  while (true) {
+    clock_gettime(CLOCK_REALTIME, &tDeadline);
+    tDeadline.tv_nsec += ASYNC_DRAIN_PERIOD_MS * 1000000L;
+    if (tDeadline.tv_nsec >= 1000000000L) {
+      tDeadline.tv_sec++;
+      tDeadline.tv_nsec -= 1000000000L;
+    }
+    (void)sem_timedwait(&asyncSemaphore, &tDeadline);
+    pthread_mutex_lock(&asyncDrainMutex);
+    phNxpLog_AsyncDrain();
+    pthread_mutex_unlock(&asyncDrainMutex);
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncStart
+**
+** Description      Starts the drain thread on first call and routes the
+**                  NXPLOG_* macros to the asynchronous backend. The drain
+**                  thread is never stopped, records logged until
+**                  gLog_async is cleared are still emitted.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpLog_AsyncStart(void) {
+  pthread_mutex_lock(&asyncMutex);
+  if (!bAsyncStarted) {
+    if ((0 != pthread_key_create(&asyncRingKey, phNxpLog_AsyncThreadExit)) ||
+        (0 != sem_init(&asyncSemaphore, 0, 0))) {
+      pthread_mutex_unlock(&asyncMutex);
+      ALOGE("%s: init failed", __func__);
+      return;
+    }
+    if (0 != pthread_create(&asyncThread, NULL, phNxpLog_AsyncThread, NULL)) {
+      sem_destroy(&asyncSemaphore);
+      pthread_key_delete(asyncRingKey);
+      pthread_mutex_unlock(&asyncMutex);
+      ALOGE("%s: thread creation failed", __func__);
+      return;
+    }
+    pthread_setname_np(asyncThread, "NxpLogDrain");
+    pthread_detach(asyncThread);
+    __atomic_store_n(&bAsyncStarted, true, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&asyncMutex);
+  gLog_async = true;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpLog_AsyncFlush
+**
+** Description      Emits the records of all threads before returning, to be
+**                  called before abort() so that the last statements are not
+**                  lost with the process
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpLog_AsyncFlush(void) {
+  if (!__atomic_load_n(&bAsyncStarted, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  pthread_mutex_lock(&asyncDrainMutex);
+  phNxpLog_AsyncDrain();
+  pthread_mutex_unlock(&asyncDrainMutex);
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Asynchronous logging backend of the NXPLOG_* macros.
+ *
+ * When enabled, a log statement does not format its message. It stores the
+ * format string pointer, which identifies the statement, and its raw
+ * arguments in a record of a ring owned by the calling thread. A drain
+ * thread formats the records of all threads in timestamp order and emits
+ * them through liblog with the tag and priority of the statement, the
+ * message prefixed with the thread id of the statement. Strings are
+ * copied when logged, up to PHNXPLOG_ASYNC_STRING_POOL bytes per record.
+ * Statements logged while the ring of the thread is full are counted and
+ * logged synchronously, as are statements with more than
+ * PHNXPLOG_ASYNC_MAX_ARGS arguments, with arguments of other types, with
+ * strings not fitting in the pool or printing a pointer other than char*
+ * with "%s".
+ */
+#ifndef PHNXPLOG_ASYNC_H
+#define PHNXPLOG_ASYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#define PHNXPLOG_ASYNC_MAX_ARGS (8)
+#define PHNXPLOG_ASYNC_STRING_POOL (256)
+
+/*
+ * Type of a captured argument
+ */
+typedef enum {
+  phNxpLog_e_ArgSigned = 0x00,
+  phNxpLog_e_ArgUnsigned,
+  phNxpLog_e_ArgDouble,
+  phNxpLog_e_ArgPointer,
+  phNxpLog_e_ArgString /* Offset in the string pool of the record */
+} phNxpLog_ArgType_t;
+
+typedef struct phNxpLog_AsyncRecord {
+  uint64_t qwTimestampNs; /* CLOCK_MONOTONIC */
+  const char* pFormat;    /* Format string, identifies the statement */
+  const char* pTag;
+  int32_t nTid;
+  uint8_t bPriority;
+  uint8_t bArgs;
+  uint8_t bPoolOverflow; /* A string did not fit, logged synchronously */
+  uint8_t aTypes[PHNXPLOG_ASYNC_MAX_ARGS]; /* phNxpLog_ArgType_t */
+  uint16_t wPoolUsed;
+  union {
+    int64_t nSigned;
+    uint64_t qwUnsigned;
+    double dValue;
+    const void* pPointer;
+  } aArgs[PHNXPLOG_ASYNC_MAX_ARGS];
+  char aPool[PHNXPLOG_ASYNC_STRING_POOL];
+} phNxpLog_AsyncRecord_t;
+
+/* Set once the backend is running, tested by the NXPLOG_* macros */
+extern bool gLog_async;
+
+/* Function declarations */
+void phNxpLog_AsyncStart(void);
+phNxpLog_AsyncRecord_t* phNxpLog_AsyncBegin(int nPriority, const char* pTag,
+                                            const char* pFormat);
+bool phNxpLog_AsyncCommit(phNxpLog_AsyncRecord_t* pRecord);
+void phNxpLog_AsyncFlush(void);
+
+/*
+ * Argument types that can be captured
+ */
+template <typename T>
+struct phNxpLog_AsyncCapturable
+    : std::integral_constant<
+          bool, std::is_integral<T>::value || std::is_enum<T>::value ||
+                    std::is_floating_point<T>::value ||
+                    std::is_pointer<T>::value ||
+                    std::is_same<T, std::nullptr_t>::value> {};
+
+template <typename... Args>
+struct phNxpLog_AsyncAllCapturable : std::true_type {};
+
+template <typename T, typename... Args>
+struct phNxpLog_AsyncAllCapturable<T, Args...>
+    : std::integral_constant<
+          bool, phNxpLog_AsyncCapturable<typename std::decay<T>::type>::value &&
+                    phNxpLog_AsyncAllCapturable<Args...>::value> {};
+
+template <typename T>
+static inline typename std::enable_if<std::is_integral<T>::value &&
+                                      std::is_signed<T>::value>::type
+phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord, T value) {
+  pRecord->aTypes[pRecord->bArgs] = phNxpLog_e_ArgSigned;
+  pRecord->aArgs[pRecord->bArgs++].nSigned = value;
+}
+
+template <typename T>
+static inline typename std::enable_if<std::is_integral<T>::value &&
+                                      !std::is_signed<T>::value>::type
+phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord, T value) {
+  pRecord->aTypes[pRecord->bArgs] = phNxpLog_e_ArgUnsigned;
+  pRecord->aArgs[pRecord->bArgs++].qwUnsigned = value;
+}
+
+template <typename T>
+static inline typename std::enable_if<std::is_enum<T>::value>::type
+phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord, T value) {
+  phNxpLog_AsyncArg(pRecord,
+                    static_cast<typename std::underlying_type<T>::type>(value));
+}
+
+template <typename T>
+static inline typename std::enable_if<std::is_floating_point<T>::value>::type
+phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord, T value) {
+  pRecord->aTypes[pRecord->bArgs] = phNxpLog_e_ArgDouble;
+  pRecord->aArgs[pRecord->bArgs++].dValue = value;
+}
+
+template <typename T>
+static inline typename std::enable_if<std::is_pointer<T>::value>::type
+phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord, T value) {
+  pRecord->aTypes[pRecord->bArgs] = phNxpLog_e_ArgPointer;
+  pRecord->aArgs[pRecord->bArgs++].pPointer = (const void*)value;
+}
+
+static inline void phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord,
+                                     std::nullptr_t) {
+  pRecord->aTypes[pRecord->bArgs] = phNxpLog_e_ArgPointer;
+  pRecord->aArgs[pRecord->bArgs++].pPointer = NULL;
+}
+
+/* Strings are copied, a string not fitting in the space left in the pool
+ * makes phNxpLog_AsyncCommit fail rather than being truncated */
+static inline void phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord,
+                                     const char* value) {
+  size_t nLeft = PHNXPLOG_ASYNC_STRING_POOL - pRecord->wPoolUsed;
+  size_t nLen;
+
+  if (value == NULL) {
+    phNxpLog_AsyncArg(pRecord, nullptr);
+    return;
+  }
+  nLen = strnlen(value, nLeft);
+  if (nLen == nLeft) {
+    pRecord->bPoolOverflow = true;
+    phNxpLog_AsyncArg(pRecord, nullptr);
+    return;
+  }
+  memcpy(&pRecord->aPool[pRecord->wPoolUsed], value, nLen);
+  pRecord->aPool[pRecord->wPoolUsed + nLen] = '\0';
+  pRecord->aTypes[pRecord->bArgs] = phNxpLog_e_ArgString;
+  pRecord->aArgs[pRecord->bArgs++].qwUnsigned = pRecord->wPoolUsed;
+  pRecord->wPoolUsed += nLen + 1;
+}
+
+static inline void phNxpLog_AsyncArg(phNxpLog_AsyncRecord_t* pRecord,
+                                     char* value) {
+  phNxpLog_AsyncArg(pRecord, (const char*)value);
+}
+
+static inline void phNxpLog_AsyncArgs(phNxpLog_AsyncRecord_t* pRecord) {
+  (void)pRecord;
+}
+
+template <typename T, typename... Args>
+static inline void phNxpLog_AsyncArgs(phNxpLog_AsyncRecord_t* pRecord, T value,
+                                      Args... args) {
+  phNxpLog_AsyncArg(pRecord, value);
+  phNxpLog_AsyncArgs(pRecord, args...);
+}
+
+template <typename... Args>
+static inline bool phNxpLog_AsyncCapture(std::true_type, int nPriority,
+                                         const char* pTag,
+                                         const char* pFormat, Args... args) {
+  phNxpLog_AsyncRecord_t* pRecord =
+      phNxpLog_AsyncBegin(nPriority, pTag, pFormat);
+
+  if (pRecord == NULL) {
+    return false;
+  }
+  phNxpLog_AsyncArgs(pRecord, args...);
+  return phNxpLog_AsyncCommit(pRecord);
+}
+
+template <typename... Args>
+static inline bool phNxpLog_AsyncCapture(std::false_type, int, const char*,
+                                         const char*, Args...) {
+  return false;
+}
+
+/*
+ * Stores a log statement in the ring of the calling thread. Returns false if
+ * the statement has to be logged synchronously: arguments not supported,
+ * no ring left for the thread, ring full, string pool full or "%s" pointer
+ * not copied.
+ */
+template <typename... Args>
+static inline bool phNxpLog_AsyncLog(int nPriority, const char* pTag,
+                                     const char* pFormat, Args... args) {
+  return phNxpLog_AsyncCapture(
+      std::integral_constant<
+          bool, (sizeof...(Args) <= PHNXPLOG_ASYNC_MAX_ARGS) &&
+                    phNxpLog_AsyncAllCapturable<Args...>::value>(),
+      nPriority, pTag, pFormat, args...);
+}
+
+#endif /* PHNXPLOG_ASYNC_H */
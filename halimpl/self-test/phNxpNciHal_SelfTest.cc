@@ -58,6 +58,8 @@ selftest_hdlr_t mSelfTestHdlr;
 /******************* Global variables *****************************************/
 
 static int thread_running = 0;
+static pthread_t test_rx_thread;
+static bool test_rx_thread_created = false;
 static uint32_t timeoutTimerId = 0;
 static int hal_write_timer_fired = 0;
 
@@ -825,6 +827,9 @@ static void* phNxpNciHal_test_rx_thread(void* arg) {
   while (thread_running == 1) {
     /* Fetch next message from the NFC stack message queue */
     if (phDal4Nfc_msgrcv(gDrvCfg.nClientId, &msg, 0, 0) == -1) {
+      if (errno == EIDRM) {
+        break;
+      }
       NXPLOG_NCIHAL_E("Received bad message");
       continue;
     }
@@ -1032,9 +1037,6 @@ clean_and_return:
  **
  ******************************************************************************/
 NFCSTATUS phNxpNciHal_TestMode_open(void) {
-  /* Thread */
-  pthread_t test_rx_thread;
-
   phOsalNfc_Config_t tOsalConfig;
   phTmlNfc_Config_t tTmlConfig;
   uint8_t* nfc_dev_node = NULL;
@@ -1091,12 +1093,10 @@ NFCSTATUS phNxpNciHal_TestMode_open(void) {
       nfc_dev_node = NULL;
     }
   }
-  pthread_attr_t attr;
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  /* Joined by phNxpNciHal_TestMode_close before the queue is freed */
   ret_val =
-      pthread_create(&test_rx_thread, &attr, phNxpNciHal_test_rx_thread, NULL);
-  pthread_attr_destroy(&attr);
+      pthread_create(&test_rx_thread, NULL, phNxpNciHal_test_rx_thread, NULL);
+  test_rx_thread_created = (ret_val == 0);
   if (ret_val != 0) {
     NXPLOG_NCIHAL_E("pthread_create failed");
     phTmlNfc_Shutdown();
@@ -1236,6 +1236,7 @@ NFCSTATUS phNxpNciHal_initialize_chipType()
 
 void phNxpNciHal_TestMode_close() {
   NFCSTATUS status = NFCSTATUS_SUCCESS;
+  bool released = false;
 
   CONCURRENCY_LOCK();
 
@@ -1253,6 +1254,7 @@ void phNxpNciHal_TestMode_close() {
     thread_running = 0;
 
     phDal4Nfc_msgrelease(gDrvCfg.nClientId);
+    released = true;
 
     status = phOsalNfc_Timer_Delete(timeoutTimerId);
   }
@@ -1261,6 +1263,17 @@ void phNxpNciHal_TestMode_close() {
   mSelfTestHdlr.mTransInfo.pBuff = NULL;
   CONCURRENCY_UNLOCK();
 
+  /* The receive thread takes REENTRANCE_LOCK only, it is joined without
+   * CONCURRENCY_LOCK and the queue freed once it has exited */
+  if (released && test_rx_thread_created) {
+    test_rx_thread_created = false;
+    if (0 == pthread_join(test_rx_thread, (void**)NULL)) {
+      (void)phDal4Nfc_msgctl(gDrvCfg.nClientId, IPC_RMID, NULL);
+    } else {
+      NXPLOG_NCIHAL_E("Fail to join self test thread");
+    }
+  }
+
   phNxpNciHal_cleanup_monitor();
 
   /* Return success always */
@@ -17,28 +17,187 @@
 /*
  * DAL independent message queue implementation for Android (can be used under
  * Linux too)
+ *
+ * Messages are copied into a preallocated ring of slots, each carrying a
+ * sequence number. Producers claim a slot with a compare and swap and publish
+ * it by advancing its sequence, so msgsnd neither allocates nor locks. The
+ * single consumer sleeps on a futex word that every producer increments after
+ * publishing, a wake up is only issued while the consumer is waiting.
+ * Should the ring fill up, messages spill into a locked overflow list, which
+ * keeps receiving them until the consumer has drained it, so that no message
+ * is lost and each producer's messages stay in order.
+ *
+ * Messages sent with PHDAL4NFC_MSG_URGENT go through a second ring and
+ * overflow list, the urgent lane, which the consumer always drains first.
+ * Order is kept within a lane only.
+ *
+ * phDal4Nfc_msgrelease only marks the queue released and wakes the consumer
+ * up, the queue is freed by phDal4Nfc_msgctl(IPC_RMID) once the consumer
+ * thread has exited.
  */
 
 #include <pthread.h>
 #include <phNxpLog.h>
+#include <linux/futex.h>
 #include <linux/ipc.h>
-#include <semaphore.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <errno.h>
 #include <phDal4Nfc_messageQueueLib.h>
 
+/* Ring size, power of two */
+#define PHDAL4NFC_QUEUE_SLOTS (128U)
+#define PHDAL4NFC_QUEUE_MASK (PHDAL4NFC_QUEUE_SLOTS - 1U)
+
+/* Lanes, in the order the consumer drains them */
+#define PHDAL4NFC_LANE_URGENT (0U)
+#define PHDAL4NFC_LANE_NORMAL (1U)
+#define PHDAL4NFC_LANES (2U)
+
 typedef struct phDal4Nfc_message_queue_item {
   phLibNfc_Message_t nMsg;
-  struct phDal4Nfc_message_queue_item* pPrev;
   struct phDal4Nfc_message_queue_item* pNext;
 } phDal4Nfc_message_queue_item_t;
 
+typedef struct phDal4Nfc_message_queue_slot {
+  uint32_t dwSeq; /* Equal to the claim position while free, +1 once filled */
+  phLibNfc_Message_t nMsg;
+} phDal4Nfc_message_queue_slot_t;
+
+typedef struct phDal4Nfc_message_lane {
+  phDal4Nfc_message_queue_slot_t aSlots[PHDAL4NFC_QUEUE_SLOTS];
+  uint32_t dwEnqueuePos;
+  uint32_t dwDequeuePos;
+  /* Overflow list, used while bOverflow is set */
+  uint32_t bOverflow;
+  phDal4Nfc_message_queue_item_t* pOverflowHead;
+  phDal4Nfc_message_queue_item_t* pOverflowTail;
+} phDal4Nfc_message_lane_t;
+
 typedef struct phDal4Nfc_message_queue {
-  phDal4Nfc_message_queue_item_t* pItems;
+  phDal4Nfc_message_lane_t aLanes[PHDAL4NFC_LANES];
+  /* Incremented by every producer, waited on by the consumer */
+  uint32_t dwFutex;
+  uint32_t bConsumerWaiting;
+  uint32_t bReleased;
+  /* Protects the overflow lists */
   pthread_mutex_t nCriticalSectionMutex;
-  sem_t nProcessSemaphore;
-
 } phDal4Nfc_message_queue_t;
 
+/*******************************************************************************
+**
+** Function         phDal4Nfc_futex
+**
+** Description      Waits on or wakes up a futex word private to the process
+**
+** Parameters       pWord - futex word
+**                  nOp   - FUTEX_WAIT or FUTEX_WAKE
+**                  dwVal - expected value for FUTEX_WAIT, number of waiters to
+**                          wake up for FUTEX_WAKE
+**
+** Returns          Result of the futex system call
+**
+*******************************************************************************/
+static long phDal4Nfc_futex(uint32_t* pWord, int nOp, uint32_t dwVal) {
+  return syscall(SYS_futex, pWord, nOp | FUTEX_PRIVATE_FLAG, dwVal, NULL, NULL,
+                 0);
+}
+
+/*******************************************************************************
+**
+** Function         phDal4Nfc_msgpush
+**
+** Description      Copies a message into the ring of a lane
+**
+** Parameters       pLane - lane of the message queue
+**                  msg   - message to be sent
+**
+** Returns          true if queued, false if the ring is full
+**
+*******************************************************************************/
+static bool_t phDal4Nfc_msgpush(phDal4Nfc_message_lane_t* pLane,
+                                phLibNfc_Message_t* msg) {
+  phDal4Nfc_message_queue_slot_t* pSlot;
+  uint32_t dwPos = __atomic_load_n(&pLane->dwEnqueuePos, __ATOMIC_RELAXED);
+  int32_t nDiff;
+
+  while (true) {
+    pSlot = &pLane->aSlots[dwPos & PHDAL4NFC_QUEUE_MASK];
+    nDiff = (int32_t)(__atomic_load_n(&pSlot->dwSeq, __ATOMIC_ACQUIRE) - dwPos);
+    if (0 == nDiff) {
+      if (__atomic_compare_exchange_n(&pLane->dwEnqueuePos, &dwPos, dwPos + 1,
+                                      true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (nDiff < 0) {
+      /* Consumer is a full lap behind */
+      return false;
+    } else {
+      dwPos = __atomic_load_n(&pLane->dwEnqueuePos, __ATOMIC_RELAXED);
+    }
+  }
+  memcpy(&pSlot->nMsg, msg, sizeof(phLibNfc_Message_t));
+  __atomic_store_n(&pSlot->dwSeq, dwPos + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         phDal4Nfc_msgpop
+**
+** Description      Takes the oldest message of a lane, from the ring first and
+**                  then from the overflow list once the ring is empty. Only
+**                  called by the consumer.
+**
+** Parameters       pQueue - message queue
+**                  pLane  - lane of the message queue
+**                  msg    - message received
+**
+** Returns          true if a message was taken
+**
+*******************************************************************************/
+static bool_t phDal4Nfc_msgpop(phDal4Nfc_message_queue_t* pQueue,
+                               phDal4Nfc_message_lane_t* pLane,
+                               phLibNfc_Message_t* msg) {
+  phDal4Nfc_message_queue_slot_t* pSlot;
+  phDal4Nfc_message_queue_item_t* p = NULL;
+  uint32_t dwPos = pLane->dwDequeuePos;
+
+  pSlot = &pLane->aSlots[dwPos & PHDAL4NFC_QUEUE_MASK];
+  if ((int32_t)(__atomic_load_n(&pSlot->dwSeq, __ATOMIC_ACQUIRE) -
+                (dwPos + 1)) == 0) {
+    memcpy(msg, &pSlot->nMsg, sizeof(phLibNfc_Message_t));
+    /* Hand the slot back to the producers for the next lap */
+    __atomic_store_n(&pSlot->dwSeq, dwPos + PHDAL4NFC_QUEUE_SLOTS,
+                     __ATOMIC_RELEASE);
+    pLane->dwDequeuePos = dwPos + 1;
+    return true;
+  }
+  /* Overflowed messages are younger than any message claimed in the ring,
+   * wait for slots still being filled by a producer */
+  if ((!__atomic_load_n(&pLane->bOverflow, __ATOMIC_ACQUIRE)) ||
+      (__atomic_load_n(&pLane->dwEnqueuePos, __ATOMIC_ACQUIRE) != dwPos)) {
+    return false;
+  }
+  pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
+  if (pLane->pOverflowHead != NULL) {
+    p = pLane->pOverflowHead;
+    pLane->pOverflowHead = p->pNext;
+  }
+  if (pLane->pOverflowHead == NULL) {
+    pLane->pOverflowTail = NULL;
+    __atomic_store_n(&pLane->bOverflow, false, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
+  if (p == NULL) {
+    return false;
+  }
+  memcpy(msg, &p->nMsg, sizeof(phLibNfc_Message_t));
+  free(p);
+  return true;
+}
+
 /*******************************************************************************
 **
 ** Function         phDal4Nfc_msgget
@@ -53,17 +212,20 @@ typedef struct phDal4Nfc_message_queue {
 *******************************************************************************/
 intptr_t phDal4Nfc_msgget(key_t key, int msgflg) {
   phDal4Nfc_message_queue_t* pQueue;
+  uint32_t i;
+  uint32_t dwLane;
   UNUSED(key);
   UNUSED(msgflg);
   pQueue =
       (phDal4Nfc_message_queue_t*)malloc(sizeof(phDal4Nfc_message_queue_t));
   if (pQueue == NULL) return -1;
   memset(pQueue, 0, sizeof(phDal4Nfc_message_queue_t));
-  if (pthread_mutex_init(&pQueue->nCriticalSectionMutex, NULL) == -1) {
-    free(pQueue);
-    return -1;
+  for (dwLane = 0; dwLane < PHDAL4NFC_LANES; dwLane++) {
+    for (i = 0; i < PHDAL4NFC_QUEUE_SLOTS; i++) {
+      pQueue->aLanes[dwLane].aSlots[i].dwSeq = i;
+    }
   }
-  if (sem_init(&pQueue->nProcessSemaphore, 0, 0) == -1) {
+  if (pthread_mutex_init(&pQueue->nCriticalSectionMutex, NULL) == -1) {
     free(pQueue);
     return -1;
   }
@@ -71,11 +233,45 @@ intptr_t phDal4Nfc_msgget(key_t key, int msgflg) {
   return ((intptr_t)pQueue);
 }
 
+/*******************************************************************************
+**
+** Function         phDal4Nfc_msgdrop
+**
+** Description      Drops the messages of the overflow lists
+**
+** Parameters       pQueue - message queue
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phDal4Nfc_msgdrop(phDal4Nfc_message_queue_t* pQueue) {
+  phDal4Nfc_message_lane_t* pLane;
+  phDal4Nfc_message_queue_item_t* p;
+  uint32_t dwLane;
+
+  pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
+  for (dwLane = 0; dwLane < PHDAL4NFC_LANES; dwLane++) {
+    pLane = &pQueue->aLanes[dwLane];
+    while (pLane->pOverflowHead != NULL) {
+      p = pLane->pOverflowHead;
+      pLane->pOverflowHead = p->pNext;
+      free(p);
+    }
+    pLane->pOverflowTail = NULL;
+    __atomic_store_n(&pLane->bOverflow, false, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
+}
+
 /*******************************************************************************
 **
 ** Function         phDal4Nfc_msgrelease
 **
-** Description      Releases message queue
+** Description      Releases message queue: drops the queued messages and
+**                  wakes up the consumer, whose phDal4Nfc_msgrcv then fails
+**                  with EIDRM. The queue stays allocated until
+**                  phDal4Nfc_msgctl(IPC_RMID) is called after the consumer
+**                  thread has exited.
 **
 ** Parameters       msqid - message queue handle
 **
@@ -86,13 +282,11 @@ void phDal4Nfc_msgrelease(intptr_t msqid) {
   phDal4Nfc_message_queue_t* pQueue = (phDal4Nfc_message_queue_t*)msqid;
 
   if (pQueue != NULL) {
-    sem_post(&pQueue->nProcessSemaphore);
-    if (sem_destroy(&pQueue->nProcessSemaphore)) {
-      NXPLOG_TML_E("Failed to destroy semaphore (errno=0x%08x)", errno);
-    }
-    pthread_mutex_destroy(&pQueue->nCriticalSectionMutex);
-
-    free(pQueue);
+    /* Wake up a consumer still waiting for a message */
+    __atomic_store_n(&pQueue->bReleased, true, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&pQueue->dwFutex, 1, __ATOMIC_SEQ_CST);
+    phDal4Nfc_futex(&pQueue->dwFutex, FUTEX_WAKE, INT32_MAX);
+    phDal4Nfc_msgdrop(pQueue);
   }
 
   return;
@@ -102,11 +296,16 @@ void phDal4Nfc_msgrelease(intptr_t msqid) {
 **
 ** Function         phDal4Nfc_msgctl
 **
-** Description      Destroys message queue
+** Description      Drops the messages of the overflow lists, and frees the
+**                  message queue if cmd is IPC_RMID. IPC_RMID may only be
+**                  used once no thread can use the queue anymore, the
+**                  consumer thread included.
 **
 ** Parameters       msqid - message queue handle
-**                  cmd, buf - ignored, included only for Linux queue API
-**                  compatibility
+**                  cmd   - IPC_RMID to free the queue, other values only
+**                          drop the overflowed messages
+**                  buf   - ignored, included only for Linux queue API
+**                          compatibility
 **
 ** Returns          0,  if successful
 **                  -1, if invalid handle is passed
@@ -114,29 +313,16 @@ void phDal4Nfc_msgrelease(intptr_t msqid) {
 *******************************************************************************/
 int phDal4Nfc_msgctl(intptr_t msqid, int cmd, void* buf) {
   phDal4Nfc_message_queue_t* pQueue;
-  phDal4Nfc_message_queue_item_t* p;
-  UNUSED(cmd);
   UNUSED(buf);
   if (msqid == 0) return -1;
 
   pQueue = (phDal4Nfc_message_queue_t*)msqid;
-  pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
-  if (pQueue->pItems != NULL) {
-    p = pQueue->pItems;
-    while (p->pNext != NULL) {
-      p = p->pNext;
-    }
-    while (p->pPrev != NULL) {
-      p = p->pPrev;
-      free(p->pNext);
-      p->pNext = NULL;
-    }
-    free(p);
+  phDal4Nfc_msgdrop(pQueue);
+
+  if (cmd == IPC_RMID) {
+    pthread_mutex_destroy(&pQueue->nCriticalSectionMutex);
+    free(pQueue);
   }
-  pQueue->pItems = NULL;
-  pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
-  pthread_mutex_destroy(&pQueue->nCriticalSectionMutex);
-  free(pQueue);
 
   return 0;
 }
@@ -146,45 +332,62 @@ int phDal4Nfc_msgctl(intptr_t msqid, int cmd, void* buf) {
 ** Function         phDal4Nfc_msgsnd
 **
 ** Description      Sends a message to the queue. The message will be added at
-**                  the end of the queue as appropriate for FIFO policy
+**                  the end of its lane as appropriate for FIFO policy
 **
 ** Parameters       msqid  - message queue handle
 **                  msgp   - message to be sent
 **                  msgsz  - message size
-**                  msgflg - ignored
+**                  msgflg - PHDAL4NFC_MSG_URGENT to send the message through
+**                           the urgent lane, 0 otherwise
 **
 ** Returns          0,  if successful
-**                  -1, if invalid parameter passed or failed to allocate memory
+**                  -1, if invalid parameter passed, failed to allocate memory
+**                      or queue released
 **
 *******************************************************************************/
 intptr_t phDal4Nfc_msgsnd(intptr_t msqid, phLibNfc_Message_t* msg, int msgflg) {
   phDal4Nfc_message_queue_t* pQueue;
-  phDal4Nfc_message_queue_item_t* p;
+  phDal4Nfc_message_lane_t* pLane;
   phDal4Nfc_message_queue_item_t* pNew;
-  UNUSED(msgflg);
+  bool_t bQueued = false;
   if ((msqid == 0) || (msg == NULL)) return -1;
 
   pQueue = (phDal4Nfc_message_queue_t*)msqid;
-  pNew = (phDal4Nfc_message_queue_item_t*)malloc(
-      sizeof(phDal4Nfc_message_queue_item_t));
-  if (pNew == NULL) return -1;
-  memset(pNew, 0, sizeof(phDal4Nfc_message_queue_item_t));
-  memcpy(&pNew->nMsg, msg, sizeof(phLibNfc_Message_t));
-  pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
-
-  if (pQueue->pItems != NULL) {
-    p = pQueue->pItems;
-    while (p->pNext != NULL) {
-      p = p->pNext;
+  if (__atomic_load_n(&pQueue->bReleased, __ATOMIC_ACQUIRE)) return -1;
+  pLane = &pQueue->aLanes[(msgflg & PHDAL4NFC_MSG_URGENT)
+                              ? PHDAL4NFC_LANE_URGENT
+                              : PHDAL4NFC_LANE_NORMAL];
+  if (!__atomic_load_n(&pLane->bOverflow, __ATOMIC_ACQUIRE)) {
+    bQueued = phDal4Nfc_msgpush(pLane, msg);
+  }
+  if (!bQueued) {
+    pNew = (phDal4Nfc_message_queue_item_t*)malloc(
+        sizeof(phDal4Nfc_message_queue_item_t));
+    if (pNew == NULL) return -1;
+    memcpy(&pNew->nMsg, msg, sizeof(phLibNfc_Message_t));
+    pNew->pNext = NULL;
+    pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
+    if (!pLane->bOverflow && phDal4Nfc_msgpush(pLane, msg)) {
+      /* Consumer drained the overflow or the ring meanwhile */
+      pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
+      free(pNew);
+    } else {
+      if (pLane->pOverflowTail != NULL) {
+        pLane->pOverflowTail->pNext = pNew;
+      } else {
+        NXPLOG_TML_D("Message queue full, overflowing");
+        pLane->pOverflowHead = pNew;
+      }
+      pLane->pOverflowTail = pNew;
+      __atomic_store_n(&pLane->bOverflow, true, __ATOMIC_RELEASE);
+      pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
     }
-    p->pNext = pNew;
-    pNew->pPrev = p;
-  } else {
-    pQueue->pItems = pNew;
   }
-  pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
 
-  sem_post(&pQueue->nProcessSemaphore);
+  __atomic_fetch_add(&pQueue->dwFutex, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&pQueue->bConsumerWaiting, __ATOMIC_SEQ_CST)) {
+    phDal4Nfc_futex(&pQueue->dwFutex, FUTEX_WAKE, 1);
+  }
 
   return 0;
 }
@@ -193,41 +396,55 @@ intptr_t phDal4Nfc_msgsnd(intptr_t msqid, phLibNfc_Message_t* msg, int msgflg) {
 **
 ** Function         phDal4Nfc_msgrcv
 **
-** Description      Gets the oldest message from the queue.
-**                  If the queue is empty the function waits (blocks on a mutex)
+** Description      Gets the oldest message from the queue, urgent messages
+**                  first.
+**                  If the queue is empty the function waits (blocks on a futex)
 **                  until a message is posted to the queue with phDal4Nfc_msgsnd
 **
 ** Parameters       msqid  - message queue handle
 **                  msgp   - message to be received
 **                  msgsz  - message size
 **                  msgtyp - ignored
-**                  msgflg - ignored
+**                  msgflg - IPC_NOWAIT to return at once if the queue is empty
 **
 ** Returns          0,  if successful
-**                  -1, if invalid parameter passed
+**                  -1, if invalid parameter passed, if the queue is empty
+**                      with IPC_NOWAIT (errno set to ENOMSG) or if the queue
+**                      is released (errno set to EIDRM), msg is then not set
 **
 *******************************************************************************/
 int phDal4Nfc_msgrcv(intptr_t msqid, phLibNfc_Message_t* msg, long msgtyp,
                      int msgflg) {
   phDal4Nfc_message_queue_t* pQueue;
-  phDal4Nfc_message_queue_item_t* p;
-  UNUSED(msgflg);
+  uint32_t dwFutex;
+  uint32_t dwLane;
+  bool_t bReceived = false;
   UNUSED(msgtyp);
   if ((msqid == 0) || (msg == NULL)) return -1;
 
   pQueue = (phDal4Nfc_message_queue_t*)msqid;
 
-  sem_wait(&pQueue->nProcessSemaphore);
-
-  pthread_mutex_lock(&pQueue->nCriticalSectionMutex);
-
-  if (pQueue->pItems != NULL) {
-    memcpy(msg, &(pQueue->pItems)->nMsg, sizeof(phLibNfc_Message_t));
-    p = pQueue->pItems->pNext;
-    free(pQueue->pItems);
-    pQueue->pItems = p;
+  while (true) {
+    dwFutex = __atomic_load_n(&pQueue->dwFutex, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pQueue->bReleased, __ATOMIC_SEQ_CST)) {
+      errno = EIDRM;
+      return -1;
+    }
+    for (dwLane = 0; (dwLane < PHDAL4NFC_LANES) && !bReceived; dwLane++) {
+      bReceived = phDal4Nfc_msgpop(pQueue, &pQueue->aLanes[dwLane], msg);
+    }
+    if (bReceived) {
+      break;
+    }
+    if (msgflg & IPC_NOWAIT) {
+      errno = ENOMSG;
+      return -1;
+    }
+    __atomic_store_n(&pQueue->bConsumerWaiting, true, __ATOMIC_SEQ_CST);
+    /* Returns at once if a producer published since dwFutex was read */
+    phDal4Nfc_futex(&pQueue->dwFutex, FUTEX_WAIT, dwFutex);
+    __atomic_store_n(&pQueue->bConsumerWaiting, false, __ATOMIC_SEQ_CST);
   }
-  pthread_mutex_unlock(&pQueue->nCriticalSectionMutex);
 
   return 0;
 }
@@ -24,6 +24,10 @@
 #include <linux/ipc.h>
 #include <phNfcTypes.h>
 
+/* msgflg of phDal4Nfc_msgsnd: the message overtakes the messages sent
+ * without this flag */
+#define PHDAL4NFC_MSG_URGENT (0x01)
+
 intptr_t phDal4Nfc_msgget(key_t key, int msgflg);
 void phDal4Nfc_msgrelease(intptr_t msqid);
 int phDal4Nfc_msgctl(intptr_t msqid, int cmd, void* buf);
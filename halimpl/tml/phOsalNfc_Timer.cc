@@ -16,18 +16,29 @@
 
 /*
  * OSAL Implementation for Timers.
+ *
+ * All timers are driven by one OSAL timer thread through a hierarchical
+ * timing wheel ticking every millisecond on CLOCK_MONOTONIC. A timer due
+ * within 64 ms sits in a slot of level 0, farther timers sit in the coarser
+ * slots of the upper levels and are cascaded down as the wheel turns. The
+ * thread sleeps until the next non-empty slot of level 0 or the next cascade,
+ * and posts the expired timers on the client thread.
+ *
+ * Timer handles are allocated by chunks on demand and recycled through a
+ * free list. Chunks are never freed, so that a timer message still queued on
+ * the client thread never points to released memory.
  */
 
-#include <signal.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <phNfcTypes.h>
 #include <phOsalNfc_Timer.h>
 #include <phNfcCommon.h>
 #include <phNxpNciHal.h>
 #include <phNxpLog.h>
 
-#define PH_NFC_MAX_TIMER (5U)
-static phOsalNfc_TimerHandle_t apTimerInfo[PH_NFC_MAX_TIMER];
-
 extern phNxpNciHal_Control_t nxpncihal_ctrl;
 
 /*
@@ -36,30 +47,433 @@ extern phNxpNciHal_Control_t nxpncihal_ctrl;
 #define PH_NFC_TIMER_BASE_ADDRESS (100U)
 
 /*
- *  Defines the value for invalid timerid returned during timeSetEvent
+ * Invalid timer ID type. This ID used indicate timer creation is failed */
+#define PH_NFC_TIMER_ID_INVALID (0xFFFF)
+
+/*
+ * Timer handles allocated at once, and highest number of handles the timer
+ * ids can address
  */
-#define PH_NFC_TIMER_ID_ZERO (0x00)
+#define PH_NFC_TIMER_CHUNK (8U)
+#define PH_NFC_TIMER_MAX_HANDLES \
+  (PH_NFC_TIMER_ID_INVALID - PH_NFC_TIMER_BASE_ADDRESS - 1U)
 
 /*
- * Invalid timer ID type. This ID used indicate timer creation is failed */
-#define PH_NFC_TIMER_ID_INVALID (0xFFFF)
+ * Timer wheel geometry: 4 levels of 64 slots cover 2^24 ms (4.6 hours),
+ * longer timers wait in the last slot reached and are re-inserted.
+ */
+#define PH_NFC_WHEEL_BITS (6U)
+#define PH_NFC_WHEEL_SLOTS (1U << PH_NFC_WHEEL_BITS)
+#define PH_NFC_WHEEL_MASK (PH_NFC_WHEEL_SLOTS - 1U)
+#define PH_NFC_WHEEL_LEVELS (4U)
+#define PH_NFC_WHEEL_MAX_DELTA \
+  ((1ULL << (PH_NFC_WHEEL_BITS * PH_NFC_WHEEL_LEVELS)) - 1ULL)
+
+static phOsalNfc_TimerHandle_t** apTimerChunks = NULL;
+static uint32_t dwTimerChunkCount = 0;
+static phOsalNfc_TimerHandle_t* pTimerFreeList = NULL;
+
+static phOsalNfc_TimerHandle_t* apTimerWheel[PH_NFC_WHEEL_LEVELS]
+                                            [PH_NFC_WHEEL_SLOTS];
+/* Next tick to be processed by the timer thread */
+static uint64_t qwWheelNow = 0;
+/* Number of timers linked in the wheel */
+static uint32_t dwWheelArmed = 0;
+
+static pthread_mutex_t timerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timerCond;
+static bool_t bTimerCondInit = false;
+static bool_t bTimerThreadRunning = false;
+static pthread_t timerThread;
 
 /* Forward declarations */
 static void phOsalNfc_PostTimerMsg(phLibNfc_Message_t* pMsg);
 static void phOsalNfc_DeferredCall(void* pParams);
-static void phOsalNfc_Timer_Expired(union sigval sv);
+static void phOsalNfc_Timer_Expired(phOsalNfc_TimerHandle_t* pTimerHandle);
 
 /*
  *************************** Function Definitions ******************************
  */
 
+/*******************************************************************************
+**
+** Function         phOsalNfc_TimerNowMs
+**
+** Description      Reads CLOCK_MONOTONIC in milliseconds
+**
+** Parameters       bRoundUp - round a partial millisecond up instead of down
+**
+** Returns          Current time in ms
+**
+*******************************************************************************/
+static uint64_t phOsalNfc_TimerNowMs(bool_t bRoundUp) {
+  struct timespec tNow;
+
+  clock_gettime(CLOCK_MONOTONIC, &tNow);
+  return (uint64_t)tNow.tv_sec * 1000ULL +
+         (tNow.tv_nsec + (bRoundUp ? 999999L : 0L)) / 1000000L;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_TimerLookup
+**
+** Description      Finds the handle of a timer id. Caller holds timerMutex.
+**
+** Parameters       dwTimerId - timer ID obtained during timer creation
+**
+** Returns          Timer handle, NULL if the timer does not exist
+**
+*******************************************************************************/
+static phOsalNfc_TimerHandle_t* phOsalNfc_TimerLookup(uint32_t dwTimerId) {
+  uint32_t dwIndex = dwTimerId - PH_NFC_TIMER_BASE_ADDRESS - 0x01;
+  phOsalNfc_TimerHandle_t* pTimerHandle;
+
+  if (dwIndex >= dwTimerChunkCount * PH_NFC_TIMER_CHUNK) {
+    return NULL;
+  }
+  pTimerHandle = &apTimerChunks[dwIndex / PH_NFC_TIMER_CHUNK]
+                               [dwIndex % PH_NFC_TIMER_CHUNK];
+  return (pTimerHandle->TimerId == dwTimerId) ? pTimerHandle : NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_TimerClear
+**
+** Description      Clears a timer handle. A stale expiry message of a previous
+**                  use of the handle still finds a deferred call, with no
+**                  parameter, so that it is ignored.
+**
+** Parameters       pTimerHandle - timer handle
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phOsalNfc_TimerClear(phOsalNfc_TimerHandle_t* pTimerHandle) {
+  memset(pTimerHandle, (uint8_t)0x00, sizeof(phOsalNfc_TimerHandle_t));
+  pTimerHandle->tDeferedCallInfo.pDeferedCall = &phOsalNfc_DeferredCall;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_TimerGrow
+**
+** Description      Allocates a chunk of timer handles when the free list is
+**                  empty. Caller holds timerMutex.
+**
+** Parameters       None
+**
+** Returns          true if a free handle is available
+**
+*******************************************************************************/
+static bool_t phOsalNfc_TimerGrow(void) {
+  phOsalNfc_TimerHandle_t** apChunks;
+  phOsalNfc_TimerHandle_t* pChunk;
+  uint32_t i;
+
+  if (NULL != pTimerFreeList) {
+    return true;
+  }
+  if ((dwTimerChunkCount + 1) * PH_NFC_TIMER_CHUNK > PH_NFC_TIMER_MAX_HANDLES) {
+    return false;
+  }
+  apChunks = (phOsalNfc_TimerHandle_t**)realloc(
+      apTimerChunks, (dwTimerChunkCount + 1) * sizeof(*apChunks));
+  if (NULL == apChunks) {
+    return false;
+  }
+  apTimerChunks = apChunks;
+  pChunk = (phOsalNfc_TimerHandle_t*)calloc(PH_NFC_TIMER_CHUNK,
+                                            sizeof(phOsalNfc_TimerHandle_t));
+  if (NULL == pChunk) {
+    return false;
+  }
+  apTimerChunks[dwTimerChunkCount++] = pChunk;
+  /* Push in reverse so that the lowest ids are handed out first */
+  for (i = PH_NFC_TIMER_CHUNK; i > 0; i--) {
+    phOsalNfc_TimerClear(&pChunk[i - 1]);
+    pChunk[i - 1].pNext = pTimerFreeList;
+    pTimerFreeList = &pChunk[i - 1];
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_TimerIdOf
+**
+** Description      Computes the timer id of a pooled handle
+**
+** Parameters       pTimerHandle - timer handle
+**
+** Returns          Timer id, 0 if the handle does not belong to the pool
+**
+*******************************************************************************/
+static uint32_t phOsalNfc_TimerIdOf(const phOsalNfc_TimerHandle_t* pTimerHandle) {
+  uint32_t dwChunk;
+
+  for (dwChunk = 0; dwChunk < dwTimerChunkCount; dwChunk++) {
+    if ((pTimerHandle >= apTimerChunks[dwChunk]) &&
+        (pTimerHandle < apTimerChunks[dwChunk] + PH_NFC_TIMER_CHUNK)) {
+      return PH_NFC_TIMER_BASE_ADDRESS + 0x01 + dwChunk * PH_NFC_TIMER_CHUNK +
+             (uint32_t)(pTimerHandle - apTimerChunks[dwChunk]);
+    }
+  }
+  return 0;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_WheelLink
+**
+** Description      Inserts a timer in the wheel slot matching its expiry.
+**                  Caller holds timerMutex.
+**
+** Parameters       pTimerHandle - timer handle with qwExpiry set
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phOsalNfc_WheelLink(phOsalNfc_TimerHandle_t* pTimerHandle) {
+  phOsalNfc_TimerHandle_t** ppSlot;
+  uint64_t qwExpiry = pTimerHandle->qwExpiry;
+  uint64_t qwDelta;
+  uint32_t dwLevel = 0;
+
+  if (qwExpiry < qwWheelNow) {
+    /* Already due, expire on the next tick */
+    qwExpiry = qwWheelNow;
+  }
+  qwDelta = qwExpiry - qwWheelNow;
+  if (qwDelta > PH_NFC_WHEEL_MAX_DELTA) {
+    qwDelta = PH_NFC_WHEEL_MAX_DELTA;
+    qwExpiry = qwWheelNow + qwDelta;
+  }
+  while ((dwLevel < PH_NFC_WHEEL_LEVELS - 1) &&
+         (qwDelta >> (PH_NFC_WHEEL_BITS * (dwLevel + 1))) != 0) {
+    dwLevel++;
+  }
+  pTimerHandle->wWheelSlot =
+      (uint16_t)((dwLevel << PH_NFC_WHEEL_BITS) |
+                 ((qwExpiry >> (PH_NFC_WHEEL_BITS * dwLevel)) &
+                  PH_NFC_WHEEL_MASK));
+  ppSlot = &apTimerWheel[0][0] + pTimerHandle->wWheelSlot;
+  pTimerHandle->pPrev = NULL;
+  pTimerHandle->pNext = *ppSlot;
+  if (NULL != *ppSlot) {
+    (*ppSlot)->pPrev = pTimerHandle;
+  }
+  *ppSlot = pTimerHandle;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_WheelUnlink
+**
+** Description      Removes a running timer from its wheel slot. Caller holds
+**                  timerMutex.
+**
+** Parameters       pTimerHandle - running timer handle
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phOsalNfc_WheelUnlink(phOsalNfc_TimerHandle_t* pTimerHandle) {
+  if (NULL != pTimerHandle->pNext) {
+    pTimerHandle->pNext->pPrev = pTimerHandle->pPrev;
+  }
+  if (NULL != pTimerHandle->pPrev) {
+    pTimerHandle->pPrev->pNext = pTimerHandle->pNext;
+  } else {
+    (&apTimerWheel[0][0])[pTimerHandle->wWheelSlot] = pTimerHandle->pNext;
+  }
+  pTimerHandle->pNext = NULL;
+  pTimerHandle->pPrev = NULL;
+  dwWheelArmed--;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_WheelCascade
+**
+** Description      Moves the timers of an upper level slot to the lower levels
+**                  as the wheel enters the period covered by the slot. Caller
+**                  holds timerMutex.
+**
+** Parameters       dwLevel - level of the slot, 1 or above
+**                  dwSlot  - slot index
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phOsalNfc_WheelCascade(uint32_t dwLevel, uint32_t dwSlot) {
+  phOsalNfc_TimerHandle_t* pTimerHandle = apTimerWheel[dwLevel][dwSlot];
+  phOsalNfc_TimerHandle_t* pNext;
+
+  apTimerWheel[dwLevel][dwSlot] = NULL;
+  while (NULL != pTimerHandle) {
+    pNext = pTimerHandle->pNext;
+    phOsalNfc_WheelLink(pTimerHandle);
+    pTimerHandle = pNext;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_WheelAdvance
+**
+** Description      Turns the wheel up to the current tick, cascading the upper
+**                  levels and expiring the timers met on the way. Caller holds
+**                  timerMutex.
+**
+** Parameters       qwNowMs - current tick
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phOsalNfc_WheelAdvance(uint64_t qwNowMs) {
+  phOsalNfc_TimerHandle_t* pTimerHandle;
+  phOsalNfc_TimerHandle_t* pNext;
+  uint32_t dwLevel;
+  uint32_t dwSlot;
+
+  while (qwWheelNow <= qwNowMs) {
+    if (0 == dwWheelArmed) {
+      /* Nothing to cascade nor expire, skip the idle period */
+      qwWheelNow = qwNowMs + 1;
+      break;
+    }
+    for (dwLevel = 1; dwLevel < PH_NFC_WHEEL_LEVELS; dwLevel++) {
+      if (0 != ((qwWheelNow >> (PH_NFC_WHEEL_BITS * (dwLevel - 1))) &
+                PH_NFC_WHEEL_MASK)) {
+        break;
+      }
+      phOsalNfc_WheelCascade(
+          dwLevel, (qwWheelNow >> (PH_NFC_WHEEL_BITS * dwLevel)) &
+                       PH_NFC_WHEEL_MASK);
+    }
+    dwSlot = qwWheelNow & PH_NFC_WHEEL_MASK;
+    pTimerHandle = apTimerWheel[0][dwSlot];
+    apTimerWheel[0][dwSlot] = NULL;
+    while (NULL != pTimerHandle) {
+      pNext = pTimerHandle->pNext;
+      pTimerHandle->pNext = NULL;
+      pTimerHandle->pPrev = NULL;
+      dwWheelArmed--;
+      phOsalNfc_Timer_Expired(pTimerHandle);
+      pTimerHandle = pNext;
+    }
+    qwWheelNow++;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_WheelNextTick
+**
+** Description      Finds the tick at which the timer thread has work to do,
+**                  either a non-empty slot of level 0 or the next cascade.
+**                  Caller holds timerMutex.
+**
+** Parameters       None
+**
+** Returns          Next tick, 0 if no timer is running
+**
+*******************************************************************************/
+static uint64_t phOsalNfc_WheelNextTick(void) {
+  uint64_t qwTick;
+
+  if (0 == dwWheelArmed) {
+    return 0;
+  }
+  if (0 == (qwWheelNow & PH_NFC_WHEEL_MASK)) {
+    return qwWheelNow;
+  }
+  for (qwTick = qwWheelNow; (qwTick & PH_NFC_WHEEL_MASK) != 0; qwTick++) {
+    if (NULL != apTimerWheel[0][qwTick & PH_NFC_WHEEL_MASK]) {
+      return qwTick;
+    }
+  }
+  return qwTick;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_TimerThread
+**
+** Description      OSAL timer thread, turns the wheel and sleeps until the
+**                  next tick with work or until a timer is started
+**
+** Parameters       pParam - unused
+**
+** Returns          NULL
+**
+*******************************************************************************/
+static void* phOsalNfc_TimerThread(void* pParam) {
+  struct timespec tWake;
+  uint64_t qwNextTick;
+  UNUSED(pParam);
+
+  pthread_mutex_lock(&timerMutex);
+  while (bTimerThreadRunning) {
+    phOsalNfc_WheelAdvance(phOsalNfc_TimerNowMs(false));
+    qwNextTick = phOsalNfc_WheelNextTick();
+    if (0 == qwNextTick) {
+      pthread_cond_wait(&timerCond, &timerMutex);
+    } else {
+      tWake.tv_sec = qwNextTick / 1000;
+      tWake.tv_nsec = (qwNextTick % 1000) * 1000000L;
+      pthread_cond_timedwait(&timerCond, &timerMutex, &tWake);
+    }
+  }
+  pthread_mutex_unlock(&timerMutex);
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phOsalNfc_TimerThreadStart
+**
+** Description      Starts the OSAL timer thread if it is not running. Caller
+**                  holds timerMutex.
+**
+** Parameters       None
+**
+** Returns          true if the timer thread is running
+**
+*******************************************************************************/
+static bool_t phOsalNfc_TimerThreadStart(void) {
+  pthread_condattr_t tAttr;
+
+  if (bTimerThreadRunning) {
+    return true;
+  }
+  if (!bTimerCondInit) {
+    pthread_condattr_init(&tAttr);
+    pthread_condattr_setclock(&tAttr, CLOCK_MONOTONIC);
+    if (0 != pthread_cond_init(&timerCond, &tAttr)) {
+      pthread_condattr_destroy(&tAttr);
+      return false;
+    }
+    pthread_condattr_destroy(&tAttr);
+    bTimerCondInit = true;
+  }
+  bTimerThreadRunning = true;
+  if (0 != pthread_create(&timerThread, NULL, phOsalNfc_TimerThread, NULL)) {
+    NXPLOG_TML_E("timer thread create error!");
+    bTimerThreadRunning = false;
+  }
+  return bTimerThreadRunning;
+}
+
 /*******************************************************************************
 **
 ** Function         phOsalNfc_Timer_Create
 **
 ** Description      Creates a timer which shall call back the specified function
 **                  when the timer expires. Fails if OSAL module is not
-**                  initialized or timers are already occupied
+**                  initialized or no timer handle can be allocated
 **
 ** Parameters       None
 **
@@ -69,41 +483,26 @@ static void phOsalNfc_Timer_Expired(union sigval sv);
 **
 *******************************************************************************/
 uint32_t phOsalNfc_Timer_Create(void) {
-  /* dwTimerId is also used as an index at which timer object can be stored */
-  uint32_t dwTimerId = PH_OSALNFC_TIMER_ID_INVALID;
-  static struct sigevent se;
+  uint32_t dwTimerId = PH_NFC_TIMER_ID_INVALID;
   phOsalNfc_TimerHandle_t* pTimerHandle;
-  /* Timer needs to be initialized for timer usage */
-
-  se.sigev_notify = SIGEV_THREAD;
-  se.sigev_notify_function = phOsalNfc_Timer_Expired;
-  se.sigev_notify_attributes = NULL;
-  dwTimerId = phUtilNfc_CheckForAvailableTimer();
 
-  /* Check whether timers are available, if yes create a timer handle structure
-   */
-  if ((PH_NFC_TIMER_ID_ZERO != dwTimerId) && (dwTimerId <= PH_NFC_MAX_TIMER)) {
-    pTimerHandle = (phOsalNfc_TimerHandle_t*)&apTimerInfo[dwTimerId - 1];
+  pthread_mutex_lock(&timerMutex);
+  /* Timer thread needs to be running for timer usage */
+  if (phOsalNfc_TimerThreadStart() && phOsalNfc_TimerGrow()) {
+    pTimerHandle = pTimerFreeList;
+    pTimerFreeList = pTimerHandle->pNext;
+    phOsalNfc_TimerClear(pTimerHandle);
     /* Build the Timer Id to be returned to Caller Function */
-    dwTimerId += PH_NFC_TIMER_BASE_ADDRESS;
-    se.sigev_value.sival_int = (int)dwTimerId;
-    /* Create POSIX timer */
-    if (timer_create(CLOCK_REALTIME, &se, &(pTimerHandle->hTimerHandle)) ==
-        -1) {
-      dwTimerId = PH_NFC_TIMER_ID_INVALID;
-    } else {
-      /* Set the state to indicate timer is ready */
-      pTimerHandle->eState = eTimerIdle;
-      /* Store the Timer Id which shall act as flag during check for timer
-       * availability */
-      pTimerHandle->TimerId = dwTimerId;
-    }
-  } else {
-    dwTimerId = PH_NFC_TIMER_ID_INVALID;
+    dwTimerId = phOsalNfc_TimerIdOf(pTimerHandle);
+    /* Set the state to indicate timer is ready */
+    pTimerHandle->eState = eTimerIdle;
+    /* Store the Timer Id which shall act as flag during check for timer
+     * availability */
+    pTimerHandle->TimerId = dwTimerId;
   }
+  pthread_mutex_unlock(&timerMutex);
 
-  /* Timer ID invalid can be due to Uninitialized state,Non availability of
-   * Timer */
+  /* Timer ID invalid can be due to timer thread or memory allocation failure */
   return dwTimerId;
 }
 
@@ -138,35 +537,34 @@ NFCSTATUS phOsalNfc_Timer_Start(uint32_t dwTimerId, uint32_t dwRegTimeCnt,
                                 pphOsalNfc_TimerCallbck_t pApplication_callback,
                                 void* pContext) {
   NFCSTATUS wStartStatus = NFCSTATUS_SUCCESS;
-
-  struct itimerspec its;
-  uint32_t dwIndex;
   phOsalNfc_TimerHandle_t* pTimerHandle;
-  /* Retrieve the index at which the timer handle structure is stored */
-  dwIndex = dwTimerId - PH_NFC_TIMER_BASE_ADDRESS - 0x01;
-  pTimerHandle = (phOsalNfc_TimerHandle_t*)&apTimerInfo[dwIndex];
-  /* OSAL Module needs to be initialized for timer usage */
+  /* Rounded up so that the timer never expires early */
+  uint64_t qwNowMs = phOsalNfc_TimerNowMs(true);
+
+  pthread_mutex_lock(&timerMutex);
+  pTimerHandle = phOsalNfc_TimerLookup(dwTimerId);
   /* Check whether the handle provided by user is valid */
-  if ((dwIndex < PH_NFC_MAX_TIMER) && (0x00 != pTimerHandle->TimerId) &&
-      (NULL != pApplication_callback)) {
-    its.it_interval.tv_sec = 0;
-    its.it_interval.tv_nsec = 0;
-    its.it_value.tv_sec = dwRegTimeCnt / 1000;
-    its.it_value.tv_nsec = 1000000 * (dwRegTimeCnt % 1000);
-    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
-      /* This would inadvertently stop the timer*/
-      its.it_value.tv_nsec = 1;
+  if ((NULL != pTimerHandle) && (NULL != pApplication_callback)) {
+    if (pTimerHandle->eState == eTimerRunning) {
+      phOsalNfc_WheelUnlink(pTimerHandle);
     }
     pTimerHandle->Application_callback = pApplication_callback;
     pTimerHandle->pContext = pContext;
     pTimerHandle->eState = eTimerRunning;
-    /* Arm the timer */
-    if ((timer_settime(pTimerHandle->hTimerHandle, 0, &its, NULL)) == -1) {
-      wStartStatus = PHNFCSTVAL(CID_NFC_OSAL, PH_OSALNFC_TIMER_START_ERROR);
+    pTimerHandle->qwExpiry = qwNowMs + dwRegTimeCnt;
+    if ((0 == dwWheelArmed) && (qwWheelNow < qwNowMs)) {
+      /* Idle wheel, move it to the current tick instead of letting the
+       * timer thread catch up */
+      qwWheelNow = qwNowMs - 1;
     }
+    /* Arm the timer */
+    phOsalNfc_WheelLink(pTimerHandle);
+    dwWheelArmed++;
+    pthread_cond_signal(&timerCond);
   } else {
     wStartStatus = PHNFCSTVAL(CID_NFC_OSAL, NFCSTATUS_INVALID_PARAMETER);
   }
+  pthread_mutex_unlock(&timerMutex);
 
   return wStartStatus;
 }
@@ -192,28 +590,22 @@ NFCSTATUS phOsalNfc_Timer_Start(uint32_t dwTimerId, uint32_t dwRegTimeCnt,
 *******************************************************************************/
 NFCSTATUS phOsalNfc_Timer_Stop(uint32_t dwTimerId) {
   NFCSTATUS wStopStatus = NFCSTATUS_SUCCESS;
-  static struct itimerspec its = {{0, 0}, {0, 0}};
-
-  uint32_t dwIndex;
   phOsalNfc_TimerHandle_t* pTimerHandle;
-  dwIndex = dwTimerId - PH_NFC_TIMER_BASE_ADDRESS - 0x01;
-  pTimerHandle = (phOsalNfc_TimerHandle_t*)&apTimerInfo[dwIndex];
-  /* OSAL Module and Timer needs to be initialized for timer usage */
+
+  pthread_mutex_lock(&timerMutex);
+  pTimerHandle = phOsalNfc_TimerLookup(dwTimerId);
   /* Check whether the TimerId provided by user is valid */
-  if ((dwIndex < PH_NFC_MAX_TIMER) && (0x00 != pTimerHandle->TimerId) &&
-      (pTimerHandle->eState != eTimerIdle)) {
+  if ((NULL != pTimerHandle) && (pTimerHandle->eState != eTimerIdle)) {
     /* Stop the timer only if the callback has not been invoked */
     if (pTimerHandle->eState == eTimerRunning) {
-      if ((timer_settime(pTimerHandle->hTimerHandle, 0, &its, NULL)) == -1) {
-        wStopStatus = PHNFCSTVAL(CID_NFC_OSAL, PH_OSALNFC_TIMER_STOP_ERROR);
-      } else {
-        /* Change the state of timer to Stopped */
-        pTimerHandle->eState = eTimerStopped;
-      }
+      phOsalNfc_WheelUnlink(pTimerHandle);
+      /* Change the state of timer to Stopped */
+      pTimerHandle->eState = eTimerStopped;
     }
   } else {
     wStopStatus = PHNFCSTVAL(CID_NFC_OSAL, NFCSTATUS_INVALID_PARAMETER);
   }
+  pthread_mutex_unlock(&timerMutex);
 
   return wStopStatus;
 }
@@ -239,26 +631,24 @@ NFCSTATUS phOsalNfc_Timer_Stop(uint32_t dwTimerId) {
 *******************************************************************************/
 NFCSTATUS phOsalNfc_Timer_Delete(uint32_t dwTimerId) {
   NFCSTATUS wDeleteStatus = NFCSTATUS_SUCCESS;
-
-  uint32_t dwIndex;
   phOsalNfc_TimerHandle_t* pTimerHandle;
-  dwIndex = dwTimerId - PH_NFC_TIMER_BASE_ADDRESS - 0x01;
-  pTimerHandle = (phOsalNfc_TimerHandle_t*)&apTimerInfo[dwIndex];
-  /* OSAL Module and Timer needs to be initialized for timer usage */
-
-  /* Check whether the TimerId passed by user is valid and Deregistering of
-   * timer is successful */
-  if ((dwIndex < PH_NFC_MAX_TIMER) && (0x00 != pTimerHandle->TimerId) &&
-      (NFCSTATUS_SUCCESS == phOsalNfc_CheckTimerPresence(pTimerHandle))) {
+
+  pthread_mutex_lock(&timerMutex);
+  pTimerHandle = phOsalNfc_TimerLookup(dwTimerId);
+  /* Check whether the TimerId passed by user is valid */
+  if (NULL != pTimerHandle) {
     /* Cancel the timer before deleting */
-    if (timer_delete(pTimerHandle->hTimerHandle) == -1) {
-      wDeleteStatus = PHNFCSTVAL(CID_NFC_OSAL, PH_OSALNFC_TIMER_DELETE_ERROR);
+    if (pTimerHandle->eState == eTimerRunning) {
+      phOsalNfc_WheelUnlink(pTimerHandle);
     }
-    /* Clear Timer structure used to store timer related data */
-    memset(pTimerHandle, (uint8_t)0x00, sizeof(phOsalNfc_TimerHandle_t));
+    /* Clear Timer structure used to store timer related data and recycle it */
+    phOsalNfc_TimerClear(pTimerHandle);
+    pTimerHandle->pNext = pTimerFreeList;
+    pTimerFreeList = pTimerHandle;
   } else {
     wDeleteStatus = PHNFCSTVAL(CID_NFC_OSAL, NFCSTATUS_INVALID_PARAMETER);
   }
+  pthread_mutex_unlock(&timerMutex);
   return wDeleteStatus;
 }
 
@@ -268,7 +658,8 @@ NFCSTATUS phOsalNfc_Timer_Delete(uint32_t dwTimerId) {
 **
 ** Description      Deletes all previously created timers
 **                  Allows to delete previously created timers. In case timer is
-**                  running, it is first stopped and then deleted
+**                  running, it is first stopped and then deleted. The timer
+**                  thread is stopped, it restarts with the next timer created.
 **
 ** Parameters       None
 **
@@ -279,21 +670,29 @@ void phOsalNfc_Timer_Cleanup(void) {
   /* Delete all timers */
   uint32_t dwIndex;
   phOsalNfc_TimerHandle_t* pTimerHandle;
-  for (dwIndex = 0; dwIndex < PH_NFC_MAX_TIMER; dwIndex++) {
-    pTimerHandle = (phOsalNfc_TimerHandle_t*)&apTimerInfo[dwIndex];
-    /* OSAL Module and Timer needs to be initialized for timer usage */
-
-    /* Check whether the TimerId passed by user is valid and Deregistering of
-     * timer is successful */
-    if ((0x00 != pTimerHandle->TimerId) &&
-        (NFCSTATUS_SUCCESS == phOsalNfc_CheckTimerPresence(pTimerHandle))) {
-      /* Cancel the timer before deleting */
-      if (timer_delete(pTimerHandle->hTimerHandle) == -1) {
-        NXPLOG_TML_E("timer %d delete error!", dwIndex);
-      }
-      /* Clear Timer structure used to store timer related data */
-      memset(pTimerHandle, (uint8_t)0x00, sizeof(phOsalNfc_TimerHandle_t));
-    }
+  bool_t bJoin;
+
+  pthread_mutex_lock(&timerMutex);
+  memset(apTimerWheel, 0x00, sizeof(apTimerWheel));
+  dwWheelArmed = 0;
+  pTimerFreeList = NULL;
+  for (dwIndex = dwTimerChunkCount * PH_NFC_TIMER_CHUNK; dwIndex > 0;
+       dwIndex--) {
+    pTimerHandle = &apTimerChunks[(dwIndex - 1) / PH_NFC_TIMER_CHUNK]
+                                 [(dwIndex - 1) % PH_NFC_TIMER_CHUNK];
+    /* Clear Timer structure used to store timer related data */
+    phOsalNfc_TimerClear(pTimerHandle);
+    pTimerHandle->pNext = pTimerFreeList;
+    pTimerFreeList = pTimerHandle;
+  }
+  bJoin = bTimerThreadRunning;
+  bTimerThreadRunning = false;
+  if (bJoin) {
+    pthread_cond_signal(&timerCond);
+  }
+  pthread_mutex_unlock(&timerMutex);
+  if (bJoin) {
+    pthread_join(timerThread, NULL);
   }
 
   return;
@@ -314,16 +713,23 @@ void phOsalNfc_Timer_Cleanup(void) {
 *******************************************************************************/
 static void phOsalNfc_DeferredCall(void* pParams) {
   /* Retrieve the timer id from the parameter */
-  uint32_t dwIndex;
+  uint32_t dwTimerId = (uint32_t)(uintptr_t)pParams;
   phOsalNfc_TimerHandle_t* pTimerHandle;
+  pphOsalNfc_TimerCallbck_t pApplication_callback = NULL;
+  void* pContext = NULL;
+
   if (NULL != pParams) {
-    /* Retrieve the index at which the timer handle structure is stored */
-    dwIndex = (uintptr_t)pParams - PH_NFC_TIMER_BASE_ADDRESS - 0x01;
-    pTimerHandle = (phOsalNfc_TimerHandle_t*)&apTimerInfo[dwIndex];
-    if (pTimerHandle->Application_callback != NULL) {
+    pthread_mutex_lock(&timerMutex);
+    /* Timer may have been deleted since the message was posted */
+    pTimerHandle = phOsalNfc_TimerLookup(dwTimerId);
+    if (NULL != pTimerHandle) {
+      pApplication_callback = pTimerHandle->Application_callback;
+      pContext = pTimerHandle->pContext;
+    }
+    pthread_mutex_unlock(&timerMutex);
+    if (pApplication_callback != NULL) {
       /* Invoke the callback function with osal Timer ID */
-      pTimerHandle->Application_callback((uintptr_t)pParams,
-                                         pTimerHandle->pContext);
+      pApplication_callback(dwTimerId, pContext);
     }
   }
 
@@ -337,7 +743,8 @@ static void phOsalNfc_DeferredCall(void* pParams) {
 ** Description      Posts message on the user thread
 **                  Shall be invoked upon expiration of a timer
 **                  Shall post message on user thread through which timer
-**                  callback function shall be invoked
+**                  callback function shall be invoked. Timeouts are urgent,
+**                  they overtake the notifications queued.
 **
 ** Parameters       pMsg - pointer to the message structure posted on user
 **                         thread
@@ -349,7 +756,7 @@ static void phOsalNfc_PostTimerMsg(phLibNfc_Message_t* pMsg) {
   (void)phDal4Nfc_msgsnd(
       nxpncihal_ctrl.gDrvCfg
           .nClientId /*gpphOsalNfc_Context->dwCallbackThreadID*/,
-      pMsg, 0);
+      pMsg, PHDAL4NFC_MSG_URGENT);
 
   return;
 }
@@ -359,24 +766,24 @@ static void phOsalNfc_PostTimerMsg(phLibNfc_Message_t* pMsg) {
 ** Function         phOsalNfc_Timer_Expired
 **
 ** Description      posts message upon expiration of timer
-**                  Shall be invoked when any one timer is expired
+**                  Shall be invoked by the timer thread when any one timer is
+**                  expired, with timerMutex held
 **                  Shall post message on user thread to invoke respective
 **                  callback function provided by the caller of Timer function
 **
+** Parameters       pTimerHandle - expired timer, already unlinked from the
+**                                 wheel
+**
 ** Returns          None
 **
 *******************************************************************************/
-static void phOsalNfc_Timer_Expired(union sigval sv) {
-  uint32_t dwIndex;
-  phOsalNfc_TimerHandle_t* pTimerHandle;
-
-  dwIndex = ((uint32_t)(sv.sival_int)) - PH_NFC_TIMER_BASE_ADDRESS - 0x01;
-  pTimerHandle = (phOsalNfc_TimerHandle_t*)&apTimerInfo[dwIndex];
+static void phOsalNfc_Timer_Expired(phOsalNfc_TimerHandle_t* pTimerHandle) {
   /* Timer is stopped when callback function is invoked */
   pTimerHandle->eState = eTimerStopped;
 
   pTimerHandle->tDeferedCallInfo.pDeferedCall = &phOsalNfc_DeferredCall;
-  pTimerHandle->tDeferedCallInfo.pParam = (void*)((intptr_t)(sv.sival_int));
+  pTimerHandle->tDeferedCallInfo.pParam =
+      (void*)((uintptr_t)pTimerHandle->TimerId);
 
   pTimerHandle->tOsalMessage.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
   pTimerHandle->tOsalMessage.pMsgData = (void*)&pTimerHandle->tDeferedCallInfo;
@@ -391,26 +798,22 @@ static void phOsalNfc_Timer_Expired(union sigval sv) {
 **
 ** Function         phUtilNfc_CheckForAvailableTimer
 **
-** Description      Find an available timer id
+** Description      Find an available timer id, growing the pool of timer
+**                  handles if needed
 **
 ** Parameters       void
 **
-** Returns          Available timer id
+** Returns          Available timer id, 0 if none can be allocated
 **
 *******************************************************************************/
 uint32_t phUtilNfc_CheckForAvailableTimer(void) {
-  /* Variable used to store the index at which the object structure details
-     can be stored. Initialize it as not available. */
-  uint32_t dwIndex = 0x00;
   uint32_t dwRetval = 0x00;
 
-  /* Check whether Timer object can be created */
-  for (dwIndex = 0x00; ((dwIndex < PH_NFC_MAX_TIMER) && (0x00 == dwRetval));
-       dwIndex++) {
-    if (!(apTimerInfo[dwIndex].TimerId)) {
-      dwRetval = (dwIndex + 0x01);
-    }
+  pthread_mutex_lock(&timerMutex);
+  if (phOsalNfc_TimerGrow()) {
+    dwRetval = phOsalNfc_TimerIdOf(pTimerFreeList) - PH_NFC_TIMER_BASE_ADDRESS;
   }
+  pthread_mutex_unlock(&timerMutex);
 
   return (dwRetval);
 }
@@ -428,17 +831,16 @@ uint32_t phUtilNfc_CheckForAvailableTimer(void) {
 **
 *******************************************************************************/
 NFCSTATUS phOsalNfc_CheckTimerPresence(void* pObjectHandle) {
-  uint32_t dwIndex;
   NFCSTATUS wRegisterStatus = NFCSTATUS_INVALID_PARAMETER;
-
-  for (dwIndex = 0x00;
-       ((dwIndex < PH_NFC_MAX_TIMER) && (wRegisterStatus != NFCSTATUS_SUCCESS));
-       dwIndex++) {
-    /* For Timer, check whether the requested handle is present or not */
-    if (((&apTimerInfo[dwIndex]) == (phOsalNfc_TimerHandle_t*)pObjectHandle) &&
-        (apTimerInfo[dwIndex].TimerId)) {
-      wRegisterStatus = NFCSTATUS_SUCCESS;
-    }
+  phOsalNfc_TimerHandle_t* pTimerHandle =
+      (phOsalNfc_TimerHandle_t*)pObjectHandle;
+
+  pthread_mutex_lock(&timerMutex);
+  /* For Timer, check whether the requested handle is present or not */
+  if ((NULL != pTimerHandle) && (0 != phOsalNfc_TimerIdOf(pTimerHandle)) &&
+      (pTimerHandle->TimerId)) {
+    wRegisterStatus = NFCSTATUS_SUCCESS;
   }
+  pthread_mutex_unlock(&timerMutex);
   return wRegisterStatus;
 }
@@ -23,8 +23,17 @@
 #include <phNxpLog.h>
 #include <phDal4Nfc_messageQueueLib.h>
 #include <phTmlNfc_i2c.h>
+#include <phTmlNfc_virtual.h>
+#include <phTmlNfc_stats.h>
+#include <phTmlNfc_capture.h>
+#include <phTmlNfc_replay.h>
 #include <phNxpNciHal_utils.h>
 #include <errno.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <poll.h>
 
 /*
  * Duration of Timer to wait after sending an Nci packet
@@ -33,15 +42,15 @@
 #define MAX_WRITE_RETRY_COUNT 0x03
 #define MAX_READ_RETRY_COUNT 0x05
 
-/* Retry Count = Standby Recovery time of NFCC / Retransmission time + 1 */
-static uint8_t bCurrentRetryCount = (2000 / PHTMLNFC_MAXTIME_RETRANSMIT) + 1;
-
 /* Value to reset variables of TML  */
 #define PH_TMLNFC_RESET_VALUE (0x00)
 
 /* Indicates a Initial or offset value */
 #define PH_TMLNFC_VALUE_ONE (0x01)
 
+/* Maximum number of epoll events handled per event loop wakeup */
+#define PH_TMLNFC_MAX_EPOLL_EVENTS (0x03)
+
 /* Initialize Context structure pointer used to access context structure */
 phTmlNfc_i2cfragmentation_t fragmentation_enabled;
 phTmlNfc_Context_t* gpphTmlNfc_Context = NULL;
@@ -51,11 +60,25 @@ static void phTmlNfc_ReadDeferredCb(void* pParams);
 static void phTmlNfc_WriteDeferredCb(void* pParams);
 static void* phTmlNfc_TmlThread(void* pParam);
 static void* phTmlNfc_TmlWriterThread(void* pParam);
-static void phTmlNfc_ReTxTimerCb(uint32_t dwTimerId, void* pContext);
+static void phTmlNfc_ReTxTimerExpired(void);
 static NFCSTATUS phTmlNfc_InitiateTimer(void);
-static void phTmlNfc_WaitWriteComplete(void);
-static void phTmlNfc_SignalWriteComplete(void);
-static int phTmlNfc_WaitReadInit(void);
+static void phTmlNfc_PostEvent(sem_t* pSemaphore);
+static void phTmlNfc_PostWriteEvent(void);
+static NFCSTATUS phTmlNfc_StopTimer(void);
+static NFCSTATUS phTmlNfc_StartEventLoop(void);
+static void* phTmlNfc_TmlEventLoopThread(void* pParam);
+static void phTmlNfc_EventLoopRead(void);
+static void phTmlNfc_EventLoopWrite(void);
+static phTmlNfc_RxSlot_t* phTmlNfc_GetRxSlot(uint8_t bWait);
+static void phTmlNfc_QueueRxSlot(phTmlNfc_RxSlot_t* pSlot, NFCSTATUS wStatus,
+                                 uint16_t wLength);
+static void phTmlNfc_DeliverRxSlot(void);
+static void phTmlNfc_PutRxSlot(void);
+static void phTmlNfc_ReleaseRxSlot(phTmlNfc_RxSlot_t* pSlot);
+static void phTmlNfc_PostMsg(phLibNfc_Message_t* ptWorkerMsg, int nMsgFlg);
+static void* phTmlNfc_TmlReadAheadThread(void* pParam);
+static uint32_t phTmlNfc_BeginWriteSeq(void);
+static void phTmlNfc_CompleteWriteSeq(uint32_t dwSeq);
 
 /* Function definitions */
 
@@ -105,9 +128,24 @@ NFCSTATUS phTmlNfc_Init(pphTmlNfc_Config_t pConfig) {
              sizeof(phTmlNfc_Context_t));
       /* Make sure that the thread runs once it is created */
       gpphTmlNfc_Context->bThreadDone = 1;
+      gpphTmlNfc_Context->bEventLoop = pConfig->bEventLoop;
+      gpphTmlNfc_Context->bReadAhead = pConfig->bReadAhead;
+      gpphTmlNfc_Context->nEpollFd = -1;
+      gpphTmlNfc_Context->nEventFd = -1;
+      gpphTmlNfc_Context->nReTxTimerFd = -1;
+
+      if (phTmlNfc_e_TransportVirtual == pConfig->eTransport) {
+        gpphTmlNfc_Context->pTransport = &gphTmlNfc_VirtualTransport;
+      } else if (phTmlNfc_e_TransportReplay == pConfig->eTransport) {
+        gpphTmlNfc_Context->pTransport = &gphTmlNfc_ReplayTransport;
+      } else {
+        gpphTmlNfc_Context->pTransport = &gphTmlNfc_I2cTransport;
+      }
+      NXPLOG_TML_D("PN54X - Using %s transport",
+                   gpphTmlNfc_Context->pTransport->pName);
 
       /* Open the device file to which data is read/written */
-      wInitStatus = phTmlNfc_i2c_open_and_configure(
+      wInitStatus = gpphTmlNfc_Context->pTransport->open_and_configure(
           pConfig, &(gpphTmlNfc_Context->pDevHandle));
 
       if (NFCSTATUS_SUCCESS != wInitStatus) {
@@ -124,34 +162,30 @@ NFCSTATUS phTmlNfc_Init(pphTmlNfc_Config_t pConfig) {
           wInitStatus = NFCSTATUS_FAILED;
         } else if (0 != sem_init(&gpphTmlNfc_Context->rxSemaphore, 0, 0)) {
           wInitStatus = NFCSTATUS_FAILED;
-        } else if (0 != phTmlNfc_WaitReadInit()) {
-          wInitStatus = NFCSTATUS_FAILED;
-        } else if (0 != sem_init(&gpphTmlNfc_Context->txSemaphore, 0, 0)) {
-          wInitStatus = NFCSTATUS_FAILED;
         } else if (0 != sem_init(&gpphTmlNfc_Context->postMsgSemaphore, 0, 0)) {
           wInitStatus = NFCSTATUS_FAILED;
+        } else if (0 != sem_init(&gpphTmlNfc_Context->rxSlotSemaphore, 0,
+                                 PH_TMLNFC_RX_RING_SIZE)) {
+          wInitStatus = NFCSTATUS_FAILED;
         } else {
           sem_post(&gpphTmlNfc_Context->postMsgSemaphore);
           /* Start TML thread (to handle write and read operations) */
           if (NFCSTATUS_SUCCESS != phTmlNfc_StartThread()) {
             wInitStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_FAILED);
           } else {
-            /* Create Timer used for Retransmission of NCI packets */
-            gpphTmlNfc_Context->dwTimerId = phOsalNfc_Timer_Create();
-            if (PH_OSALNFC_TIMER_ID_INVALID != gpphTmlNfc_Context->dwTimerId) {
-              /* Store the Thread Identifier to which Message is to be posted */
-              gpphTmlNfc_Context->dwCallbackThreadId =
-                  pConfig->dwGetMsgThreadId;
-              /* Enable retransmission of Nci packet & set retry count to
-               * default */
-              gpphTmlNfc_Context->eConfig = phTmlNfc_e_DisableRetrans;
-              /* Retry Count = Standby Recovery time of NFCC / Retransmission
-               * time + 1 */
-              gpphTmlNfc_Context->bRetryCount =
-                  (2000 / PHTMLNFC_MAXTIME_RETRANSMIT) + 1;
-              gpphTmlNfc_Context->bWriteCbInvoked = false;
-            } else {
-              wInitStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_FAILED);
+            /* Store the Thread Identifier to which Message is to be posted */
+            gpphTmlNfc_Context->dwCallbackThreadId = pConfig->dwGetMsgThreadId;
+            /* Enable retransmission of Nci packet & set retry count to
+             * default */
+            gpphTmlNfc_Context->eConfig = phTmlNfc_e_DisableRetrans;
+            /* Retry Count = Standby Recovery time of NFCC / Retransmission
+             * time + 1 */
+            gpphTmlNfc_Context->bRetryCount =
+                (2000 / PHTMLNFC_MAXTIME_RETRANSMIT) + 1;
+            gpphTmlNfc_Context->bWriteCbInvoked = false;
+            if ((NULL != pConfig->pCaptureFile) &&
+                ('\0' != pConfig->pCaptureFile[0])) {
+              (void)phTmlNfc_CaptureStart((const char*)pConfig->pCaptureFile);
             }
           }
         }
@@ -223,10 +257,27 @@ static NFCSTATUS phTmlNfc_StartThread(void) {
   void* h_threadsEvent = 0x00;
   int pthread_create_status = 0;
 
+  /* Write requests and retransmission timeouts are served from the same
+   * thread, which waits on both file descriptors */
+  gpphTmlNfc_Context->nEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  gpphTmlNfc_Context->nReTxTimerFd =
+      timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if ((gpphTmlNfc_Context->nEventFd < 0) ||
+      (gpphTmlNfc_Context->nReTxTimerFd < 0)) {
+    NXPLOG_TML_E("PN54X - eventfd/timerfd creation failed errno : %x", errno);
+    return NFCSTATUS_FAILED;
+  }
+
+  if (gpphTmlNfc_Context->bEventLoop) {
+    return phTmlNfc_StartEventLoop();
+  }
+
   /* Create Reader and Writer threads */
-  pthread_create_status =
-      pthread_create(&gpphTmlNfc_Context->readerThread, NULL,
-                     phTmlNfc_TmlThread, (void*)h_threadsEvent);
+  pthread_create_status = pthread_create(
+      &gpphTmlNfc_Context->readerThread, NULL,
+      gpphTmlNfc_Context->bReadAhead ? phTmlNfc_TmlReadAheadThread
+                                     : phTmlNfc_TmlThread,
+      (void*)h_threadsEvent);
   if (0 != pthread_create_status) {
     wStartStatus = NFCSTATUS_FAILED;
   } else {
@@ -244,29 +295,29 @@ static NFCSTATUS phTmlNfc_StartThread(void) {
 
 /*******************************************************************************
 **
-** Function         phTmlNfc_ReTxTimerCb
+** Function         phTmlNfc_ReTxTimerExpired
 **
-** Description      This is the timer callback function after timer expiration.
+** Description      Handles expiry of the retransmission timerfd. Called from
+**                  the thread that owns the timerfd, the pending Nci packet is
+**                  written again as long as its retry budget is not used up.
 **
-** Parameters       dwThreadId  - id of the thread posting message
-**                  pContext    - context provided by upper layer
+** Parameters       None
 **
 ** Returns          None
 **
 *******************************************************************************/
-static void phTmlNfc_ReTxTimerCb(uint32_t dwTimerId, void* pContext) {
-  if ((gpphTmlNfc_Context->dwTimerId == dwTimerId) && (NULL == pContext)) {
-    /* If Retry Count has reached its limit,Retransmit Nci
-       packet */
-    if (0 == bCurrentRetryCount) {
-      /* Since the count has reached its limit,return from timer callback
-         Upper layer Timeout would have happened */
-    } else {
-      bCurrentRetryCount--;
-      gpphTmlNfc_Context->tWriteInfo.bThreadBusy = true;
-      gpphTmlNfc_Context->tWriteInfo.bEnable = 1;
-    }
-    sem_post(&gpphTmlNfc_Context->txSemaphore);
+static void phTmlNfc_ReTxTimerExpired(void) {
+  /* If Retry Count has reached its limit,Retransmit Nci
+     packet */
+  if (0 == gpphTmlNfc_Context->bCurrentRetryCount) {
+    /* Since the count has reached its limit,return from timer callback
+       Upper layer Timeout would have happened */
+  } else {
+    gpphTmlNfc_Context->bCurrentRetryCount--;
+    NXPLOG_TML_D("PN54X - Retransmitting Nci packet, %d retries left",
+                 gpphTmlNfc_Context->bCurrentRetryCount);
+    gpphTmlNfc_Context->tWriteInfo.bThreadBusy = true;
+    gpphTmlNfc_Context->tWriteInfo.bEnable = 1;
   }
 
   return;
@@ -276,7 +327,9 @@ static void phTmlNfc_ReTxTimerCb(uint32_t dwTimerId, void* pContext) {
 **
 ** Function         phTmlNfc_InitiateTimer
 **
-** Description      Start a timer for Tx and Rx thread.
+** Description      Arms the retransmission timerfd with the deadline of the
+**                  Nci packet just written. The deadline is absolute on
+**                  CLOCK_MONOTONIC and replaces the one of any earlier packet.
 **
 ** Parameters       void
 **
@@ -285,15 +338,99 @@ static void phTmlNfc_ReTxTimerCb(uint32_t dwTimerId, void* pContext) {
 *******************************************************************************/
 static NFCSTATUS phTmlNfc_InitiateTimer(void) {
   NFCSTATUS wStatus = NFCSTATUS_SUCCESS;
+  struct itimerspec tTimeout;
+
+  memset(&tTimeout, 0x00, sizeof(tTimeout));
+  if (0 != clock_gettime(CLOCK_MONOTONIC, &tTimeout.it_value)) {
+    NXPLOG_TML_E("PN54X - clock_gettime failed errno : %x", errno);
+    return NFCSTATUS_FAILED;
+  }
+  tTimeout.it_value.tv_sec += PHTMLNFC_MAXTIME_RETRANSMIT / 1000;
+  tTimeout.it_value.tv_nsec += (PHTMLNFC_MAXTIME_RETRANSMIT % 1000) * 1000000;
+  if (tTimeout.it_value.tv_nsec >= 1000000000) {
+    tTimeout.it_value.tv_sec++;
+    tTimeout.it_value.tv_nsec -= 1000000000;
+  }
+  if (0 != timerfd_settime(gpphTmlNfc_Context->nReTxTimerFd, TFD_TIMER_ABSTIME,
+                           &tTimeout, NULL)) {
+    NXPLOG_TML_E("PN54X - timerfd_settime failed errno : %x", errno);
+    wStatus = NFCSTATUS_FAILED;
+  }
+
+  return wStatus;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_StopTimer
+**
+** Description      Disarms the retransmission timerfd. An expiry not yet
+**                  consumed by the owning thread is discarded as well.
+**
+** Parameters       void
+**
+** Returns          NFC status
+**
+*******************************************************************************/
+static NFCSTATUS phTmlNfc_StopTimer(void) {
+  NFCSTATUS wStatus = NFCSTATUS_SUCCESS;
+  struct itimerspec tTimeout;
 
-  /* Start Timer once Nci packet is sent */
-  wStatus = phOsalNfc_Timer_Start(gpphTmlNfc_Context->dwTimerId,
-                                  (uint32_t)PHTMLNFC_MAXTIME_RETRANSMIT,
-                                  phTmlNfc_ReTxTimerCb, NULL);
+  memset(&tTimeout, 0x00, sizeof(tTimeout));
+  if (0 != timerfd_settime(gpphTmlNfc_Context->nReTxTimerFd, 0, &tTimeout,
+                           NULL)) {
+    wStatus = NFCSTATUS_FAILED;
+  }
 
   return wStatus;
 }
 
+/*******************************************************************************
+**
+** Function         phTmlNfc_PostEvent
+**
+** Description      Wakes up the thread serving a read request. In event loop
+**                  mode the event loop eventfd is signalled, otherwise the
+**                  given reader semaphore is posted.
+**
+** Parameters       pSemaphore - semaphore of the reader thread
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_PostEvent(sem_t* pSemaphore) {
+  if (gpphTmlNfc_Context->bEventLoop) {
+    uint64_t qwEvent = 1;
+    if ((ssize_t)sizeof(qwEvent) !=
+        write(gpphTmlNfc_Context->nEventFd, &qwEvent, sizeof(qwEvent))) {
+      NXPLOG_TML_E("PN54X - eventfd write failed errno : %x", errno);
+    }
+  } else {
+    sem_post(pSemaphore);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_PostWriteEvent
+**
+** Description      Wakes up the thread serving write requests through the
+**                  eventfd it waits on.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_PostWriteEvent(void) {
+  uint64_t qwEvent = 1;
+
+  if ((ssize_t)sizeof(qwEvent) !=
+      write(gpphTmlNfc_Context->nEventFd, &qwEvent, sizeof(qwEvent))) {
+    NXPLOG_TML_E("PN54X - eventfd write failed errno : %x", errno);
+  }
+}
+
 /*******************************************************************************
 **
 ** Function         phTmlNfc_TmlThread
@@ -308,16 +445,9 @@ static NFCSTATUS phTmlNfc_InitiateTimer(void) {
 static void* phTmlNfc_TmlThread(void* pParam) {
   NFCSTATUS wStatus = NFCSTATUS_SUCCESS;
   int32_t dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
-  uint8_t temp[260];
   uint8_t read_count = 0;
-
-  /* Transaction info buffer to be passed to Callback Thread */
-  static phTmlNfc_TransactInfo_t tTransactionInfo;
-  /* Structure containing Tml callback function and parameters to be invoked
-     by the callback thread */
-  static phLibNfc_DeferredCall_t tDeferredInfo;
-  /* Initialize Message structure to post message onto Callback Thread */
-  static phLibNfc_Message_t tMsg;
+  /* Receive slot the packet is read into */
+  phTmlNfc_RxSlot_t* pSlot = NULL;
   UNUSED(pParam);
   NXPLOG_TML_D("PN54X - Tml Reader Thread Started................\n");
 
@@ -337,11 +467,19 @@ static void* phTmlNfc_TmlThread(void* pParam) {
       /* Variable to fetch the actual number of bytes read */
       dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
 
+      /* Wait until the upper layer has released a receive slot */
+      pSlot = phTmlNfc_GetRxSlot(true);
+      if (!gpphTmlNfc_Context->bThreadDone) {
+        phTmlNfc_PutRxSlot();
+        break;
+      }
+
       /* Read the data from the file onto the buffer */
       if (((uintptr_t)gpphTmlNfc_Context->pDevHandle) > 0) {
         NXPLOG_TML_D("PN54X - Invoking I2C Read.....\n");
-        dwNoBytesWrRd =
-            phTmlNfc_i2c_read(gpphTmlNfc_Context->pDevHandle, temp, 260);
+        dwNoBytesWrRd = gpphTmlNfc_Context->pTransport->read(
+            gpphTmlNfc_Context->pDevHandle, pSlot->aBuffer,
+            PH_TMLNFC_RX_SLOT_SIZE);
 
         if (-1 == dwNoBytesWrRd) {
             NXPLOG_TML_E("PN54X - Error in I2C Read.....\n");
@@ -352,37 +490,27 @@ static void* phTmlNfc_TmlThread(void* pParam) {
                      * read error*/
                     usleep(read_count * 30 * 1000);
                 } else {
-                    /* Fill the Transaction info structure to be passed to Callback
-                     * Function */
-                    tTransactionInfo.wStatus = NFCSTATUS_READ_FAILED;
-                    // tTransactionInfo.pBuff = gpphTmlNfc_Context->tReadInfo.pBuffer;
-                    /* Actual number of bytes read is filled in the structure */
-                    // tTransactionInfo.wLength = gpphTmlNfc_Context->tReadInfo.wLength;
-
-                    /* Read operation Failed. Post a Message onto Callback Thread*/
-                    /* Prepare the message to be posted on User thread */
-                    tDeferredInfo.pCallback = &phTmlNfc_ReadDeferredCb;
-                    tDeferredInfo.pParameter = &tTransactionInfo;
-                    tMsg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
-                    tMsg.pMsgData = &tDeferredInfo;
-                    tMsg.Size = sizeof(tDeferredInfo);
                     read_count = 0;
+                    /* Read operation Failed. Post a Message onto Callback Thread*/
                     NXPLOG_TML_D("PN54X - Posting read failure message.....\n");
-                    phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId,
-                            &tMsg);
+                    pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+                    phTmlNfc_QueueRxSlot(pSlot, NFCSTATUS_READ_FAILED, 0);
+                    phTmlNfc_DeliverRxSlot();
+                    pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
                     return NULL;
                 }
             }
+          phTmlNfc_PutRxSlot();
           sem_post(&gpphTmlNfc_Context->rxSemaphore);
-        } else if (dwNoBytesWrRd > 260) {
+        } else if (dwNoBytesWrRd > PH_TMLNFC_RX_SLOT_SIZE) {
           NXPLOG_TML_E("Numer of bytes read exceeds the limit 260.....\n");
           if(nfcFL.nfccFL._NFCC_I2C_READ_WRITE_IMPROVEMENT) {
               read_count = 0;
           }
+          phTmlNfc_PutRxSlot();
           sem_post(&gpphTmlNfc_Context->rxSemaphore);
         } else {
           pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
-          memcpy(gpphTmlNfc_Context->tReadInfo.pBuffer, temp, dwNoBytesWrRd);
           if(nfcFL.nfccFL._NFCC_I2C_READ_WRITE_IMPROVEMENT) {
               read_count = 0;
           }
@@ -391,60 +519,32 @@ static void* phTmlNfc_TmlThread(void* pParam) {
           /* This has to be reset only after a successful read */
           gpphTmlNfc_Context->tReadInfo.bEnable = 0;
           if ((phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) &&
-              (0x00 != (gpphTmlNfc_Context->tReadInfo.pBuffer[0] & 0xE0))) {
+              (0x00 != (pSlot->aBuffer[0] & 0xE0))) {
             NXPLOG_TML_D("PN54X - Retransmission timer stopped.....\n");
             /* Stop Timer to prevent Retransmission */
-            uint32_t timerStatus =
-                phOsalNfc_Timer_Stop(gpphTmlNfc_Context->dwTimerId);
+            uint32_t timerStatus = phTmlNfc_StopTimer();
             if (NFCSTATUS_SUCCESS != timerStatus) {
               NXPLOG_TML_E("PN54X - timer stopped returned failure.....\n");
             } else {
               gpphTmlNfc_Context->bWriteCbInvoked = false;
             }
           }
-          if (gpphTmlNfc_Context->tWriteInfo.bThreadBusy) {
-            NXPLOG_TML_D("Delay Read if write thread is busy");
-            usleep(2000); /*2ms delay to give prio to write complete */
-          }
           /* Update the actual number of bytes read including header */
           gpphTmlNfc_Context->tReadInfo.wLength = (uint16_t)(dwNoBytesWrRd);
           dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
-          /* Fill the Transaction info structure to be passed to Callback
-           * Function */
-          tTransactionInfo.wStatus = wStatus;
-          tTransactionInfo.pBuff = gpphTmlNfc_Context->tReadInfo.pBuffer;
-          /* Actual number of bytes read is filled in the structure */
-          tTransactionInfo.wLength = gpphTmlNfc_Context->tReadInfo.wLength;
-
           /* Read operation completed successfully. Post a Message onto Callback
            * Thread*/
-          /* Prepare the message to be posted on User thread */
-          tDeferredInfo.pCallback = &phTmlNfc_ReadDeferredCb;
-          tDeferredInfo.pParameter = &tTransactionInfo;
-          tMsg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
-          tMsg.pMsgData = &tDeferredInfo;
-          tMsg.Size = sizeof(tDeferredInfo);
-          /*Don't wait for posting notifications. Only wait for posting
-           * responses*/
-          /*TML reader writer callback syncronization-- START*/
-          pthread_mutex_lock(&gpphTmlNfc_Context->wait_busy_lock);
-          if ((gpphTmlNfc_Context->gWriterCbflag == false) &&
-              ((gpphTmlNfc_Context->tReadInfo.pBuffer[0] & 0x60) != 0x60)) {
-            phTmlNfc_WaitWriteComplete();
-          }
-          /*TML reader writer callback syncronization-- END*/
-          pthread_mutex_unlock(&gpphTmlNfc_Context->wait_busy_lock);
-          pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
           NXPLOG_TML_D("PN54X - Posting read message.....\n");
-          phNxpNciHal_print_packet("RECV",
-                                   gpphTmlNfc_Context->tReadInfo.pBuffer,
-                                   gpphTmlNfc_Context->tReadInfo.wLength);
-          phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId, &tMsg);
+          phTmlNfc_QueueRxSlot(pSlot, wStatus,
+                               gpphTmlNfc_Context->tReadInfo.wLength);
+          phTmlNfc_DeliverRxSlot();
+          pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
         }
       } else {
         NXPLOG_TML_D(
             "PN54X - NFCSTATUS_INVALID_DEVICE == "
             "gpphTmlNfc_Context->pDevHandle");
+        phTmlNfc_PutRxSlot();
       }
     } else {
       NXPLOG_TML_D("PN54X - read request NOT enabled");
@@ -455,6 +555,93 @@ static void* phTmlNfc_TmlThread(void* pParam) {
   return NULL;
 }
 
+/*******************************************************************************
+**
+** Function         phTmlNfc_TmlReadAheadThread
+**
+** Description      Keeps reading packets from the lower layer driver into the
+**                  free receive slots, whether or not a read is pending. A
+**                  packet is posted at once if a read is pending, otherwise it
+**                  stays queued until the next phTmlNfc_Read. Reading pauses
+**                  while all the slots are owned by the upper layer.
+**
+** Parameters       pParam  - parameters for Reader thread function
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phTmlNfc_TmlReadAheadThread(void* pParam) {
+  int32_t dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
+  uint8_t read_count = 0;
+  /* Receive slot the packet is read into */
+  phTmlNfc_RxSlot_t* pSlot = NULL;
+  UNUSED(pParam);
+  NXPLOG_TML_D("PN54X - Tml Read Ahead Thread Started................\n");
+
+  while (gpphTmlNfc_Context->bThreadDone) {
+    /* Wait until the upper layer has released a receive slot */
+    pSlot = phTmlNfc_GetRxSlot(true);
+    if (!gpphTmlNfc_Context->bThreadDone) {
+      phTmlNfc_PutRxSlot();
+      break;
+    }
+
+    dwNoBytesWrRd = gpphTmlNfc_Context->pTransport->read(
+        gpphTmlNfc_Context->pDevHandle, pSlot->aBuffer, PH_TMLNFC_RX_SLOT_SIZE);
+    if (-1 == dwNoBytesWrRd) {
+      NXPLOG_TML_E("PN54X - Error in I2C Read.....\n");
+      if (nfcFL.nfccFL._NFCC_I2C_READ_WRITE_IMPROVEMENT) {
+        if (read_count <= MAX_READ_RETRY_COUNT) {
+          read_count++;
+          /*sleep for 30/60/90/120/150 msec between each read trial incase of
+           * read error*/
+          usleep(read_count * 30 * 1000);
+        } else {
+          /* Queue the failure behind the packets already read */
+          NXPLOG_TML_D("PN54X - Posting read failure message.....\n");
+          pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+          phTmlNfc_QueueRxSlot(pSlot, NFCSTATUS_READ_FAILED, 0);
+          if (1 == gpphTmlNfc_Context->tReadInfo.bEnable) {
+            gpphTmlNfc_Context->tReadInfo.bEnable = 0;
+            phTmlNfc_DeliverRxSlot();
+          }
+          pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+          return NULL;
+        }
+      }
+      phTmlNfc_PutRxSlot();
+      continue;
+    } else if (dwNoBytesWrRd > PH_TMLNFC_RX_SLOT_SIZE) {
+      NXPLOG_TML_E("Numer of bytes read exceeds the limit 260.....\n");
+      read_count = 0;
+      phTmlNfc_PutRxSlot();
+      continue;
+    }
+    read_count = 0;
+    NXPLOG_TML_D("PN54X - I2C Read successful.....len = %d\n", dwNoBytesWrRd);
+    if ((phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) &&
+        (0x00 != (pSlot->aBuffer[0] & 0xE0))) {
+      NXPLOG_TML_D("PN54X - Retransmission timer stopped.....\n");
+      /* Stop Timer to prevent Retransmission */
+      if (NFCSTATUS_SUCCESS != phTmlNfc_StopTimer()) {
+        NXPLOG_TML_E("PN54X - timer stopped returned failure.....\n");
+      } else {
+        gpphTmlNfc_Context->bWriteCbInvoked = false;
+      }
+    }
+    pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+    phTmlNfc_QueueRxSlot(pSlot, NFCSTATUS_SUCCESS, (uint16_t)dwNoBytesWrRd);
+    if (1 == gpphTmlNfc_Context->tReadInfo.bEnable) {
+      gpphTmlNfc_Context->tReadInfo.bEnable = 0;
+      NXPLOG_TML_D("PN54X - Posting read message.....\n");
+      phTmlNfc_DeliverRxSlot();
+    }
+    pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+  } /* End of While loop */
+
+  return NULL;
+}
+
 /*******************************************************************************
 **
 ** Function         phTmlNfc_TmlWriterThread
@@ -469,6 +656,7 @@ static void* phTmlNfc_TmlThread(void* pParam) {
 static void* phTmlNfc_TmlWriterThread(void* pParam) {
   NFCSTATUS wStatus = NFCSTATUS_SUCCESS;
   int32_t dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
+  uint32_t dwSeq = 0;
   /* Transaction info buffer to be passed to Callback Thread */
   static phTmlNfc_TransactInfo_t tTransactionInfo;
   /* Structure containing Tml callback function and parameters to be invoked
@@ -478,19 +666,49 @@ static void* phTmlNfc_TmlWriterThread(void* pParam) {
   static phLibNfc_Message_t tMsg;
   /* In case of I2C Write Retry */
   static uint16_t retry_cnt;
+  /* Write requests and retransmission timeouts */
+  struct pollfd tPollFds[2];
+  uint64_t qwCount;
   UNUSED(pParam);
   NXPLOG_TML_D("PN54X - Tml Writer Thread Started................\n");
 
+  memset(tPollFds, 0x00, sizeof(tPollFds));
+  tPollFds[0].fd = gpphTmlNfc_Context->nEventFd;
+  tPollFds[0].events = POLLIN;
+  tPollFds[1].fd = gpphTmlNfc_Context->nReTxTimerFd;
+  tPollFds[1].events = POLLIN;
+
   /* Writer thread loop shall be running till shutdown is invoked */
   while (gpphTmlNfc_Context->bThreadDone) {
     NXPLOG_TML_D("PN54X - Tml Writer Thread Running................\n");
-    sem_wait(&gpphTmlNfc_Context->txSemaphore);
+    if (poll(tPollFds, 2, -1) < 0) {
+      if (errno != EINTR) {
+        NXPLOG_TML_E("PN54X - writer poll failed errno : %x", errno);
+      }
+      continue;
+    }
+    if (tPollFds[0].revents & POLLIN) {
+      /* Drain the request counter, requests are picked from the context */
+      if (read(gpphTmlNfc_Context->nEventFd, &qwCount, sizeof(qwCount)) < 0) {
+        NXPLOG_TML_D("PN54X - eventfd read errno : %x", errno);
+      }
+    }
+    if ((tPollFds[1].revents & POLLIN) &&
+        ((ssize_t)sizeof(qwCount) ==
+         read(gpphTmlNfc_Context->nReTxTimerFd, &qwCount, sizeof(qwCount)))) {
+      phTmlNfc_ReTxTimerExpired();
+    }
+    if (!gpphTmlNfc_Context->bThreadDone) {
+      break;
+    }
     /* If Tml write is requested */
     if (1 == gpphTmlNfc_Context->tWriteInfo.bEnable) {
       NXPLOG_TML_D("PN54X - Write requested.....\n");
       /* Set the variable to success initially */
       wStatus = NFCSTATUS_SUCCESS;
       if (((uintptr_t)gpphTmlNfc_Context->pDevHandle) > 0) {
+        phTmlNfc_StatsWriteStart(gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                                 gpphTmlNfc_Context->tWriteInfo.wLength);
       retry:
 
         gpphTmlNfc_Context->tWriteInfo.bEnable = 0;
@@ -498,11 +716,12 @@ static void* phTmlNfc_TmlWriterThread(void* pParam) {
         dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
         /* Write the data in the buffer onto the file */
         NXPLOG_TML_D("PN54X - Invoking I2C Write.....\n");
-        gpphTmlNfc_Context->gWriterCbflag = false;
+        dwSeq = phTmlNfc_BeginWriteSeq();
         dwNoBytesWrRd =
-            phTmlNfc_i2c_write(gpphTmlNfc_Context->pDevHandle,
-                               gpphTmlNfc_Context->tWriteInfo.pBuffer,
-                               gpphTmlNfc_Context->tWriteInfo.wLength);
+            gpphTmlNfc_Context->pTransport->write(
+                gpphTmlNfc_Context->pDevHandle,
+                gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                gpphTmlNfc_Context->tWriteInfo.wLength);
 
         /* Try I2C Write Five Times, if it fails : Raju */
         if (-1 == dwNoBytesWrRd) {
@@ -512,12 +731,16 @@ static void* phTmlNfc_TmlWriterThread(void* pParam) {
                               retry_cnt);
               // Add a 10 ms delay to ensure NFCC is not still in stand by mode.
               usleep(10 * 1000);
+              phTmlNfc_StatsWriteRetry();
               goto retry;
             }
           }
           NXPLOG_TML_D("PN54X - Error in I2C Write.....\n");
           wStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_FAILED);
         } else {
+          phTmlNfc_CaptureFrame(phTmlNfc_e_CaptureTx,
+                                gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                                gpphTmlNfc_Context->tWriteInfo.wLength);
           phNxpNciHal_print_packet("SEND",
                                    gpphTmlNfc_Context->tWriteInfo.pBuffer,
                                    gpphTmlNfc_Context->tWriteInfo.wLength);
@@ -552,25 +775,19 @@ static void* phTmlNfc_TmlWriterThread(void* pParam) {
         if ((phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) &&
             (0x00 != (gpphTmlNfc_Context->tWriteInfo.pBuffer[0] & 0xE0))) {
           if (false == gpphTmlNfc_Context->bWriteCbInvoked) {
-            if ((NFCSTATUS_SUCCESS == wStatus) || (bCurrentRetryCount == 0)) {
+            if ((NFCSTATUS_SUCCESS == wStatus) ||
+                (gpphTmlNfc_Context->bCurrentRetryCount == 0)) {
               NXPLOG_TML_D("PN54X - Posting Write message.....\n");
-              phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId,
-                                    &tMsg);
+              phTmlNfc_PostMsg(&tMsg, PHDAL4NFC_MSG_URGENT);
               gpphTmlNfc_Context->bWriteCbInvoked = true;
             }
           }
         } else {
           NXPLOG_TML_D("PN54X - Posting Fresh Write message.....\n");
-          phTmlNfc_DeferredCall(gpphTmlNfc_Context->dwCallbackThreadId, &tMsg);
-          if (NFCSTATUS_SUCCESS == wStatus) {
-            /*TML reader writer thread callback syncronization---START*/
-            pthread_mutex_lock(&gpphTmlNfc_Context->wait_busy_lock);
-            gpphTmlNfc_Context->gWriterCbflag = true;
-            phTmlNfc_SignalWriteComplete();
-            /*TML reader writer thread callback syncronization---END*/
-            pthread_mutex_unlock(&gpphTmlNfc_Context->wait_busy_lock);
-          }
+          phTmlNfc_PostMsg(&tMsg, PHDAL4NFC_MSG_URGENT);
         }
+        /* Responses read meanwhile may be posted now */
+        phTmlNfc_CompleteWriteSeq(dwSeq);
       } else {
         NXPLOG_TML_D(
             "PN54X - NFCSTATUS_INVALID_DEVICE == "
@@ -586,12 +803,11 @@ static void* phTmlNfc_TmlWriterThread(void* pParam) {
           /* Reset Variables used for Retransmission */
           NXPLOG_TML_D("PN54X - Retransmission timer initiate failed");
           gpphTmlNfc_Context->tWriteInfo.bEnable = 0;
-          bCurrentRetryCount = 0;
+          gpphTmlNfc_Context->bCurrentRetryCount = 0;
         }
       }
     } else {
       NXPLOG_TML_D("PN54X - Write request NOT enabled");
-      usleep(10000);
     }
 
   } /* End of While loop */
@@ -599,6 +815,341 @@ static void* phTmlNfc_TmlWriterThread(void* pParam) {
   return NULL;
 }
 
+/*******************************************************************************
+**
+** Function         phTmlNfc_StartEventLoop
+**
+** Description      Creates the epoll instance, registers the request
+**                  eventfd, the retransmission timerfd and the device with
+**                  it and starts the event loop thread which serves both
+**                  read and write requests. phTmlNfc_Init fails if any of
+**                  these steps fails.
+**
+** Parameters       None
+**
+** Returns          NFC status:
+**                  NFCSTATUS_SUCCESS - event loop started successfully
+**                  NFCSTATUS_FAILED - initialization failed due to system error
+**
+*******************************************************************************/
+static NFCSTATUS phTmlNfc_StartEventLoop(void) {
+  struct epoll_event tEvent;
+  int nDevFd = (int)((intptr_t)gpphTmlNfc_Context->pDevHandle);
+
+  gpphTmlNfc_Context->nEpollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (gpphTmlNfc_Context->nEpollFd < 0) {
+    NXPLOG_TML_E("PN54X - event loop fd creation failed errno : %x", errno);
+    return NFCSTATUS_FAILED;
+  }
+
+  memset(&tEvent, 0x00, sizeof(tEvent));
+  tEvent.events = EPOLLIN;
+  tEvent.data.fd = gpphTmlNfc_Context->nEventFd;
+  if (0 != epoll_ctl(gpphTmlNfc_Context->nEpollFd, EPOLL_CTL_ADD,
+                     gpphTmlNfc_Context->nEventFd, &tEvent)) {
+    NXPLOG_TML_E("PN54X - event loop eventfd add failed errno : %x", errno);
+    return NFCSTATUS_FAILED;
+  }
+  tEvent.data.fd = gpphTmlNfc_Context->nReTxTimerFd;
+  if (0 != epoll_ctl(gpphTmlNfc_Context->nEpollFd, EPOLL_CTL_ADD,
+                     gpphTmlNfc_Context->nReTxTimerFd, &tEvent)) {
+    NXPLOG_TML_E("PN54X - event loop timerfd add failed errno : %x", errno);
+    return NFCSTATUS_FAILED;
+  }
+  /* Device is added without events, EPOLLIN is only enabled while a read
+   * request is pending so that no data is drained without a buffer */
+  tEvent.events = 0;
+  tEvent.data.fd = nDevFd;
+  if (0 != epoll_ctl(gpphTmlNfc_Context->nEpollFd, EPOLL_CTL_ADD, nDevFd,
+                     &tEvent)) {
+    NXPLOG_TML_E("PN54X - event loop device fd add failed errno : %x", errno);
+    return NFCSTATUS_FAILED;
+  }
+
+  if (0 != pthread_create(&gpphTmlNfc_Context->readerThread, NULL,
+                          phTmlNfc_TmlEventLoopThread, NULL)) {
+    NXPLOG_TML_E("PN54X - event loop thread creation failed");
+    return NFCSTATUS_FAILED;
+  }
+
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_TmlEventLoopThread
+**
+** Description      Single thread serving read requests, write requests and
+**                  retransmission timeouts. Pending writes are always served
+**                  before reads, so the write completion is queued to the
+**                  callback thread ahead of the response without any extra
+**                  reader/writer handshake.
+**
+** Parameters       pParam  - unused
+**
+** Returns          None
+**
+*******************************************************************************/
+static void* phTmlNfc_TmlEventLoopThread(void* pParam) {
+  struct epoll_event tEvents[PH_TMLNFC_MAX_EPOLL_EVENTS];
+  struct epoll_event tDevEvent;
+  int nDevFd = (int)((intptr_t)gpphTmlNfc_Context->pDevHandle);
+  uint8_t bReadArmed = false;
+  uint8_t bReadWanted;
+  uint8_t bReadReady;
+  uint8_t bReadPending;
+  int nFreeSlots;
+  uint64_t qwCount;
+  int nEvents;
+  int i;
+  UNUSED(pParam);
+  NXPLOG_TML_D("PN54X - Tml Event Loop Thread Started................\n");
+
+  memset(&tDevEvent, 0x00, sizeof(tDevEvent));
+  tDevEvent.data.fd = nDevFd;
+
+  while (gpphTmlNfc_Context->bThreadDone) {
+    /* Listen on the device only while a read request is pending and a
+     * receive slot is free */
+    nFreeSlots = 0;
+    sem_getvalue(&gpphTmlNfc_Context->rxSlotSemaphore, &nFreeSlots);
+    bReadWanted = ((1 == gpphTmlNfc_Context->tReadInfo.bEnable) ||
+                   gpphTmlNfc_Context->bReadAhead) &&
+                  (nFreeSlots > 0);
+    if (bReadArmed != bReadWanted) {
+      bReadArmed = bReadWanted;
+      tDevEvent.events = bReadArmed ? EPOLLIN : 0;
+      if (0 != epoll_ctl(gpphTmlNfc_Context->nEpollFd, EPOLL_CTL_MOD, nDevFd,
+                         &tDevEvent)) {
+        NXPLOG_TML_E("PN54X - epoll_ctl failed errno : %x", errno);
+      }
+    }
+
+    /* Frames the transport already holds do not raise EPOLLIN, poll only */
+    bReadPending =
+        bReadWanted &&
+        (NULL != gpphTmlNfc_Context->pTransport->pending) &&
+        (0 != gpphTmlNfc_Context->pTransport->pending(
+                  gpphTmlNfc_Context->pDevHandle));
+
+    nEvents = epoll_wait(gpphTmlNfc_Context->nEpollFd, tEvents,
+                         PH_TMLNFC_MAX_EPOLL_EVENTS, bReadPending ? 0 : -1);
+    if (nEvents < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      NXPLOG_TML_E("PN54X - epoll_wait failed errno : %x", errno);
+      break;
+    }
+
+    bReadReady = bReadPending;
+    for (i = 0; i < nEvents; i++) {
+      if (tEvents[i].data.fd == gpphTmlNfc_Context->nEventFd) {
+        /* Drain the request counter, requests are picked from the context */
+        if (read(gpphTmlNfc_Context->nEventFd, &qwCount, sizeof(qwCount)) < 0) {
+          NXPLOG_TML_D("PN54X - eventfd read errno : %x", errno);
+        }
+      } else if (tEvents[i].data.fd == gpphTmlNfc_Context->nReTxTimerFd) {
+        if ((ssize_t)sizeof(qwCount) == read(gpphTmlNfc_Context->nReTxTimerFd,
+                                             &qwCount, sizeof(qwCount))) {
+          phTmlNfc_ReTxTimerExpired();
+        }
+      } else if (tEvents[i].data.fd == nDevFd) {
+        bReadReady = true;
+      }
+    }
+
+    if (!gpphTmlNfc_Context->bThreadDone) {
+      break;
+    }
+    if (1 == gpphTmlNfc_Context->tWriteInfo.bEnable) {
+      phTmlNfc_EventLoopWrite();
+    }
+    if (bReadReady && ((1 == gpphTmlNfc_Context->tReadInfo.bEnable) ||
+                       gpphTmlNfc_Context->bReadAhead)) {
+      phTmlNfc_EventLoopRead();
+    }
+  } /* End of While loop */
+
+  NXPLOG_TML_D("PN54X - Tml Event Loop Thread Exited................\n");
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_EventLoopRead
+**
+** Description      Reads one packet from the lower layer driver and posts the
+**                  read completion onto the callback thread. Called by the
+**                  event loop thread once the device is readable.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_EventLoopRead(void) {
+  int32_t dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
+  static uint8_t read_count = 0;
+  /* Receive slot the packet is read into */
+  phTmlNfc_RxSlot_t* pSlot = phTmlNfc_GetRxSlot(false);
+
+  if (NULL == pSlot) {
+    /* All slots are still owned by the upper layer, retried on release */
+    return;
+  }
+  dwNoBytesWrRd = gpphTmlNfc_Context->pTransport->read(
+      gpphTmlNfc_Context->pDevHandle, pSlot->aBuffer, PH_TMLNFC_RX_SLOT_SIZE);
+  if (-1 == dwNoBytesWrRd) {
+    NXPLOG_TML_E("PN54X - Error in I2C Read.....\n");
+    if (nfcFL.nfccFL._NFCC_I2C_READ_WRITE_IMPROVEMENT) {
+      if (read_count <= MAX_READ_RETRY_COUNT) {
+        read_count++;
+        /*sleep for 30/60/90/120/150 msec between each read trial incase of
+         * read error*/
+        usleep(read_count * 30 * 1000);
+      } else {
+        read_count = 0;
+        /* Stop reading and report the failure to the upper layer */
+        NXPLOG_TML_D("PN54X - Posting read failure message.....\n");
+        pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+        gpphTmlNfc_Context->bReadAhead = false;
+        phTmlNfc_QueueRxSlot(pSlot, NFCSTATUS_READ_FAILED, 0);
+        if (1 == gpphTmlNfc_Context->tReadInfo.bEnable) {
+          gpphTmlNfc_Context->tReadInfo.bEnable = 0;
+          phTmlNfc_DeliverRxSlot();
+        }
+        pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+        return;
+      }
+    }
+    phTmlNfc_PutRxSlot();
+    return;
+  } else if (dwNoBytesWrRd > PH_TMLNFC_RX_SLOT_SIZE) {
+    NXPLOG_TML_E("Numer of bytes read exceeds the limit 260.....\n");
+    read_count = 0;
+    phTmlNfc_PutRxSlot();
+    return;
+  }
+
+  pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+  read_count = 0;
+  NXPLOG_TML_D("PN54X - I2C Read successful.....len = %d\n", dwNoBytesWrRd);
+  if ((phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) &&
+      (0x00 != (pSlot->aBuffer[0] & 0xE0))) {
+    NXPLOG_TML_D("PN54X - Retransmission timer stopped.....\n");
+    /* Stop Timer to prevent Retransmission */
+    if (NFCSTATUS_SUCCESS != phTmlNfc_StopTimer()) {
+      NXPLOG_TML_E("PN54X - timer stopped returned failure.....\n");
+    } else {
+      gpphTmlNfc_Context->bWriteCbInvoked = false;
+    }
+  }
+  phTmlNfc_QueueRxSlot(pSlot, NFCSTATUS_SUCCESS, (uint16_t)dwNoBytesWrRd);
+  /* In read-ahead mode the packet stays queued until it is requested */
+  if (1 == gpphTmlNfc_Context->tReadInfo.bEnable) {
+    /* This has to be reset only after a successful read */
+    gpphTmlNfc_Context->tReadInfo.bEnable = 0;
+    NXPLOG_TML_D("PN54X - Posting read message.....\n");
+    phTmlNfc_DeliverRxSlot();
+  }
+  pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_EventLoopWrite
+**
+** Description      Writes the requested data onto the lower layer driver,
+**                  posts the write completion onto the callback thread and
+**                  arms the retransmission timer if required. Called by the
+**                  event loop thread.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_EventLoopWrite(void) {
+  NFCSTATUS wStatus = NFCSTATUS_SUCCESS;
+  int32_t dwNoBytesWrRd = PH_TMLNFC_RESET_VALUE;
+  uint16_t retry_cnt = 0;
+  uint32_t dwSeq;
+  /* Transaction info buffer to be passed to Callback Thread */
+  static phTmlNfc_TransactInfo_t tTransactionInfo;
+  /* Structure containing Tml callback function and parameters to be invoked
+     by the callback thread */
+  static phLibNfc_DeferredCall_t tDeferredInfo;
+  /* Initialize Message structure to post message onto Callback Thread */
+  static phLibNfc_Message_t tMsg;
+
+  gpphTmlNfc_Context->tWriteInfo.bEnable = 0;
+  dwSeq = phTmlNfc_BeginWriteSeq();
+  phTmlNfc_StatsWriteStart(gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                           gpphTmlNfc_Context->tWriteInfo.wLength);
+  do {
+    NXPLOG_TML_D("PN54X - Invoking I2C Write.....\n");
+    dwNoBytesWrRd = gpphTmlNfc_Context->pTransport->write(
+        gpphTmlNfc_Context->pDevHandle, gpphTmlNfc_Context->tWriteInfo.pBuffer,
+        gpphTmlNfc_Context->tWriteInfo.wLength);
+    if ((-1 == dwNoBytesWrRd) && (getDownloadFlag() == true) &&
+        (retry_cnt++ < MAX_WRITE_RETRY_COUNT)) {
+      NXPLOG_NCIHAL_D("PN54X - Error in I2C Write  - Retry 0x%x", retry_cnt);
+      // Add a 10 ms delay to ensure NFCC is not still in stand by mode.
+      usleep(10 * 1000);
+      phTmlNfc_StatsWriteRetry();
+      continue;
+    }
+    break;
+  } while (true);
+
+  if (-1 == dwNoBytesWrRd) {
+    NXPLOG_TML_D("PN54X - Error in I2C Write.....\n");
+    wStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_FAILED);
+  } else {
+    phTmlNfc_CaptureFrame(phTmlNfc_e_CaptureTx,
+                          gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                          gpphTmlNfc_Context->tWriteInfo.wLength);
+    phNxpNciHal_print_packet("SEND", gpphTmlNfc_Context->tWriteInfo.pBuffer,
+                             gpphTmlNfc_Context->tWriteInfo.wLength);
+    NXPLOG_TML_D("PN54X - I2C Write successful.....\n");
+    dwNoBytesWrRd = PH_TMLNFC_VALUE_ONE;
+  }
+  /* Fill the Transaction info structure to be passed to Callback Function */
+  tTransactionInfo.wStatus = wStatus;
+  tTransactionInfo.pBuff = gpphTmlNfc_Context->tWriteInfo.pBuffer;
+  tTransactionInfo.wLength = (uint16_t)dwNoBytesWrRd;
+  /* Prepare the message to be posted on the User thread */
+  tDeferredInfo.pCallback = &phTmlNfc_WriteDeferredCb;
+  tDeferredInfo.pParameter = &tTransactionInfo;
+  tMsg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
+  tMsg.pMsgData = &tDeferredInfo;
+  tMsg.Size = sizeof(tDeferredInfo);
+
+  if ((phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) &&
+      (0x00 != (gpphTmlNfc_Context->tWriteInfo.pBuffer[0] & 0xE0))) {
+    /* Post only once per packet, either on success or on the last retry */
+    if ((false == gpphTmlNfc_Context->bWriteCbInvoked) &&
+        ((NFCSTATUS_SUCCESS == wStatus) ||
+         (gpphTmlNfc_Context->bCurrentRetryCount == 0))) {
+      NXPLOG_TML_D("PN54X - Posting Write message.....\n");
+      phTmlNfc_PostMsg(&tMsg, PHDAL4NFC_MSG_URGENT);
+      gpphTmlNfc_Context->bWriteCbInvoked = true;
+    }
+    NXPLOG_TML_D("PN54X - Starting timer for Retransmission case");
+    if (NFCSTATUS_SUCCESS != phTmlNfc_InitiateTimer()) {
+      /* Reset Variables used for Retransmission */
+      NXPLOG_TML_D("PN54X - Retransmission timer initiate failed");
+      gpphTmlNfc_Context->tWriteInfo.bEnable = 0;
+      gpphTmlNfc_Context->bCurrentRetryCount = 0;
+    }
+  } else {
+    NXPLOG_TML_D("PN54X - Posting Fresh Write message.....\n");
+    phTmlNfc_PostMsg(&tMsg, PHDAL4NFC_MSG_URGENT);
+  }
+  phTmlNfc_CompleteWriteSeq(dwSeq);
+}
+
 /*******************************************************************************
 **
 ** Function         phTmlNfc_CleanUp
@@ -616,15 +1167,24 @@ void phTmlNfc_CleanUp(void) {
     return;
   }
   if (NULL != gpphTmlNfc_Context->pDevHandle) {
-    (void)phTmlNfc_i2c_reset(gpphTmlNfc_Context->pDevHandle, 0);
+    (void)gpphTmlNfc_Context->pTransport->reset(
+        gpphTmlNfc_Context->pDevHandle, 0);
     gpphTmlNfc_Context->bThreadDone = 0;
   }
   sem_destroy(&gpphTmlNfc_Context->rxSemaphore);
-  sem_destroy(&gpphTmlNfc_Context->txSemaphore);
   sem_destroy(&gpphTmlNfc_Context->postMsgSemaphore);
-  pthread_mutex_destroy(&gpphTmlNfc_Context->wait_busy_lock);
-  pthread_cond_destroy(&gpphTmlNfc_Context->wait_busy_condition);
-  phTmlNfc_i2c_close(gpphTmlNfc_Context->pDevHandle);
+  sem_destroy(&gpphTmlNfc_Context->rxSlotSemaphore);
+  if (gpphTmlNfc_Context->nEpollFd >= 0) {
+    close(gpphTmlNfc_Context->nEpollFd);
+  }
+  if (gpphTmlNfc_Context->nEventFd >= 0) {
+    close(gpphTmlNfc_Context->nEventFd);
+  }
+  if (gpphTmlNfc_Context->nReTxTimerFd >= 0) {
+    close(gpphTmlNfc_Context->nReTxTimerFd);
+  }
+  gpphTmlNfc_Context->pTransport->close(gpphTmlNfc_Context->pDevHandle);
+  phTmlNfc_CaptureStop();
   gpphTmlNfc_Context->pDevHandle = NULL;
   /* Clear memory allocated for storing Context variables */
   free((void*)gpphTmlNfc_Context);
@@ -657,14 +1217,18 @@ NFCSTATUS phTmlNfc_Shutdown(void) {
     /* Reset thread variable to terminate the thread */
     gpphTmlNfc_Context->bThreadDone = 0;
     /* Clear All the resources allocated during initialization */
-    sem_post(&gpphTmlNfc_Context->rxSemaphore);
-    sem_post(&gpphTmlNfc_Context->txSemaphore);
+    phTmlNfc_PostEvent(&gpphTmlNfc_Context->rxSemaphore);
+    sem_post(&gpphTmlNfc_Context->rxSlotSemaphore);
+    if (gpphTmlNfc_Context->nEventFd >= 0) {
+      phTmlNfc_PostWriteEvent();
+    }
     sem_post(&gpphTmlNfc_Context->postMsgSemaphore);
     pthread_mutex_destroy(&gpphTmlNfc_Context->readInfoUpdateMutex);
     if (0 != pthread_join(gpphTmlNfc_Context->readerThread, (void**)NULL)) {
       NXPLOG_TML_E("Fail to kill reader thread!");
     }
-    if (0 != pthread_join(gpphTmlNfc_Context->writerThread, (void**)NULL)) {
+    if ((!gpphTmlNfc_Context->bEventLoop) &&
+        (0 != pthread_join(gpphTmlNfc_Context->writerThread, (void**)NULL))) {
       NXPLOG_TML_E("Fail to kill writer thread!");
     }
     NXPLOG_TML_D("bThreadDone == 0");
@@ -729,18 +1293,19 @@ NFCSTATUS phTmlNfc_Write(uint8_t* pBuffer, uint16_t wLength,
         gpphTmlNfc_Context->tWriteInfo.pContext = pContext;
 
         wWriteStatus = NFCSTATUS_PENDING;
-        // FIXME: If retry is going on. Stop the retry thread/timer
         if (phTmlNfc_e_EnableRetrans == gpphTmlNfc_Context->eConfig) {
+          /* The deadline of the previous packet no longer applies, an expiry
+           * not yet consumed is discarded along with it */
+          (void)phTmlNfc_StopTimer();
           /* Set retry count to default value */
-          // FIXME: If the timer expired there, and meanwhile we have created
-          // a new request. The expired timer will think that retry is still
-          // ongoing.
-          bCurrentRetryCount = gpphTmlNfc_Context->bRetryCount;
+          gpphTmlNfc_Context->bCurrentRetryCount =
+              gpphTmlNfc_Context->bRetryCount;
           gpphTmlNfc_Context->bWriteCbInvoked = false;
         }
+        phTmlNfc_StatsWriteQueued();
         /* Set event to invoke Writer Thread */
         gpphTmlNfc_Context->tWriteInfo.bEnable = 1;
-        sem_post(&gpphTmlNfc_Context->txSemaphore);
+        phTmlNfc_PostWriteEvent();
       } else {
         wWriteStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_BUSY);
       }
@@ -825,10 +1390,18 @@ NFCSTATUS phTmlNfc_Read(uint8_t* pBuffer, uint16_t wLength,
         gpphTmlNfc_Context->tReadInfo.pContext = pContext;
         wReadStatus = NFCSTATUS_PENDING;
 
-        /* Set event to invoke Reader Thread */
-        gpphTmlNfc_Context->tReadInfo.bEnable = 1;
-        pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
-        sem_post(&gpphTmlNfc_Context->rxSemaphore);
+        if (gpphTmlNfc_Context->bRxRingReady > 0) {
+          /* A packet has already been read, complete the request with it */
+          phTmlNfc_DeliverRxSlot();
+          pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+        } else {
+          /* Set event to invoke Reader Thread */
+          gpphTmlNfc_Context->tReadInfo.bEnable = 1;
+          pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+          if (!gpphTmlNfc_Context->bReadAhead) {
+            phTmlNfc_PostEvent(&gpphTmlNfc_Context->rxSemaphore);
+          }
+        }
       } else {
         wReadStatus = PHNFCSTVAL(CID_NFC_TML, NFCSTATUS_BUSY);
       }
@@ -861,7 +1434,10 @@ NFCSTATUS phTmlNfc_Read(uint8_t* pBuffer, uint16_t wLength,
 *******************************************************************************/
 NFCSTATUS phTmlNfc_ReadAbort(void) {
   NFCSTATUS wStatus = NFCSTATUS_INVALID_PARAMETER;
+  pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
   gpphTmlNfc_Context->tReadInfo.bEnable = 0;
+  gpphTmlNfc_Context->bRxDeliverHeld = false;
+  pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
 
   /*Reset the flag to accept another Read Request */
   gpphTmlNfc_Context->tReadInfo.bThreadBusy = false;
@@ -892,7 +1468,7 @@ NFCSTATUS phTmlNfc_WriteAbort(void) {
 
   gpphTmlNfc_Context->tWriteInfo.bEnable = 0;
   /* Stop if any retransmission is in progress */
-  bCurrentRetryCount = 0;
+  gpphTmlNfc_Context->bCurrentRetryCount = 0;
 
   /* Reset the flag to accept another Write Request */
   gpphTmlNfc_Context->tWriteInfo.bThreadBusy = false;
@@ -936,23 +1512,26 @@ NFCSTATUS phTmlNfc_IoCtl(phTmlNfc_ControlCode_t eControlCode) {
           read_flag = true;
         }
         gpphTmlNfc_Context->tReadInfo.bEnable = 0;
-        phTmlNfc_i2c_reset(gpphTmlNfc_Context->pDevHandle, 0);
+        gpphTmlNfc_Context->pTransport->reset(gpphTmlNfc_Context->pDevHandle,
+                                              0);
         usleep(10 * 1000);
-        phTmlNfc_i2c_reset(gpphTmlNfc_Context->pDevHandle, 1);
+        gpphTmlNfc_Context->pTransport->reset(gpphTmlNfc_Context->pDevHandle,
+                                              1);
         usleep(100 * 1000);
         if (read_flag) {
           gpphTmlNfc_Context->tReadInfo.bEnable = 1;
-          sem_post(&gpphTmlNfc_Context->rxSemaphore);
+          phTmlNfc_PostEvent(&gpphTmlNfc_Context->rxSemaphore);
         }
         break;
       }
       case phTmlNfc_e_EnableDownloadMode: {
         phTmlNfc_ConfigNciPktReTx(phTmlNfc_e_DisableRetrans, 0);
         gpphTmlNfc_Context->tReadInfo.bEnable = 0;
-        wStatus = phTmlNfc_i2c_reset(gpphTmlNfc_Context->pDevHandle, 2);
+        wStatus = gpphTmlNfc_Context->pTransport->reset(
+            gpphTmlNfc_Context->pDevHandle, 2);
         usleep(100 * 1000);
         gpphTmlNfc_Context->tReadInfo.bEnable = 1;
-        sem_post(&gpphTmlNfc_Context->rxSemaphore);
+        phTmlNfc_PostEvent(&gpphTmlNfc_Context->rxSemaphore);
         break;
       }
       case phTmlNfc_e_SetJcopDwnldDisable: {
@@ -1037,13 +1616,33 @@ NFCSTATUS phTmlNfc_IoCtl(phTmlNfc_ControlCode_t eControlCode) {
 *******************************************************************************/
 void phTmlNfc_DeferredCall(uintptr_t dwThreadId,
                            phLibNfc_Message_t* ptWorkerMsg) {
-  intptr_t bPostStatus;
   UNUSED(dwThreadId);
+  phTmlNfc_PostMsg(ptWorkerMsg, 0);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_PostMsg
+**
+** Description      Posts message on upper layer thread. Write completions and
+**                  responses are posted with PHDAL4NFC_MSG_URGENT, so that the
+**                  upper layer waiting for them is not delayed by the HAL
+**                  messages already queued. A single read completion is
+**                  queued at a time, so received packets keep their order.
+**
+** Parameters       ptWorkerMsg - message to be posted
+**                  nMsgFlg     - PHDAL4NFC_MSG_URGENT or 0
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_PostMsg(phLibNfc_Message_t* ptWorkerMsg, int nMsgFlg) {
+  intptr_t bPostStatus;
   /* Post message on the user thread to invoke the callback function */
   sem_wait(&gpphTmlNfc_Context->postMsgSemaphore);
 
-  bPostStatus =
-      phDal4Nfc_msgsnd(gpphTmlNfc_Context->dwCallbackThreadId, ptWorkerMsg, 0);
+  bPostStatus = phDal4Nfc_msgsnd(gpphTmlNfc_Context->dwCallbackThreadId,
+                                 ptWorkerMsg, nMsgFlg);
 
   sem_post(&gpphTmlNfc_Context->postMsgSemaphore);
 }
@@ -1067,120 +1666,279 @@ static void phTmlNfc_ReadDeferredCb(void* pParams) {
   gpphTmlNfc_Context->tReadInfo.bThreadBusy = false;
   gpphTmlNfc_Context->tReadInfo.pThread_Callback(
       gpphTmlNfc_Context->tReadInfo.pContext, pTransactionInfo);
+  /* Upper layer is done with the packet, hand the slot back to the reader */
+  if (NULL != gpphTmlNfc_Context) {
+    phTmlNfc_ReleaseRxSlot(
+        (phTmlNfc_RxSlot_t*)((uint8_t*)pTransactionInfo -
+                             offsetof(phTmlNfc_RxSlot_t, tTransactInfo)));
+  }
 
   return;
 }
 
 /*******************************************************************************
 **
-** Function         phTmlNfc_WriteDeferredCb
+** Function         phTmlNfc_GetRxSlot
 **
-** Description      Write thread call back function
+** Description      Returns the next receive slot to be filled by the reader.
+**                  Slots are reused in ring order, see phTmlNfc_ReleaseRxSlot,
+**                  so the head of the ring is always the oldest free slot.
 **
-** Parameters       pParams - context provided by upper layer
+** Parameters       bWait - true to block until a slot is released by the
+**                          upper layer, false to return immediately
+**
+** Returns          Pointer to the receive slot, NULL if none is free
+**
+*******************************************************************************/
+static phTmlNfc_RxSlot_t* phTmlNfc_GetRxSlot(uint8_t bWait) {
+  if (bWait) {
+    while ((0 != sem_wait(&gpphTmlNfc_Context->rxSlotSemaphore)) &&
+           (errno == EINTR)) {
+    }
+  } else if (0 != sem_trywait(&gpphTmlNfc_Context->rxSlotSemaphore)) {
+    return NULL;
+  }
+  return &gpphTmlNfc_Context->tRxRing[gpphTmlNfc_Context->bRxRingHead];
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_QueueRxSlot
+**
+** Description      Queues a filled receive slot for delivery to the upper
+**                  layer. The slot buffer is passed to the upper layer as is,
+**                  without copying it into the buffer given in phTmlNfc_Read.
+**                  Called with readInfoUpdateMutex held.
+**
+** Parameters       pSlot - slot returned by phTmlNfc_GetRxSlot
+**                  wStatus - status of the read operation
+**                  wLength - number of bytes read into the slot
 **
 ** Returns          None
 **
 *******************************************************************************/
-static void phTmlNfc_WriteDeferredCb(void* pParams) {
-  /* Transaction info buffer to be passed to Callback Function */
-  phTmlNfc_TransactInfo_t* pTransactionInfo = (phTmlNfc_TransactInfo_t*)pParams;
+static void phTmlNfc_QueueRxSlot(phTmlNfc_RxSlot_t* pSlot, NFCSTATUS wStatus,
+                                 uint16_t wLength) {
+  gpphTmlNfc_Context->bRxRingHead =
+      (gpphTmlNfc_Context->bRxRingHead + 1) % PH_TMLNFC_RX_RING_SIZE;
+  gpphTmlNfc_Context->bRxRingReady++;
+  __atomic_store_n(&pSlot->bState, phTmlNfc_e_RxSlotReady, __ATOMIC_RELEASE);
+  /* Fill the Transaction info structure to be passed to Callback Function */
+  pSlot->tTransactInfo.wStatus = wStatus;
+  pSlot->tTransactInfo.pBuff = pSlot->aBuffer;
+  pSlot->tTransactInfo.wLength = wLength;
+  /* A response can be read before the writer has posted the completion of
+   * the command it answers. Notifications are not ordered against writes */
+  if ((NFCSTATUS_SUCCESS == wStatus) && ((pSlot->aBuffer[0] & 0x60) != 0x60)) {
+    pSlot->dwWriteSeq = gpphTmlNfc_Context->dwWriteSeq;
+  } else {
+    pSlot->dwWriteSeq = gpphTmlNfc_Context->dwWriteDoneSeq;
+  }
+  if (NFCSTATUS_SUCCESS == wStatus) {
+    phTmlNfc_StatsReadDone(pSlot->aBuffer, wLength);
+    phTmlNfc_CaptureFrame(phTmlNfc_e_CaptureRx, pSlot->aBuffer, wLength);
+    phNxpNciHal_print_packet("RECV", pSlot->aBuffer, wLength);
+  }
+}
 
-  /* Reset the flag to accept another Write Request */
-  gpphTmlNfc_Context->tWriteInfo.bThreadBusy = false;
-  gpphTmlNfc_Context->tWriteInfo.pThread_Callback(
-      gpphTmlNfc_Context->tWriteInfo.pContext, pTransactionInfo);
+/*******************************************************************************
+**
+** Function         phTmlNfc_RxSlotIsType
+**
+** Description      Checks the message type of a successfully read packet
+**
+** Parameters       pSlot - filled receive slot
+**                  bMt   - NCI message type, in the 3 MSBs of the first byte
+**
+** Returns          true if the slot holds a packet of this type
+**
+*******************************************************************************/
+static bool_t phTmlNfc_RxSlotIsType(const phTmlNfc_RxSlot_t* pSlot,
+                                    uint8_t bMt) {
+  return (NFCSTATUS_SUCCESS == pSlot->tTransactInfo.wStatus) &&
+         ((pSlot->aBuffer[0] & 0xE0) == bMt);
+}
 
-  return;
+/*******************************************************************************
+**
+** Function         phTmlNfc_DeliverRxSlot
+**
+** Description      Posts the oldest queued receive slot onto the callback
+**                  thread. Packets are posted in the order they were read,
+**                  a response never overtakes the notifications read before
+**                  it; only its message is sent through the urgent lane.
+**                  A response is held back until the completion of the write
+**                  it follows has been posted, so the callback queue keeps
+**                  write completions ahead of their responses.
+**                  Called with readInfoUpdateMutex held.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_DeliverRxSlot(void) {
+  phTmlNfc_RxSlot_t* pSlot;
+
+  if (0 == gpphTmlNfc_Context->bRxRingReady) {
+    return;
+  }
+  pSlot = &gpphTmlNfc_Context->tRxRing[gpphTmlNfc_Context->bRxRingNext];
+
+  if ((int32_t)(pSlot->dwWriteSeq - gpphTmlNfc_Context->dwWriteDoneSeq) > 0) {
+    /* Posted by phTmlNfc_CompleteWriteSeq after the write completion */
+    NXPLOG_TML_D("PN54X - Read completion held for write completion");
+    gpphTmlNfc_Context->bRxDeliverHeld = true;
+    return;
+  }
+  gpphTmlNfc_Context->bRxRingNext =
+      (gpphTmlNfc_Context->bRxRingNext + 1) % PH_TMLNFC_RX_RING_SIZE;
+  gpphTmlNfc_Context->bRxRingReady--;
+  __atomic_store_n(&pSlot->bState, phTmlNfc_e_RxSlotDelivered,
+                   __ATOMIC_RELEASE);
+  /* Prepare the message to be posted on User thread */
+  pSlot->tDeferredInfo.pCallback = &phTmlNfc_ReadDeferredCb;
+  pSlot->tDeferredInfo.pParameter = &pSlot->tTransactInfo;
+  pSlot->tMsg.eMsgType = PH_LIBNFC_DEFERREDCALL_MSG;
+  pSlot->tMsg.pMsgData = &pSlot->tDeferredInfo;
+  pSlot->tMsg.Size = sizeof(pSlot->tDeferredInfo);
+  phTmlNfc_PostMsg(&pSlot->tMsg, phTmlNfc_RxSlotIsType(pSlot, 0x40)
+                                     ? PHDAL4NFC_MSG_URGENT
+                                     : 0);
 }
 
-void phTmlNfc_set_fragmentation_enabled(phTmlNfc_i2cfragmentation_t result) {
-  fragmentation_enabled = result;
+/*******************************************************************************
+**
+** Function         phTmlNfc_BeginWriteSeq
+**
+** Description      Assigns the next sequence number to a write about to be
+**                  issued on the lower layer driver. Responses read from now
+**                  on are posted only after the completion of this write.
+**
+** Parameters       None
+**
+** Returns          Sequence number of the write
+**
+*******************************************************************************/
+static uint32_t phTmlNfc_BeginWriteSeq(void) {
+  uint32_t dwSeq;
+
+  pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+  dwSeq = ++gpphTmlNfc_Context->dwWriteSeq;
+  pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+  return dwSeq;
 }
 
-phTmlNfc_i2cfragmentation_t phTmlNfc_get_fragmentation_enabled() {
-  return fragmentation_enabled;
+/*******************************************************************************
+**
+** Function         phTmlNfc_CompleteWriteSeq
+**
+** Description      Marks the write as completed once its completion message
+**                  has been posted (or not posted in case of retransmission)
+**                  and posts a read completion held back for it.
+**
+** Parameters       dwSeq - sequence number from phTmlNfc_BeginWriteSeq
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_CompleteWriteSeq(uint32_t dwSeq) {
+  pthread_mutex_lock(&gpphTmlNfc_Context->readInfoUpdateMutex);
+  gpphTmlNfc_Context->dwWriteDoneSeq = dwSeq;
+  if (gpphTmlNfc_Context->bRxDeliverHeld) {
+    gpphTmlNfc_Context->bRxDeliverHeld = false;
+    phTmlNfc_DeliverRxSlot();
+  }
+  pthread_mutex_unlock(&gpphTmlNfc_Context->readInfoUpdateMutex);
 }
 
 /*******************************************************************************
 **
-** Function         phTmlNfc_WaitWriteComplete
+** Function         phTmlNfc_PutRxSlot
 **
-** Description      wait function for reader thread
+** Description      Hands a receive slot back to the reader, either the slot
+**                  returned by phTmlNfc_GetRxSlot when nothing was read into
+**                  it, or the oldest slot released by the upper layer. In event
+**                  loop mode the loop is woken up if it stopped reading because
+**                  all the slots were in use.
 **
 ** Parameters       None
 **
 ** Returns          None
 **
 *******************************************************************************/
-static void phTmlNfc_WaitWriteComplete(void) {
-  int ret = -1;
-  struct timespec absTimeout;
-  if (clock_gettime(CLOCK_MONOTONIC, &absTimeout) == -1) {
-    NXPLOG_TML_E("Reader Thread clock_gettime failed");
-  } else {
-    absTimeout.tv_sec += 1; /*1 second timeout*/
-    gpphTmlNfc_Context->wait_busy_flag = true;
-    NXPLOG_TML_D("phTmlNfc_WaitWriteComplete - enter");
-    ret = pthread_cond_timedwait(&gpphTmlNfc_Context->wait_busy_condition,
-                                 &gpphTmlNfc_Context->wait_busy_lock,
-                                 &absTimeout);
-    if ((ret != 0) && (ret != ETIMEDOUT)) {
-      NXPLOG_TML_E("Reader Thread wait failed");
+static void phTmlNfc_PutRxSlot(void) {
+  int nFreeSlots = 0;
+
+  sem_post(&gpphTmlNfc_Context->rxSlotSemaphore);
+  if (gpphTmlNfc_Context->bEventLoop) {
+    sem_getvalue(&gpphTmlNfc_Context->rxSlotSemaphore, &nFreeSlots);
+    if (1 == nFreeSlots) {
+      phTmlNfc_PostEvent(&gpphTmlNfc_Context->rxSemaphore);
     }
-    NXPLOG_TML_D("phTmlNfc_WaitWriteComplete - exit");
   }
 }
 
 /*******************************************************************************
 **
-** Function         phTmlNfc_SignalWriteComplete
+** Function         phTmlNfc_ReleaseRxSlot
 **
-** Description      function to invoke reader thread
+** Description      Releases a receive slot once the upper layer is done with
+**                  it. The reader reuses slots in ring order, so slots are
+**                  handed back only once all older slots are released. Only
+**                  called on the callback thread.
 **
-** Parameters       None
+** Parameters       pSlot - slot posted by phTmlNfc_DeliverRxSlot
 **
 ** Returns          None
 **
 *******************************************************************************/
-static void phTmlNfc_SignalWriteComplete(void) {
-  int ret = -1;
-  if (gpphTmlNfc_Context->wait_busy_flag == true) {
-    NXPLOG_TML_D("phTmlNfc_SignalWriteComplete - enter");
-    gpphTmlNfc_Context->wait_busy_flag = false;
-
-    ret = pthread_cond_signal(&gpphTmlNfc_Context->wait_busy_condition);
-    if (ret) {
-      NXPLOG_TML_E(" phTmlNfc_SignalWriteComplete failed, error = 0x%X", ret);
+static void phTmlNfc_ReleaseRxSlot(phTmlNfc_RxSlot_t* pSlot) {
+  phTmlNfc_RxSlot_t* pTail;
+
+  __atomic_store_n(&pSlot->bState, phTmlNfc_e_RxSlotDone, __ATOMIC_RELEASE);
+  while (true) {
+    pTail = &gpphTmlNfc_Context->tRxRing[gpphTmlNfc_Context->bRxRingTail];
+    if (phTmlNfc_e_RxSlotDone !=
+        __atomic_load_n(&pTail->bState, __ATOMIC_ACQUIRE)) {
+      break;
     }
-    NXPLOG_TML_D("phTmlNfc_SignalWriteComplete - exit");
+    __atomic_store_n(&pTail->bState, phTmlNfc_e_RxSlotFree, __ATOMIC_RELEASE);
+    gpphTmlNfc_Context->bRxRingTail =
+        (gpphTmlNfc_Context->bRxRingTail + 1) % PH_TMLNFC_RX_RING_SIZE;
+    phTmlNfc_PutRxSlot();
   }
 }
 
 /*******************************************************************************
 **
-** Function         phTmlNfc_WaitReadInit
+** Function         phTmlNfc_WriteDeferredCb
 **
-** Description      init function for reader thread
+** Description      Write thread call back function
 **
-** Parameters       None
+** Parameters       pParams - context provided by upper layer
 **
-** Returns          int
+** Returns          None
 **
 *******************************************************************************/
-static int phTmlNfc_WaitReadInit(void) {
-  int ret = -1;
-  pthread_condattr_t attr;
-  pthread_condattr_init(&attr);
-  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
-  memset(&gpphTmlNfc_Context->wait_busy_condition, 0,
-         sizeof(gpphTmlNfc_Context->wait_busy_condition));
-  pthread_mutex_init(&gpphTmlNfc_Context->wait_busy_lock, NULL);
-  ret = pthread_cond_init(&gpphTmlNfc_Context->wait_busy_condition, &attr);
-  if (ret) {
-    NXPLOG_TML_E(" phTphTmlNfc_WaitReadInit failed, error = 0x%X", ret);
-  }
-  return ret;
+static void phTmlNfc_WriteDeferredCb(void* pParams) {
+  /* Transaction info buffer to be passed to Callback Function */
+  phTmlNfc_TransactInfo_t* pTransactionInfo = (phTmlNfc_TransactInfo_t*)pParams;
+
+  /* Reset the flag to accept another Write Request */
+  gpphTmlNfc_Context->tWriteInfo.bThreadBusy = false;
+  gpphTmlNfc_Context->tWriteInfo.pThread_Callback(
+      gpphTmlNfc_Context->tWriteInfo.pContext, pTransactionInfo);
+
+  return;
+}
+
+void phTmlNfc_set_fragmentation_enabled(phTmlNfc_i2cfragmentation_t result) {
+  fragmentation_enabled = result;
+}
+
+phTmlNfc_i2cfragmentation_t phTmlNfc_get_fragmentation_enabled() {
+  return fragmentation_enabled;
 }
 
 /*******************************************************************************
@@ -46,6 +46,16 @@
  */
 #define PH_TMLNFC_RESETDEVICE (0x00008001)
 
+/*
+ * Maximum size of one packet read from the driver
+ */
+#define PH_TMLNFC_RX_SLOT_SIZE (260)
+
+/*
+ * Number of receive slots which can be in flight towards the upper layer
+ */
+#define PH_TMLNFC_RX_RING_SIZE (0x08)
+
 /*
 ***************************Globals,Structure and Enumeration ******************
 */
@@ -129,6 +139,15 @@ typedef enum {
   phTmlNfc_e_DisableRetrans = 0x01 /*Disable retransmission of Nci packet */
 } phTmlNfc_ConfigRetrans_t;        /* Configuration for Retransmission */
 
+/*
+ * Transport backend used to exchange packets with the NFCC
+ */
+typedef enum {
+  phTmlNfc_e_TransportI2c = 0x00,    /* PN54X kernel driver */
+  phTmlNfc_e_TransportVirtual = 0x01, /* In-process virtual NFCC */
+  phTmlNfc_e_TransportReplay = 0x02   /* Replay of an NCI capture file */
+} phTmlNfc_TransportType_t;
+
 /*
  * Structure containing details related to read and write operations
  *
@@ -146,6 +165,30 @@ typedef struct phTmlNfc_ReadWriteInfo {
   NFCSTATUS wWorkStatus; /*Status of the transaction performed */
 } phTmlNfc_ReadWriteInfo_t;
 
+/*
+ * States of a receive slot
+ */
+typedef enum {
+  phTmlNfc_e_RxSlotFree = 0x00,      /* Available to the reader */
+  phTmlNfc_e_RxSlotReady = 0x01,     /* Filled, waiting for a read request */
+  phTmlNfc_e_RxSlotDelivered = 0x02, /* Posted to the callback thread */
+  phTmlNfc_e_RxSlotDone = 0x03       /* Callback returned, slot not yet reused */
+} phTmlNfc_RxSlotState_t;
+
+/*
+ * Receive slot. The reader fills aBuffer directly from the driver and posts
+ * the slot to the callback thread; the slot is reused once the upper layer
+ * callback has returned.
+ */
+typedef struct phTmlNfc_RxSlot {
+  uint8_t aBuffer[PH_TMLNFC_RX_SLOT_SIZE]; /* Packet read from the driver */
+  phTmlNfc_TransactInfo_t tTransactInfo;   /* Passed to the read callback */
+  phLibNfc_DeferredCall_t tDeferredInfo;   /* Deferred call of the slot */
+  phLibNfc_Message_t tMsg; /* Message posted onto the callback thread */
+  uint32_t dwWriteSeq;     /* Write whose completion has to be posted first */
+  uint8_t bState;          /* phTmlNfc_RxSlotState_t, accessed atomically */
+} phTmlNfc_RxSlot_t;
+
 /*
  *Base Context Structure containing members required for entire session
  */
@@ -160,24 +203,33 @@ typedef struct phTmlNfc_Context {
   uint8_t bRetryCount;     /*Number of times retransmission shall happen */
   uint8_t bWriteCbInvoked; /* Indicates whether write callback is invoked during
                               retransmission */
-  uint32_t dwTimerId;      /* Timer used to retransmit nci packet */
+  uint8_t bCurrentRetryCount; /* Retransmissions left for the current packet */
   phTmlNfc_ReadWriteInfo_t tReadInfo;  /*Pointer to Reader Thread Structure */
   phTmlNfc_ReadWriteInfo_t tWriteInfo; /*Pointer to Writer Thread Structure */
   void* pDevHandle;                    /* Pointer to Device Handle */
   uintptr_t dwCallbackThreadId; /* Thread ID to which message to be posted */
   uint8_t bEnableCrc;           /*Flag to validate/not CRC for input buffer */
   sem_t rxSemaphore;
-  sem_t txSemaphore;      /* Lock/Aquire txRx Semaphore */
   sem_t postMsgSemaphore; /* Semaphore to post message atomically by Reader &
                              writer thread */
   pthread_mutex_t readInfoUpdateMutex; /*Mutex to synchronize read Info update*/
-  pthread_cond_t wait_busy_condition; /*Condition to wait reader thread*/
-  pthread_mutex_t wait_busy_lock;     /*Condition lock to wait reader thread*/
-  volatile uint8_t wait_busy_flag;    /*Condition flag to wait reader thread*/
-  volatile uint8_t
-      gWriterCbflag; /* flag to indicate write callback message is pushed to
-                        queue*/
+  uint32_t dwWriteSeq;     /* Sequence number of the last write started */
+  uint32_t dwWriteDoneSeq; /* Sequence number of the last write completed */
+  uint8_t bRxDeliverHeld;  /* Read completion held back for a write completion */
   long    nfc_service_pid; /*NFC Service PID to be used by driver to signal*/
+  uint8_t bEventLoop; /* Flag to run reads and writes from one epoll thread */
+  int nEpollFd;       /* epoll instance used by the event loop thread */
+  int nEventFd;       /* eventfd signalled on new write requests, and on read
+                         requests in event loop mode */
+  int nReTxTimerFd;   /* timerfd used for retransmission of Nci packets */
+  phTmlNfc_RxSlot_t tRxRing[PH_TMLNFC_RX_RING_SIZE]; /* Receive slot ring */
+  uint8_t bRxRingHead;   /* Next receive slot to be filled by the reader */
+  uint8_t bRxRingNext;   /* Oldest filled slot not yet delivered */
+  uint8_t bRxRingReady;  /* Number of filled slots not yet delivered */
+  uint8_t bRxRingTail;   /* Oldest slot not yet reused, callback thread only */
+  uint8_t bReadAhead;    /* Flag to read packets before they are requested */
+  sem_t rxSlotSemaphore; /* Counts the receive slots free for the reader */
+  const struct phTmlNfc_Transport* pTransport; /* Backend owning pDevHandle */
 } phTmlNfc_Context_t;
 
 /*
@@ -199,8 +251,57 @@ typedef struct phTmlNfc_Config {
    *
    * This is the baudrate of the bus for communication between DH and PN54X */
   uint32_t dwBaudRate;
+  /* Event loop mode
+   *
+   * If set, reads, writes and retransmission of Nci packets are handled by a
+   * single epoll based thread instead of separate reader and writer threads */
+  uint8_t bEventLoop;
+  /* Read-ahead mode
+   *
+   * If set, the reader keeps reading packets into free receive slots even
+   * if no read is pending. Queued packets are delivered in order on the next
+   * phTmlNfc_Read */
+  uint8_t bReadAhead;
+  /* Transport backend
+   *
+   * Selects how packets reach the NFCC. The virtual backend answers NCI
+   * commands in-process and needs no device node */
+  phTmlNfc_TransportType_t eTransport;
+  /* Single read mode
+   *
+   * If set, the I2C transport reads a whole NCI frame with one read call
+   * and keeps any following frame it pulled in for the next read */
+  uint8_t bSingleRead;
+  /* NCI capture file
+   *
+   * If set, every frame written to or read from the NFCC is appended to this
+   * file in the phTmlNfc_capture.h format. Only used during phTmlNfc_Init */
+  int8_t* pCaptureFile;
+  /* NCI replay file
+   *
+   * Capture file played back by the replay transport. Only used during
+   * phTmlNfc_Init */
+  int8_t* pReplayFile;
 } phTmlNfc_Config_t, *pphTmlNfc_Config_t; /* pointer to phTmlNfc_Config_t */
 
+/*
+ * Transport backend operations. The device handle returned by
+ * open_and_configure has to be a file descriptor that can be polled for
+ * input, as the reader and the event loop wait on it.
+ */
+typedef struct phTmlNfc_Transport {
+  const char* pName; /* Backend name used in logs */
+  NFCSTATUS (*open_and_configure)(pphTmlNfc_Config_t pConfig,
+                                  void** pLinkHandle);
+  int (*read)(void* pDevHandle, uint8_t* pBuffer, int nNbBytesToRead);
+  int (*write)(void* pDevHandle, uint8_t* pBuffer, int nNbBytesToWrite);
+  int (*reset)(void* pDevHandle, long level);
+  void (*close)(void* pDevHandle);
+  /* Returns non zero if data already read from the device is waiting for the
+   * next read. Optional, NULL for backends that buffer nothing */
+  int (*pending)(void* pDevHandle);
+} phTmlNfc_Transport_t;
+
 /*
  * TML Deferred Callback structure used to invoke Upper layer Callback function.
  */
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML binary NCI capture.
+ *
+ * The TML reader and writer copy frames into a bounded lock-free ring (one
+ * sequence number per slot, producers claim slots with a compare and swap)
+ * and never block or enter the kernel, except for waking the flusher when
+ * the ring is half full. A flusher thread appends the records to the capture
+ * file. Frames arriving while the ring is full are dropped and counted.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <phNxpLog.h>
+#include <phTmlNfc_capture.h>
+
+/* Ring size, power of two */
+#define CAPTURE_SLOTS (0x40)
+#define CAPTURE_SLOT_MASK (CAPTURE_SLOTS - 1)
+/* Flusher period when the ring does not fill up */
+#define CAPTURE_FLUSH_PERIOD_MS (100)
+
+typedef struct phTmlNfc_CaptureSlot {
+  uint32_t dwSeq; /* Equal to the claim position while free, +1 once filled */
+  phTmlNfc_CaptureRecord_t tRecord;
+  uint8_t aData[PH_TMLNFC_CAPTURE_MAX_FRAME];
+} phTmlNfc_CaptureSlot_t;
+
+static phTmlNfc_CaptureSlot_t gCaptureRing[CAPTURE_SLOTS];
+static uint32_t dwCaptureEnqueuePos = 0;
+static uint32_t dwCaptureDequeuePos = 0;
+static uint32_t dwCaptureDropped = 0;
+static uint8_t bCaptureActive = false;
+static int nCaptureFd = -1;
+static pthread_t captureThread;
+static sem_t captureSemaphore;
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_CaptureDrain
+**
+** Description      Appends all filled slots to the capture file. Only called
+**                  by the flusher, which is the single consumer of the ring.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_CaptureDrain(void) {
+  phTmlNfc_CaptureSlot_t* pSlot;
+  struct iovec aIov[2];
+  uint32_t dwPos = dwCaptureDequeuePos;
+
+  while (true) {
+    pSlot = &gCaptureRing[dwPos & CAPTURE_SLOT_MASK];
+    if ((int32_t)(__atomic_load_n(&pSlot->dwSeq, __ATOMIC_ACQUIRE) -
+                  (dwPos + 1)) < 0) {
+      break;
+    }
+    aIov[0].iov_base = &pSlot->tRecord;
+    aIov[0].iov_len = sizeof(pSlot->tRecord);
+    aIov[1].iov_base = pSlot->aData;
+    aIov[1].iov_len = pSlot->tRecord.wLength;
+    if (writev(nCaptureFd, aIov, 2) < 0) {
+      NXPLOG_TML_E("%s: write failed errno = 0x%x", __func__, errno);
+    }
+    /* Hand the slot back to the producers for the next lap */
+    __atomic_store_n(&pSlot->dwSeq, dwPos + CAPTURE_SLOTS, __ATOMIC_RELEASE);
+    dwPos++;
+    __atomic_store_n(&dwCaptureDequeuePos, dwPos, __ATOMIC_RELEASE);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_CaptureThread
+**
+** Description      Flusher thread, drains the ring periodically or when woken
+**                  up by a producer
+**
+** Parameters       pParam - unused
+**
+** Returns          NULL
+**
+*******************************************************************************/
+static void* phTmlNfc_CaptureThread(void* pParam) {
+  struct timespec tDeadline;
+  UNUSED(pParam);
+
+  while (__atomic_load_n(&bCaptureActive, __ATOMIC_ACQUIRE)) {
+    clock_gettime(CLOCK_REALTIME, &tDeadline);
+    tDeadline.tv_nsec += CAPTURE_FLUSH_PERIOD_MS * 1000000L;
+    if (tDeadline.tv_nsec >= 1000000000L) {
+      tDeadline.tv_sec++;
+      tDeadline.tv_nsec -= 1000000000L;
+    }
+    (void)sem_timedwait(&captureSemaphore, &tDeadline);
+    phTmlNfc_CaptureDrain();
+  }
+  phTmlNfc_CaptureDrain();
+  return NULL;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_CaptureStart
+**
+** Description      Opens the capture file for appending, writes a session
+**                  marker and starts the flusher
+**
+** Parameters       pFileName - capture file
+**
+** Returns          NFCSTATUS_SUCCESS if capturing started
+**
+*******************************************************************************/
+NFCSTATUS phTmlNfc_CaptureStart(const char* pFileName) {
+  phTmlNfc_CaptureFileHeader_t tFileHeader;
+  struct stat tStat;
+  uint32_t i;
+
+  if ((NULL == pFileName) || (bCaptureActive)) {
+    return NFCSTATUS_FAILED;
+  }
+  nCaptureFd =
+      open(pFileName, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0660);
+  if (nCaptureFd < 0) {
+    NXPLOG_TML_E("%s: open %s failed errno = 0x%x", __func__, pFileName,
+                 errno);
+    return NFCSTATUS_FAILED;
+  }
+  if ((0 == fstat(nCaptureFd, &tStat)) && (0 == tStat.st_size)) {
+    tFileHeader.dwMagic = PH_TMLNFC_CAPTURE_MAGIC;
+    tFileHeader.wVersion = PH_TMLNFC_CAPTURE_VERSION;
+    tFileHeader.wRecordHeaderLen = sizeof(phTmlNfc_CaptureRecord_t);
+    if (write(nCaptureFd, &tFileHeader, sizeof(tFileHeader)) < 0) {
+      NXPLOG_TML_E("%s: write failed errno = 0x%x", __func__, errno);
+    }
+  }
+
+  for (i = 0; i < CAPTURE_SLOTS; i++) {
+    gCaptureRing[i].dwSeq = i;
+  }
+  dwCaptureEnqueuePos = 0;
+  dwCaptureDequeuePos = 0;
+  dwCaptureDropped = 0;
+  if (0 != sem_init(&captureSemaphore, 0, 0)) {
+    close(nCaptureFd);
+    nCaptureFd = -1;
+    return NFCSTATUS_FAILED;
+  }
+  __atomic_store_n(&bCaptureActive, true, __ATOMIC_RELEASE);
+  if (0 != pthread_create(&captureThread, NULL, phTmlNfc_CaptureThread,
+                          NULL)) {
+    __atomic_store_n(&bCaptureActive, false, __ATOMIC_RELEASE);
+    sem_destroy(&captureSemaphore);
+    close(nCaptureFd);
+    nCaptureFd = -1;
+    return NFCSTATUS_FAILED;
+  }
+  phTmlNfc_CaptureFrame(phTmlNfc_e_CaptureSession, NULL, 0);
+  NXPLOG_TML_D("NCI capture to %s started", pFileName);
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_CaptureStop
+**
+** Description      Stops the flusher once it has written all captured frames
+**                  and closes the capture file. TML reader and writer must
+**                  have stopped.
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_CaptureStop(void) {
+  if (!bCaptureActive) {
+    return;
+  }
+  __atomic_store_n(&bCaptureActive, false, __ATOMIC_RELEASE);
+  sem_post(&captureSemaphore);
+  pthread_join(captureThread, NULL);
+  sem_destroy(&captureSemaphore);
+  close(nCaptureFd);
+  nCaptureFd = -1;
+  if (dwCaptureDropped > 0) {
+    NXPLOG_TML_E("NCI capture dropped %u frames", dwCaptureDropped);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_CaptureFrame
+**
+** Description      Records a frame if capturing is active. Safe to call from
+**                  any thread, never blocks.
+**
+** Parameters       eDirection - direction of the frame
+**                  pBuffer    - frame
+**                  wLength    - frame length
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_CaptureFrame(phTmlNfc_CaptureDir_t eDirection,
+                           const uint8_t* pBuffer, uint16_t wLength) {
+  phTmlNfc_CaptureSlot_t* pSlot;
+  struct timespec tNow;
+  uint32_t dwPos;
+  int32_t nDiff;
+
+  if (!__atomic_load_n(&bCaptureActive, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &tNow);
+
+  /* Claim the slot at the enqueue position */
+  dwPos = __atomic_load_n(&dwCaptureEnqueuePos, __ATOMIC_RELAXED);
+  while (true) {
+    pSlot = &gCaptureRing[dwPos & CAPTURE_SLOT_MASK];
+    nDiff = (int32_t)(__atomic_load_n(&pSlot->dwSeq, __ATOMIC_ACQUIRE) - dwPos);
+    if (0 == nDiff) {
+      if (__atomic_compare_exchange_n(&dwCaptureEnqueuePos, &dwPos, dwPos + 1,
+                                      true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (nDiff < 0) {
+      /* Flusher is a full lap behind */
+      __atomic_fetch_add(&dwCaptureDropped, 1, __ATOMIC_RELAXED);
+      return;
+    } else {
+      dwPos = __atomic_load_n(&dwCaptureEnqueuePos, __ATOMIC_RELAXED);
+    }
+  }
+
+  pSlot->tRecord.qwTimestampNs =
+      (uint64_t)tNow.tv_sec * 1000000000ULL + tNow.tv_nsec;
+  pSlot->tRecord.bDirection = (uint8_t)eDirection;
+  pSlot->tRecord.bFlags = 0;
+  if (wLength > PH_TMLNFC_CAPTURE_MAX_FRAME) {
+    pSlot->tRecord.bFlags |= PH_TMLNFC_CAPTURE_TRUNCATED;
+    wLength = PH_TMLNFC_CAPTURE_MAX_FRAME;
+  }
+  pSlot->tRecord.wLength = wLength;
+  if (wLength > 0) {
+    memcpy(pSlot->aData, pBuffer, wLength);
+  }
+  __atomic_store_n(&pSlot->dwSeq, dwPos + 1, __ATOMIC_RELEASE);
+
+  if ((dwPos + 1 - __atomic_load_n(&dwCaptureDequeuePos, __ATOMIC_ACQUIRE)) ==
+      (CAPTURE_SLOTS / 2)) {
+    sem_post(&captureSemaphore);
+  }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML binary NCI capture.
+ *
+ * File layout, all fields little endian:
+ *   phTmlNfc_CaptureFileHeader_t once at the start of the file, then for
+ *   every frame a phTmlNfc_CaptureRecord_t followed by wLength frame bytes.
+ * A marker record without payload is written whenever TML is initialized,
+ * so one file can hold several HAL sessions.
+ */
+#ifndef PHTMLNFC_CAPTURE_H
+#define PHTMLNFC_CAPTURE_H
+
+#include <phNfcTypes.h>
+
+#define PH_TMLNFC_CAPTURE_MAGIC (0x5041434EU) /* "NCAP" */
+#define PH_TMLNFC_CAPTURE_VERSION (0x0001)
+/* Longest frame stored, longer frames are truncated */
+#define PH_TMLNFC_CAPTURE_MAX_FRAME (260)
+
+/*
+ * Direction of a captured frame
+ */
+typedef enum {
+  phTmlNfc_e_CaptureTx = 0x00,     /* Written to the NFCC */
+  phTmlNfc_e_CaptureRx = 0x01,     /* Read from the NFCC */
+  phTmlNfc_e_CaptureSession = 0x02 /* TML initialized, no payload */
+} phTmlNfc_CaptureDir_t;
+
+/* Record flags */
+#define PH_TMLNFC_CAPTURE_TRUNCATED (0x01) /* Frame longer than stored */
+
+typedef struct __attribute__((packed)) phTmlNfc_CaptureFileHeader {
+  uint32_t dwMagic;   /* PH_TMLNFC_CAPTURE_MAGIC */
+  uint16_t wVersion;  /* PH_TMLNFC_CAPTURE_VERSION */
+  uint16_t wRecordHeaderLen; /* sizeof(phTmlNfc_CaptureRecord_t) */
+} phTmlNfc_CaptureFileHeader_t;
+
+typedef struct __attribute__((packed)) phTmlNfc_CaptureRecord {
+  uint64_t qwTimestampNs; /* CLOCK_MONOTONIC */
+  uint8_t bDirection;     /* phTmlNfc_CaptureDir_t */
+  uint8_t bFlags;         /* PH_TMLNFC_CAPTURE_* flags */
+  uint16_t wLength;       /* Frame bytes following the record */
+} phTmlNfc_CaptureRecord_t;
+
+/* Function declarations */
+NFCSTATUS phTmlNfc_CaptureStart(const char* pFileName);
+void phTmlNfc_CaptureStop(void);
+void phTmlNfc_CaptureFrame(phTmlNfc_CaptureDir_t eDirection,
+                           const uint8_t* pBuffer, uint16_t wLength);
+
+#endif /* PHTMLNFC_CAPTURE_H */
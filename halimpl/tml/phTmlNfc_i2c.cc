@@ -28,6 +28,7 @@
 #include <sys/ioctl.h>
 #include <sys/select.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include <phNxpLog.h>
 #include <phTmlNfc_i2c.h>
@@ -41,8 +42,39 @@
 #define FW_DNLD_LEN_OFFSET 1
 #define NORMAL_MODE_LEN_OFFSET 2
 #define FRAGMENTSIZE_MAX PHNFC_I2C_FRAGMENT_SIZE
+/* Pause between fragments of a frame, adapted to the NFCC in microseconds.
+ * It never goes below the fixed pause the NFCC was always given. */
+#define FRAGMENT_DELAY_MIN_US 500
+#define FRAGMENT_DELAY_MAX_US 4000
+#define FRAGMENT_DELAY_STEP_US 100
+/* Back-offs allowed while writing one frame before giving up */
+#define FRAGMENT_MAX_BACKOFF 5
+/* Largest NCI frame, also the most read ahead of a frame in single read mode */
+#define NORMAL_MODE_FRAME_MAX (NORMAL_MODE_HEADER_LEN + 0xFF)
+/* NCI message types the NFCC can send */
+#define NORMAL_MODE_MT_MASK 0xE0
+#define NORMAL_MODE_MT_DATA 0x00
+#define NORMAL_MODE_MT_RSP 0x40
+#define NORMAL_MODE_MT_NTF 0x60
 static bool_t bFwDnldFlag = false;
 bool_t notifyFwrequest;
+static int gFragmentDelayUs = FRAGMENT_DELAY_MIN_US;
+/* Single read mode, bytes read past the end of the last frame returned.
+ * Written by the reader, reset and close, read by the TML event loop. */
+static bool_t bSingleRead = false;
+static pthread_mutex_t gReadCarryMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t gReadCarry[NORMAL_MODE_FRAME_MAX];
+static int gReadCarryLen = 0;
+
+const phTmlNfc_Transport_t gphTmlNfc_I2cTransport = {
+    "i2c",
+    phTmlNfc_i2c_open_and_configure,
+    phTmlNfc_i2c_read,
+    phTmlNfc_i2c_write,
+    phTmlNfc_i2c_reset,
+    phTmlNfc_i2c_close,
+    phTmlNfc_i2c_pending,
+};
 
 /*******************************************************************************
 **
@@ -59,6 +91,9 @@ void phTmlNfc_i2c_close(void* pDevHandle) {
   if (NULL != pDevHandle) {
     close((intptr_t)pDevHandle);
   }
+  pthread_mutex_lock(&gReadCarryMutex);
+  gReadCarryLen = 0;
+  pthread_mutex_unlock(&gReadCarryMutex);
 
   return;
 }
@@ -91,6 +126,11 @@ NFCSTATUS phTmlNfc_i2c_open_and_configure(pphTmlNfc_Config_t pConfig,
   }
 
   *pLinkHandle = (void*)((intptr_t)nHandle);
+  gFragmentDelayUs = FRAGMENT_DELAY_MIN_US;
+  bSingleRead = pConfig->bSingleRead;
+  pthread_mutex_lock(&gReadCarryMutex);
+  gReadCarryLen = 0;
+  pthread_mutex_unlock(&gReadCarryMutex);
 
   /*Reset PN54X*/
   phTmlNfc_i2c_reset((void*)((intptr_t)nHandle), 0);
@@ -100,6 +140,171 @@ NFCSTATUS phTmlNfc_i2c_open_and_configure(pphTmlNfc_Config_t pConfig,
   return NFCSTATUS_SUCCESS;
 }
 
+/*******************************************************************************
+**
+** Function         phTmlNfc_i2c_wait_readable
+**
+** Description      Waits for up to 2 seconds for the PN54X to signal data
+**
+** Parameters       pDevHandle - valid device handle
+**
+** Returns          0 if data is available, -1 on timeout or failure
+**
+*******************************************************************************/
+static int phTmlNfc_i2c_wait_readable(void* pDevHandle) {
+  int ret_Select;
+  struct timeval tv;
+  fd_set rfds;
+
+  FD_ZERO(&rfds);
+  FD_SET((intptr_t)pDevHandle, &rfds);
+  tv.tv_sec = 2;
+  tv.tv_usec = 1;
+
+  ret_Select =
+      select((int)((intptr_t)pDevHandle + (int)1), &rfds, NULL, NULL, &tv);
+  if (ret_Select < 0) {
+    NXPLOG_TML_D("i2c select() errno : %x", errno);
+    return -1;
+  } else if (ret_Select == 0) {
+    NXPLOG_TML_D("i2c select() Timeout");
+    return -1;
+  }
+  return 0;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_i2c_read_frame
+**
+** Description      Single read mode. Reads as much as the buffer holds with
+**                  one read call and splits the frames in user space. Bytes
+**                  following the returned frame are kept for the next call if
+**                  they start with a whole plausible NCI frame (RSP, NTF or
+**                  non empty DATA), otherwise they are the NFCC idle pattern
+**                  or a fragment that cannot be told from it, and are
+**                  dropped. Further reads are only issued for a frame that
+**                  the first read returned incomplete.
+**
+** Parameters       pDevHandle     - valid device handle
+**                  pBuffer        - buffer for read data
+**                  nNbBytesToRead - size of pBuffer
+**
+** Returns          numRead   - length of the frame returned in pBuffer
+**                  -1        - read operation failure
+**
+*******************************************************************************/
+static int phTmlNfc_i2c_read_frame(void* pDevHandle, uint8_t* pBuffer,
+                                   int nNbBytesToRead) {
+  int ret_Read;
+  int numRead = 0;
+  int frameLen = 0;
+  int toRead;
+  int surplus;
+  int nextLen;
+  uint8_t bNextMt;
+
+  if (nNbBytesToRead > NORMAL_MODE_FRAME_MAX) {
+    nNbBytesToRead = NORMAL_MODE_FRAME_MAX;
+  }
+  /* Start from what the previous read pulled in past its frame, what does
+   * not fit in pBuffer stays at the start of the carry */
+  pthread_mutex_lock(&gReadCarryMutex);
+  if (gReadCarryLen > 0) {
+    numRead = (gReadCarryLen < nNbBytesToRead) ? gReadCarryLen
+                                               : nNbBytesToRead;
+    memcpy(pBuffer, gReadCarry, numRead);
+    gReadCarryLen -= numRead;
+    memmove(gReadCarry, gReadCarry + numRead, gReadCarryLen);
+  }
+  pthread_mutex_unlock(&gReadCarryMutex);
+  if ((0 == numRead) && (0 != phTmlNfc_i2c_wait_readable(pDevHandle))) {
+    return -1;
+  }
+
+  while (true) {
+    if (numRead >= NORMAL_MODE_HEADER_LEN) {
+      frameLen = pBuffer[NORMAL_MODE_LEN_OFFSET] + NORMAL_MODE_HEADER_LEN;
+      if (frameLen > nNbBytesToRead) {
+        NXPLOG_TML_E("_i2c_read() frame of %d bytes exceeds buffer", frameLen);
+        return -1;
+      }
+      if (numRead >= frameLen) {
+        break;
+      }
+    }
+    /* First read takes whatever fits, completions only what is missing */
+    if (0 == numRead) {
+      toRead = nNbBytesToRead;
+    } else if (numRead < NORMAL_MODE_HEADER_LEN) {
+      toRead = NORMAL_MODE_HEADER_LEN - numRead;
+    } else {
+      toRead = frameLen - numRead;
+    }
+    ret_Read = read((intptr_t)pDevHandle, pBuffer + numRead, toRead);
+    if (ret_Read > 0) {
+      numRead += ret_Read;
+    } else if (ret_Read == 0) {
+      NXPLOG_TML_E("_i2c_read() EOF");
+      return -1;
+    } else {
+      NXPLOG_TML_E("_i2c_read() errno : %x", errno);
+      return -1;
+    }
+  }
+
+  surplus = numRead - frameLen;
+  if (surplus <= 0) {
+    return frameLen;
+  }
+  /* The surplus goes back in front of the carry left over. It is kept only
+   * if it starts with a whole frame, a shorter fragment cannot be told from
+   * the idle pattern. */
+  pthread_mutex_lock(&gReadCarryMutex);
+  memmove(gReadCarry + surplus, gReadCarry, gReadCarryLen);
+  memcpy(gReadCarry, pBuffer + frameLen, surplus);
+  gReadCarryLen += surplus;
+  bNextMt = gReadCarry[0] & NORMAL_MODE_MT_MASK;
+  nextLen = (gReadCarryLen >= NORMAL_MODE_HEADER_LEN)
+                ? gReadCarry[NORMAL_MODE_LEN_OFFSET] + NORMAL_MODE_HEADER_LEN
+                : 0;
+  if ((nextLen == 0) || (nextLen > gReadCarryLen) ||
+      ((NORMAL_MODE_MT_RSP != bNextMt) && (NORMAL_MODE_MT_NTF != bNextMt) &&
+       ((NORMAL_MODE_MT_DATA != bNextMt) ||
+        (nextLen == NORMAL_MODE_HEADER_LEN)))) {
+    if ((nextLen > gReadCarryLen) && (NORMAL_MODE_MT_DATA != bNextMt)) {
+      NXPLOG_TML_E("_i2c_read() dropped %d bytes of a %d bytes frame",
+                   gReadCarryLen, nextLen);
+    }
+    gReadCarryLen = 0;
+  }
+  pthread_mutex_unlock(&gReadCarryMutex);
+  return frameLen;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_i2c_pending
+**
+** Description      Tells whether single read mode holds bytes of a frame that
+**                  were already read from the PN54X. Such frames do not make
+**                  the device readable again.
+**
+** Parameters       pDevHandle - valid device handle
+**
+** Returns          number of bytes held for the next read
+**
+*******************************************************************************/
+int phTmlNfc_i2c_pending(void* pDevHandle) {
+  int carryLen;
+
+  UNUSED(pDevHandle);
+  pthread_mutex_lock(&gReadCarryMutex);
+  carryLen = gReadCarryLen;
+  pthread_mutex_unlock(&gReadCarryMutex);
+  return carryLen;
+}
+
 /*******************************************************************************
 **
 ** Function         phTmlNfc_i2c_read
@@ -123,10 +328,12 @@ int phTmlNfc_i2c_read(void* pDevHandle, uint8_t* pBuffer, int nNbBytesToRead) {
   fd_set rfds;
   uint16_t totalBtyesToRead = 0;
 
-  UNUSED(nNbBytesToRead);
   if (NULL == pDevHandle) {
     return -1;
   }
+  if ((true == bSingleRead) && (false == bFwDnldFlag)) {
+    return phTmlNfc_i2c_read_frame(pDevHandle, pBuffer, nNbBytesToRead);
+  }
 
   if (false == bFwDnldFlag) {
     totalBtyesToRead = NORMAL_MODE_HEADER_LEN;
@@ -213,7 +420,11 @@ int phTmlNfc_i2c_read(void* pDevHandle, uint8_t* pBuffer, int nNbBytesToRead) {
 ** Function         phTmlNfc_i2c_write
 **
 ** Description      Writes requested number of bytes from given buffer into
-**                  PN54X device
+**                  PN54X device. Fragments of a large frame are paced by a
+**                  delay that doubles whenever the NFCC refuses a fragment
+**                  and shrinks back towards FRAGMENT_DELAY_MIN_US after
+**                  every frame sent without refusal. A refused fragment,
+**                  the first one included, is retried after the delay.
 **
 ** Parameters       pDevHandle       - valid device handle
 **                  pBuffer          - buffer for read data
@@ -228,6 +439,8 @@ int phTmlNfc_i2c_write(void* pDevHandle, uint8_t* pBuffer,
   int ret;
   int numWrote = 0;
   int numBytes = nNbBytesToWrite;
+  int backoff = 0;
+  bool_t bFragmented;
   if (NULL == pDevHandle) {
     return -1;
   }
@@ -238,9 +451,10 @@ int phTmlNfc_i2c_write(void* pDevHandle, uint8_t* pBuffer,
         "fragmentation");
     return -1;
   }
+  bFragmented = (fragmentation_enabled == I2C_FRAGMENTATION_ENABLED &&
+                 nNbBytesToWrite > FRAGMENTSIZE_MAX);
   while (numWrote < nNbBytesToWrite) {
-    if (fragmentation_enabled == I2C_FRAGMENTATION_ENABLED &&
-        nNbBytesToWrite > FRAGMENTSIZE_MAX) {
+    if (bFragmented) {
       if (nNbBytesToWrite - numWrote > FRAGMENTSIZE_MAX) {
         numBytes = numWrote + FRAGMENTSIZE_MAX;
       } else {
@@ -250,22 +464,46 @@ int phTmlNfc_i2c_write(void* pDevHandle, uint8_t* pBuffer,
     ret = write((intptr_t)pDevHandle, pBuffer + numWrote, numBytes - numWrote);
     if (ret > 0) {
       numWrote += ret;
-      if (fragmentation_enabled == I2C_FRAGMENTATION_ENABLED &&
-          numWrote < nNbBytesToWrite) {
-        usleep(500);
+      if (bFragmented && (numWrote < nNbBytesToWrite)) {
+        usleep(gFragmentDelayUs);
       }
     } else if (ret == 0) {
       NXPLOG_TML_D("_i2c_write() EOF");
       return -1;
     } else {
       NXPLOG_TML_D("_i2c_write() errno : %x", errno);
-      if (errno == EINTR || errno == EAGAIN) {
+      if (errno == EINTR) {
+        continue;
+      }
+      /* NFCC not ready for the fragment, a NACK leaves nothing written
+       * so the fragment is retried after backing off */
+      if (bFragmented && ((errno == EAGAIN) || (errno == EREMOTEIO))) {
+        if (++backoff > FRAGMENT_MAX_BACKOFF) {
+          return -1;
+        }
+        gFragmentDelayUs *= 2;
+        if (gFragmentDelayUs > FRAGMENT_DELAY_MAX_US) {
+          gFragmentDelayUs = FRAGMENT_DELAY_MAX_US;
+        }
+        NXPLOG_TML_D("_i2c_write() fragment delay raised to %d us",
+                     gFragmentDelayUs);
+        usleep(gFragmentDelayUs);
+        continue;
+      }
+      if (errno == EAGAIN) {
         continue;
       }
       return -1;
     }
   }
 
+  if (bFragmented && (0 == backoff) &&
+      (gFragmentDelayUs > FRAGMENT_DELAY_MIN_US)) {
+    gFragmentDelayUs =
+        (gFragmentDelayUs - FRAGMENT_DELAY_STEP_US > FRAGMENT_DELAY_MIN_US)
+            ? (gFragmentDelayUs - FRAGMENT_DELAY_STEP_US)
+            : FRAGMENT_DELAY_MIN_US;
+  }
   return numWrote;
 }
 
@@ -290,6 +528,10 @@ int phTmlNfc_i2c_reset(void* pDevHandle, long level) {
   if (NULL == pDevHandle) {
     return -1;
   }
+  /* Whatever was read ahead belongs to the NFCC state being reset */
+  pthread_mutex_lock(&gReadCarryMutex);
+  gReadCarryLen = 0;
+  pthread_mutex_unlock(&gReadCarryMutex);
   ret = ioctl((intptr_t)pDevHandle, PN544_SET_PWR, level);
   if (ret < 0) {
     NXPLOG_TML_E("%s :failed errno = 0x%x", __func__, errno);
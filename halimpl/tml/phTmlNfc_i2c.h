@@ -29,9 +29,12 @@ NFCSTATUS phTmlNfc_i2c_open_and_configure(pphTmlNfc_Config_t pConfig,
 int phTmlNfc_i2c_read(void* pDevHandle, uint8_t* pBuffer, int nNbBytesToRead);
 int phTmlNfc_i2c_write(void* pDevHandle, uint8_t* pBuffer, int nNbBytesToWrite);
 int phTmlNfc_i2c_reset(void* pDevHandle, long level);
+int phTmlNfc_i2c_pending(void* pDevHandle);
 bool_t getDownloadFlag(void);
 extern bool_t notifyFwrequest;
 extern phTmlNfc_i2cfragmentation_t fragmentation_enabled;
+/* Transport backend driving the PN54X kernel driver */
+extern const phTmlNfc_Transport_t gphTmlNfc_I2cTransport;
 
 /*
  * PN544 power control via ioctl
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML capture replay transport.
+ *
+ * The frames captured from the NFCC are queued into a pipe, as done by the
+ * virtual NFCC, and reach phNxpNciHal_read_complete through the regular TML
+ * reader. Frames read before the first write are released on open, the
+ * frames following a captured write are released once the HAL writes a
+ * frame in its place. Written frames are compared with the capture and
+ * divergences are logged. Replay is untimed, frames are released as fast as
+ * the HAL consumes them.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <phNxpLog.h>
+#include <phTmlNfc_capture.h>
+#include <phTmlNfc_replay.h>
+#include <phTmlNfc_virtual.h>
+
+static FILE* pReplayFile = NULL;
+/* Pipe carrying the replayed frames, [0] is read by TML */
+static int gReplayPipe[2] = {-1, -1};
+/* Next record of the capture, valid if bReplayNextValid */
+static phTmlNfc_CaptureRecord_t tReplayNext;
+static uint8_t aReplayNextData[PH_TMLNFC_CAPTURE_MAX_FRAME];
+static bool_t bReplayNextValid = false;
+static uint32_t dwReplayWrites = 0;
+static uint32_t dwReplayDiverged = 0;
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_replay_advance
+**
+** Description      Loads the next frame record of the capture, session
+**                  markers are skipped
+**
+** Parameters       None
+**
+** Returns          true if a record was loaded, false at the end of capture
+**
+*******************************************************************************/
+static bool_t phTmlNfc_replay_advance(void) {
+  bReplayNextValid = false;
+  while (1 == fread(&tReplayNext, sizeof(tReplayNext), 1, pReplayFile)) {
+    if ((tReplayNext.wLength > PH_TMLNFC_CAPTURE_MAX_FRAME) ||
+        ((tReplayNext.wLength > 0) &&
+         (1 != fread(aReplayNextData, tReplayNext.wLength, 1, pReplayFile)))) {
+      NXPLOG_TML_E("%s: corrupted capture", __func__);
+      return false;
+    }
+    if (phTmlNfc_e_CaptureSession != tReplayNext.bDirection) {
+      bReplayNextValid = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_replay_release_rx
+**
+** Description      Queues the captured NFCC frames up to the next captured
+**                  write
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_replay_release_rx(void) {
+  while (bReplayNextValid &&
+         (phTmlNfc_e_CaptureRx == tReplayNext.bDirection)) {
+    if (tReplayNext.bFlags & PH_TMLNFC_CAPTURE_TRUNCATED) {
+      NXPLOG_TML_E("%s: skipping truncated frame", __func__);
+    } else if (write(gReplayPipe[1], aReplayNextData, tReplayNext.wLength) <
+               0) {
+      NXPLOG_TML_E("%s: failed errno = 0x%x", __func__, errno);
+    }
+    phTmlNfc_replay_advance();
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_replay_close
+**
+** Description      Ends the replay and logs how far it matched the capture
+**
+** Parameters       pDevHandle - device handle
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_replay_close(void* pDevHandle) {
+  if (NULL != pDevHandle) {
+    close((intptr_t)pDevHandle);
+  }
+  if (gReplayPipe[1] >= 0) {
+    close(gReplayPipe[1]);
+  }
+  gReplayPipe[0] = -1;
+  gReplayPipe[1] = -1;
+  if (NULL != pReplayFile) {
+    NXPLOG_TML_D("Replay done, %u writes, %u diverged, %s", dwReplayWrites,
+                 dwReplayDiverged,
+                 bReplayNextValid ? "capture not exhausted" : "end of capture");
+    fclose(pReplayFile);
+    pReplayFile = NULL;
+  }
+  bReplayNextValid = false;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_replay_open_and_configure
+**
+** Description      Opens the capture file given in pConfig->pReplayFile and
+**                  releases the frames captured before the first write
+**
+** Parameters       pConfig     - hardware information
+**                  pLinkHandle - device handle
+**
+** Returns          NFC status:
+**                  NFCSTATUS_SUCCESS - open_and_configure operation success
+**                  NFCSTATUS_INVALID_DEVICE - capture cannot be replayed
+**
+*******************************************************************************/
+NFCSTATUS phTmlNfc_replay_open_and_configure(pphTmlNfc_Config_t pConfig,
+                                             void** pLinkHandle) {
+  phTmlNfc_CaptureFileHeader_t tFileHeader;
+
+  *pLinkHandle = NULL;
+  if (NULL == pConfig->pReplayFile) {
+    NXPLOG_TML_E("%s: no capture file", __func__);
+    return NFCSTATUS_INVALID_DEVICE;
+  }
+  NXPLOG_TML_D("Replaying %s", (const char*)pConfig->pReplayFile);
+  pReplayFile = fopen((const char*)pConfig->pReplayFile, "rbe");
+  if (NULL == pReplayFile) {
+    NXPLOG_TML_E("%s: open failed errno = 0x%x", __func__, errno);
+    return NFCSTATUS_INVALID_DEVICE;
+  }
+  if ((1 != fread(&tFileHeader, sizeof(tFileHeader), 1, pReplayFile)) ||
+      (PH_TMLNFC_CAPTURE_MAGIC != tFileHeader.dwMagic) ||
+      (sizeof(phTmlNfc_CaptureRecord_t) != tFileHeader.wRecordHeaderLen)) {
+    NXPLOG_TML_E("%s: not a capture file", __func__);
+    fclose(pReplayFile);
+    pReplayFile = NULL;
+    return NFCSTATUS_INVALID_DEVICE;
+  }
+  if (0 != pipe2(gReplayPipe, O_CLOEXEC)) {
+    NXPLOG_TML_E("%s: pipe failed errno = 0x%x", __func__, errno);
+    fclose(pReplayFile);
+    pReplayFile = NULL;
+    return NFCSTATUS_INVALID_DEVICE;
+  }
+  dwReplayWrites = 0;
+  dwReplayDiverged = 0;
+  *pLinkHandle = (void*)((intptr_t)gReplayPipe[0]);
+
+  phTmlNfc_replay_advance();
+  phTmlNfc_replay_release_rx();
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_replay_write
+**
+** Description      Matches a frame written by TML with the next captured
+**                  write and releases the NFCC frames that followed it
+**
+** Parameters       pDevHandle      - valid device handle
+**                  pBuffer         - frame written
+**                  nNbBytesToWrite - frame length
+**
+** Returns          numWrote   - number of successfully written bytes
+**                  -1         - write operation failure
+**
+*******************************************************************************/
+int phTmlNfc_replay_write(void* pDevHandle, uint8_t* pBuffer,
+                          int nNbBytesToWrite) {
+  int nCompare;
+
+  if (NULL == pDevHandle) {
+    return -1;
+  }
+  dwReplayWrites++;
+  if (!bReplayNextValid) {
+    NXPLOG_TML_E("%s: capture exhausted", __func__);
+    return nNbBytesToWrite;
+  }
+  nCompare = (nNbBytesToWrite < tReplayNext.wLength) ? nNbBytesToWrite
+                                                     : tReplayNext.wLength;
+  if (((0 == (tReplayNext.bFlags & PH_TMLNFC_CAPTURE_TRUNCATED)) &&
+       (nNbBytesToWrite != tReplayNext.wLength)) ||
+      (0 != memcmp(pBuffer, aReplayNextData, nCompare))) {
+    dwReplayDiverged++;
+    NXPLOG_TML_E("%s: write %u differs from capture", __func__,
+                 dwReplayWrites);
+  }
+  phTmlNfc_replay_advance();
+  phTmlNfc_replay_release_rx();
+  return nNbBytesToWrite;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_replay_reset
+**
+** Description      VEN toggles are accepted and have no effect on the replay.
+**                  Download mode (level 2) is not supported.
+**
+** Parameters       pDevHandle     - valid device handle
+**                  level          - reset level
+**
+** Returns           0   - reset operation success
+**                  -1   - reset operation failure
+**
+*******************************************************************************/
+int phTmlNfc_replay_reset(void* pDevHandle, long level) {
+  if ((NULL == pDevHandle) || (level > 1)) {
+    return -1;
+  }
+  return 0;
+}
+
+const phTmlNfc_Transport_t gphTmlNfc_ReplayTransport = {
+    "replay",
+    phTmlNfc_replay_open_and_configure,
+    phTmlNfc_virtual_read,
+    phTmlNfc_replay_write,
+    phTmlNfc_replay_reset,
+    phTmlNfc_replay_close,
+    NULL,
+};
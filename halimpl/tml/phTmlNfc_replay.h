@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML capture replay transport. Plays the frames read from the NFCC in a
+ * capture file back to TML, each burst released by the write of the frame
+ * that preceded it in the capture.
+ */
+#ifndef PHTMLNFC_REPLAY_H
+#define PHTMLNFC_REPLAY_H
+
+#include <phNfcTypes.h>
+#include <phTmlNfc.h>
+
+/* Function declarations */
+void phTmlNfc_replay_close(void* pDevHandle);
+NFCSTATUS phTmlNfc_replay_open_and_configure(pphTmlNfc_Config_t pConfig,
+                                             void** pLinkHandle);
+int phTmlNfc_replay_write(void* pDevHandle, uint8_t* pBuffer,
+                          int nNbBytesToWrite);
+int phTmlNfc_replay_reset(void* pDevHandle, long level);
+
+/* Transport backend replaying a capture file */
+extern const phTmlNfc_Transport_t gphTmlNfc_ReplayTransport;
+
+#endif /* PHTMLNFC_REPLAY_H */
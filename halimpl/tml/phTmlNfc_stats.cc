@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML NCI command statistics.
+ *
+ * The writer stamps a command when it starts writing it, the reader closes
+ * the round trip when the matching response has been read. NCI allows a
+ * single pending command, so one stamp is kept. Statistics survive TML
+ * re-initialization and are only cleared by phTmlNfc_ResetNciStats.
+ */
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <phNxpLog.h>
+#include <phTmlNfc_stats.h>
+
+#define STATS_HEADER_LEN 3
+#define STATS_MT_MASK 0xE0
+#define STATS_MT_CMD 0x20
+#define STATS_MT_RSP 0x40
+#define STATS_GID_MASK 0x0F
+#define STATS_OID_MASK 0x3F
+
+/* Statistics of each opcode seen so far, in order of first use */
+static phTmlNfc_NciStats_t gNciStats[PH_TMLNFC_STATS_MAX_OPS];
+static uint8_t bNciStatsCount = 0;
+/* Command waiting for its response */
+static phTmlNfc_NciStats_t* pPendingOp = NULL;
+static struct timespec tPendingStart;
+/* Set by phTmlNfc_Write, cleared once the new packet has been stamped */
+static bool_t bFreshWrite = false;
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_StatsLookup
+**
+** Description      Finds the statistics of an opcode, allocating them on first
+**                  use. Caller holds statsMutex.
+**
+** Parameters       bGid - group id
+**                  bOid - opcode id
+**
+** Returns          Statistics entry, NULL if the table is full
+**
+*******************************************************************************/
+static phTmlNfc_NciStats_t* phTmlNfc_StatsLookup(uint8_t bGid, uint8_t bOid) {
+  uint8_t i;
+
+  for (i = 0; i < bNciStatsCount; i++) {
+    if ((gNciStats[i].bGid == bGid) && (gNciStats[i].bOid == bOid)) {
+      return &gNciStats[i];
+    }
+  }
+  if (bNciStatsCount >= PH_TMLNFC_STATS_MAX_OPS) {
+    return NULL;
+  }
+  memset(&gNciStats[bNciStatsCount], 0x00, sizeof(phTmlNfc_NciStats_t));
+  gNciStats[bNciStatsCount].bGid = bGid;
+  gNciStats[bNciStatsCount].bOid = bOid;
+  return &gNciStats[bNciStatsCount++];
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_StatsPercentile
+**
+** Description      Computes a percentile from the histogram of an opcode
+**
+** Parameters       pOp      - statistics entry
+**                  bPercent - percentile to compute
+**
+** Returns          Upper bound of the bucket holding the percentile, capped by
+**                  the longest round trip
+**
+*******************************************************************************/
+static uint32_t phTmlNfc_StatsPercentile(const phTmlNfc_NciStats_t* pOp,
+                                         uint8_t bPercent) {
+  uint64_t qwRank = ((uint64_t)pOp->dwCount * bPercent + 99) / 100;
+  uint64_t qwSeen = 0;
+  uint32_t dwBound;
+  uint8_t k;
+
+  for (k = 0; k < PH_TMLNFC_STATS_BUCKETS; k++) {
+    qwSeen += pOp->aHistogram[k];
+    if ((qwSeen >= qwRank) && (qwSeen > 0)) {
+      break;
+    }
+  }
+  dwBound = (k >= PH_TMLNFC_STATS_BUCKETS - 1) ? pOp->dwMaxUs
+                                               : ((2U << k) - 1);
+  return (dwBound < pOp->dwMaxUs) ? dwBound : pOp->dwMaxUs;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_StatsWriteQueued
+**
+** Description      Marks the next packet written as a new request, as opposed
+**                  to a retransmission of the pending one
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_StatsWriteQueued(void) {
+  pthread_mutex_lock(&statsMutex);
+  bFreshWrite = true;
+  pthread_mutex_unlock(&statsMutex);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_StatsWriteStart
+**
+** Description      Stamps a command about to be written. A packet that is not
+**                  a new request is a retransmission of the pending command.
+**
+** Parameters       pBuffer - packet to be written
+**                  wLength - packet length
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_StatsWriteStart(const uint8_t* pBuffer, uint16_t wLength) {
+  pthread_mutex_lock(&statsMutex);
+  if (!bFreshWrite) {
+    if (NULL != pPendingOp) {
+      pPendingOp->dwRetransmissions++;
+    }
+  } else if ((wLength >= STATS_HEADER_LEN) &&
+             (STATS_MT_CMD == (pBuffer[0] & STATS_MT_MASK))) {
+    bFreshWrite = false;
+    if (NULL != pPendingOp) {
+      pPendingOp->dwUnanswered++;
+    }
+    pPendingOp = phTmlNfc_StatsLookup(pBuffer[0] & STATS_GID_MASK,
+                                      pBuffer[1] & STATS_OID_MASK);
+    clock_gettime(CLOCK_MONOTONIC, &tPendingStart);
+  } else {
+    /* Data packets are not answered by a response */
+    bFreshWrite = false;
+  }
+  pthread_mutex_unlock(&statsMutex);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_StatsWriteRetry
+**
+** Description      Counts a write of the pending command retried after a bus
+**                  failure
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_StatsWriteRetry(void) {
+  pthread_mutex_lock(&statsMutex);
+  if (NULL != pPendingOp) {
+    pPendingOp->dwWriteRetries++;
+  }
+  pthread_mutex_unlock(&statsMutex);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_StatsReadDone
+**
+** Description      Closes the round trip of the pending command if the packet
+**                  read is its response
+**
+** Parameters       pBuffer - packet read from the NFCC
+**                  wLength - packet length
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_StatsReadDone(const uint8_t* pBuffer, uint16_t wLength) {
+  struct timespec tNow;
+  uint64_t qwUs;
+  uint32_t dwUs;
+  uint8_t k = 0;
+
+  if ((wLength < STATS_HEADER_LEN) ||
+      (STATS_MT_RSP != (pBuffer[0] & STATS_MT_MASK))) {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &tNow);
+  pthread_mutex_lock(&statsMutex);
+  if ((NULL != pPendingOp) &&
+      (pPendingOp->bGid == (pBuffer[0] & STATS_GID_MASK)) &&
+      (pPendingOp->bOid == (pBuffer[1] & STATS_OID_MASK))) {
+    qwUs = ((uint64_t)(tNow.tv_sec - tPendingStart.tv_sec) * 1000000000ULL +
+            tNow.tv_nsec - tPendingStart.tv_nsec) /
+           1000;
+    dwUs = (qwUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)qwUs;
+    while ((k < PH_TMLNFC_STATS_BUCKETS - 1) && ((dwUs >> (k + 1)) != 0)) {
+      k++;
+    }
+    pPendingOp->aHistogram[k]++;
+    pPendingOp->dwCount++;
+    if (dwUs > pPendingOp->dwMaxUs) {
+      pPendingOp->dwMaxUs = dwUs;
+    }
+    pPendingOp = NULL;
+  }
+  pthread_mutex_unlock(&statsMutex);
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_GetNciStats
+**
+** Description      Copies the statistics of the opcodes seen so far and
+**                  computes their percentiles
+**
+** Parameters       pStats      - array receiving the statistics
+**                  bMaxEntries - number of entries in pStats
+**
+** Returns          Number of entries filled
+**
+*******************************************************************************/
+uint8_t phTmlNfc_GetNciStats(phTmlNfc_NciStats_t* pStats, uint8_t bMaxEntries) {
+  uint8_t i;
+
+  if (NULL == pStats) {
+    return 0;
+  }
+  pthread_mutex_lock(&statsMutex);
+  for (i = 0; (i < bNciStatsCount) && (i < bMaxEntries); i++) {
+    pStats[i] = gNciStats[i];
+    pStats[i].dwP50Us = phTmlNfc_StatsPercentile(&gNciStats[i], 50);
+    pStats[i].dwP99Us = phTmlNfc_StatsPercentile(&gNciStats[i], 99);
+  }
+  pthread_mutex_unlock(&statsMutex);
+  return i;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_ResetNciStats
+**
+** Description      Clears all NCI command statistics
+**
+** Parameters       None
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_ResetNciStats(void) {
+  pthread_mutex_lock(&statsMutex);
+  bNciStatsCount = 0;
+  pPendingOp = NULL;
+  bFreshWrite = false;
+  pthread_mutex_unlock(&statsMutex);
+}
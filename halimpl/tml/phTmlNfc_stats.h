@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML NCI command statistics. Every command written to the NFCC is stamped
+ * on CLOCK_MONOTONIC and matched with its response by GID/OID as soon as the
+ * response is read from the NFCC.
+ */
+#ifndef PHTMLNFC_STATS_H
+#define PHTMLNFC_STATS_H
+
+#include <phNfcTypes.h>
+
+/* Number of distinct GID/OID pairs tracked, further opcodes are dropped */
+#define PH_TMLNFC_STATS_MAX_OPS (0x20)
+/* Histogram bucket k counts round trips of [2^k, 2^(k+1)) microseconds, the
+ * last bucket everything above */
+#define PH_TMLNFC_STATS_BUCKETS (0x14)
+
+/*
+ * Round trip statistics of one NCI command opcode
+ */
+typedef struct phTmlNfc_NciStats {
+  uint8_t bGid;               /* Group id of the command */
+  uint8_t bOid;               /* Opcode id of the command */
+  uint32_t dwCount;           /* Responses matched */
+  uint32_t dwP50Us;           /* Median round trip, bucket upper bound */
+  uint32_t dwP99Us;           /* 99th percentile round trip, bucket upper
+                                 bound */
+  uint32_t dwMaxUs;           /* Longest round trip */
+  uint32_t dwRetransmissions; /* Retransmissions on timeout */
+  uint32_t dwWriteRetries;    /* Writes retried after a bus failure */
+  uint32_t dwUnanswered;      /* Commands superseded without a response */
+  uint32_t aHistogram[PH_TMLNFC_STATS_BUCKETS]; /* Round trip distribution */
+} phTmlNfc_NciStats_t;
+
+/* Function declarations */
+void phTmlNfc_StatsWriteQueued(void);
+void phTmlNfc_StatsWriteStart(const uint8_t* pBuffer, uint16_t wLength);
+void phTmlNfc_StatsWriteRetry(void);
+void phTmlNfc_StatsReadDone(const uint8_t* pBuffer, uint16_t wLength);
+uint8_t phTmlNfc_GetNciStats(phTmlNfc_NciStats_t* pStats, uint8_t bMaxEntries);
+void phTmlNfc_ResetNciStats(void);
+
+#endif /* PHTMLNFC_STATS_H */
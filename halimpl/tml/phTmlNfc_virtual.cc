@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML virtual NFCC transport.
+ *
+ * Every command written by TML is answered by a scripted NCI 2.0 NFCC. The
+ * answers are queued into a pipe whose read end is handed to TML as device
+ * handle, so the reader threads and the event loop wait on it exactly as on
+ * the PN54X device node. Firmware download mode is not emulated.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <errno.h>
+#include <string.h>
+
+#include <phNxpLog.h>
+#include <phTmlNfc_virtual.h>
+#include <phNfcStatus.h>
+
+#define VIRTUAL_HEADER_LEN 3
+#define VIRTUAL_LEN_OFFSET 2
+#define VIRTUAL_MAX_PAYLOAD 0xFF
+
+/* NCI message types and group ids handled by the virtual NFCC */
+#define VIRTUAL_MT_DATA 0x00
+#define VIRTUAL_MT_CMD 0x20
+#define VIRTUAL_MT_RSP 0x40
+#define VIRTUAL_MT_NTF 0x60
+#define VIRTUAL_MT_MASK 0xE0
+#define VIRTUAL_GID_MASK 0x0F
+#define VIRTUAL_OID_MASK 0x3F
+#define VIRTUAL_CONN_MASK 0x0F
+#define VIRTUAL_GID_CORE 0x00
+#define VIRTUAL_GID_RF 0x01
+#define VIRTUAL_GID_NFCEE 0x02
+
+#define VIRTUAL_CORE_RESET 0x00
+#define VIRTUAL_CORE_INIT 0x01
+#define VIRTUAL_CORE_GET_CONFIG 0x03
+#define VIRTUAL_CORE_CONN_CREATE 0x04
+#define VIRTUAL_CORE_CONN_CREDITS 0x06
+#define VIRTUAL_RF_DISCOVER 0x03
+#define VIRTUAL_RF_INTF_ACTIVATED 0x05
+#define VIRTUAL_RF_DEACTIVATE 0x06
+#define VIRTUAL_NFCEE_DISCOVER 0x00
+
+/* Version reported in CORE_RESET_NTF */
+#define VIRTUAL_NCI_VERSION 0x20
+#define VIRTUAL_MANUFACTURER_NXP 0x04
+#define VIRTUAL_HW_VERSION 0x98
+#define VIRTUAL_ROM_VERSION 0x12
+#define VIRTUAL_FW_MAJOR_VERSION 0x11
+#define VIRTUAL_FW_MINOR_VERSION 0x10
+
+/* Pipe carrying the NFCC output, [0] is read by TML */
+static int gVirtualPipe[2] = {-1, -1};
+/* Set while the emulated tag is activated on the static RF connection */
+static bool_t bVirtualRfActive = false;
+
+/* NFC-A ISO-DEP tag reported in RF_INTF_ACTIVATED_NTF */
+static const uint8_t gVirtualActivatedNtf[] = {
+    0x01,                                     /* RF discovery id */
+    0x02,                                     /* ISO-DEP RF interface */
+    0x04,                                     /* ISO-DEP protocol */
+    0x00,                                     /* NFC-A passive poll */
+    VIRTUAL_MAX_PAYLOAD,                      /* Max data packet payload */
+    0x01,                                     /* Initial credits */
+    0x0C,                                     /* Tech specific params len */
+    0x44, 0x00,                               /* SENS_RES */
+    0x07, 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, /* NFCID1 */
+    0x66, 0x01, 0x20,                         /* SEL_RES */
+    0x00,                                     /* Data exchange tech and mode */
+    0x00, 0x00,                               /* Tx and Rx bit rates */
+    0x06, 0x05, 0x05, 0x78, 0x80, 0x70, 0x02  /* RATS response */
+};
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_send
+**
+** Description      Queues one packet sent by the virtual NFCC. Packets never
+**                  exceed PIPE_BUF, so each one is written atomically.
+**
+** Parameters       bHdr0    - first header octet (MT, PBF and GID or conn id)
+**                  bHdr1    - second header octet (OID or RFU)
+**                  pPayload - packet payload
+**                  bLen     - payload length
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_virtual_send(uint8_t bHdr0, uint8_t bHdr1,
+                                  const uint8_t* pPayload, uint8_t bLen) {
+  uint8_t aPacket[VIRTUAL_HEADER_LEN + VIRTUAL_MAX_PAYLOAD];
+
+  aPacket[0] = bHdr0;
+  aPacket[1] = bHdr1;
+  aPacket[VIRTUAL_LEN_OFFSET] = bLen;
+  if (bLen > 0) {
+    memcpy(&aPacket[VIRTUAL_HEADER_LEN], pPayload, bLen);
+  }
+  if (write(gVirtualPipe[1], aPacket, VIRTUAL_HEADER_LEN + bLen) < 0) {
+    NXPLOG_TML_E("%s: failed errno = 0x%x", __func__, errno);
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_send_ok
+**
+** Description      Sends a response carrying only STATUS_OK
+**
+** Parameters       bGid - group id of the command
+**                  bOid - opcode id of the command
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_virtual_send_ok(uint8_t bGid, uint8_t bOid) {
+  static const uint8_t aStatusOk[] = {0x00};
+
+  phTmlNfc_virtual_send(VIRTUAL_MT_RSP | bGid, bOid, aStatusOk,
+                        sizeof(aStatusOk));
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_core_cmd
+**
+** Description      Answers an NCI core command
+**
+** Parameters       bOid     - opcode id of the command
+**                  pPayload - command payload
+**                  bLen     - payload length
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_virtual_core_cmd(uint8_t bOid, const uint8_t* pPayload,
+                                      uint8_t bLen) {
+  switch (bOid) {
+    case VIRTUAL_CORE_RESET: {
+      uint8_t aNtf[] = {0x02, /* Reset triggered by CORE_RESET_CMD */
+                        0x00, /* Configuration kept */
+                        VIRTUAL_NCI_VERSION, VIRTUAL_MANUFACTURER_NXP,
+                        0x04, /* Manufacturer specific info length */
+                        VIRTUAL_HW_VERSION, VIRTUAL_ROM_VERSION,
+                        VIRTUAL_FW_MAJOR_VERSION, VIRTUAL_FW_MINOR_VERSION};
+      if (bLen > 0) {
+        aNtf[1] = pPayload[0];
+      }
+      bVirtualRfActive = false;
+      phTmlNfc_virtual_send_ok(VIRTUAL_GID_CORE, bOid);
+      phTmlNfc_virtual_send(VIRTUAL_MT_NTF | VIRTUAL_GID_CORE, bOid, aNtf,
+                            sizeof(aNtf));
+      break;
+    }
+    case VIRTUAL_CORE_INIT: {
+      static const uint8_t aRsp[] = {
+          0x00,                   /* Status */
+          0x00, 0x02, 0x00, 0x00, /* NFCC features */
+          0x04,                   /* Max logical connections */
+          0x00, 0x02,             /* Max routing table size */
+          VIRTUAL_MAX_PAYLOAD,    /* Max control packet payload */
+          VIRTUAL_MAX_PAYLOAD,    /* Max HCI data packet payload */
+          0x01,                   /* HCI connection credits */
+          0x00, 0x01,             /* Max NFC-V RF frame size */
+          0x02,                   /* Number of RF interfaces */
+          0x01, 0x00,             /* Frame RF interface, no extension */
+          0x02, 0x00              /* ISO-DEP RF interface, no extension */
+      };
+      phTmlNfc_virtual_send(VIRTUAL_MT_RSP | VIRTUAL_GID_CORE, bOid, aRsp,
+                            sizeof(aRsp));
+      break;
+    }
+    case VIRTUAL_CORE_GET_CONFIG: {
+      static const uint8_t aRsp[] = {0x00, 0x00}; /* No parameter returned */
+      phTmlNfc_virtual_send(VIRTUAL_MT_RSP | VIRTUAL_GID_CORE, bOid, aRsp,
+                            sizeof(aRsp));
+      break;
+    }
+    case VIRTUAL_CORE_CONN_CREATE: {
+      static const uint8_t aRsp[] = {0x00, VIRTUAL_MAX_PAYLOAD, 0x01, 0x01};
+      phTmlNfc_virtual_send(VIRTUAL_MT_RSP | VIRTUAL_GID_CORE, bOid, aRsp,
+                            sizeof(aRsp));
+      break;
+    }
+    default:
+      phTmlNfc_virtual_send_ok(VIRTUAL_GID_CORE, bOid);
+      break;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_rf_cmd
+**
+** Description      Answers an NCI RF management command. Discovery polling
+**                  for NFC-A activates the emulated ISO-DEP tag.
+**
+** Parameters       bOid     - opcode id of the command
+**                  pPayload - command payload
+**                  bLen     - payload length
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_virtual_rf_cmd(uint8_t bOid, const uint8_t* pPayload,
+                                    uint8_t bLen) {
+  uint8_t bIndex;
+  bool_t bPollA = false;
+
+  phTmlNfc_virtual_send_ok(VIRTUAL_GID_RF, bOid);
+  if (VIRTUAL_RF_DISCOVER == bOid) {
+    /* Configurations are (tech and mode, frequency) pairs */
+    for (bIndex = 1; (bLen > 0) && (bIndex + 1 < bLen) &&
+                     (bIndex < 1 + 2 * pPayload[0]);
+         bIndex += 2) {
+      if (0x00 == pPayload[bIndex]) {
+        bPollA = true;
+      }
+    }
+    if (bPollA) {
+      bVirtualRfActive = true;
+      phTmlNfc_virtual_send(VIRTUAL_MT_NTF | VIRTUAL_GID_RF,
+                            VIRTUAL_RF_INTF_ACTIVATED, gVirtualActivatedNtf,
+                            sizeof(gVirtualActivatedNtf));
+    }
+  } else if ((VIRTUAL_RF_DEACTIVATE == bOid) && (bLen > 0)) {
+    uint8_t aNtf[] = {pPayload[0], 0x00}; /* Deactivated on DH request */
+    bVirtualRfActive = false;
+    phTmlNfc_virtual_send(VIRTUAL_MT_NTF | VIRTUAL_GID_RF, bOid, aNtf,
+                          sizeof(aNtf));
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_data
+**
+** Description      Consumes a data packet. The credit is returned at once and
+**                  the tag answers 90 00 to every frame on the RF connection.
+**
+** Parameters       bConnId - logical connection of the data packet
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phTmlNfc_virtual_data(uint8_t bConnId) {
+  static const uint8_t aApduOk[] = {0x90, 0x00};
+  uint8_t aNtf[] = {0x01, bConnId, 0x01}; /* One credit for bConnId */
+
+  phTmlNfc_virtual_send(VIRTUAL_MT_NTF | VIRTUAL_GID_CORE,
+                        VIRTUAL_CORE_CONN_CREDITS, aNtf, sizeof(aNtf));
+  if ((0x00 == bConnId) && bVirtualRfActive) {
+    phTmlNfc_virtual_send(VIRTUAL_MT_DATA | bConnId, 0x00, aApduOk,
+                          sizeof(aApduOk));
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_close
+**
+** Description      Closes the virtual NFCC
+**
+** Parameters       pDevHandle - device handle
+**
+** Returns          None
+**
+*******************************************************************************/
+void phTmlNfc_virtual_close(void* pDevHandle) {
+  if (NULL != pDevHandle) {
+    close((intptr_t)pDevHandle);
+  }
+  if (gVirtualPipe[1] >= 0) {
+    close(gVirtualPipe[1]);
+  }
+  gVirtualPipe[0] = -1;
+  gVirtualPipe[1] = -1;
+  bVirtualRfActive = false;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_open_and_configure
+**
+** Description      Creates the virtual NFCC. pConfig->pDevName is ignored.
+**
+** Parameters       pConfig     - hardware information
+**                  pLinkHandle - device handle
+**
+** Returns          NFC status:
+**                  NFCSTATUS_SUCCESS - open_and_configure operation success
+**                  NFCSTATUS_INVALID_DEVICE - device open operation failure
+**
+*******************************************************************************/
+NFCSTATUS phTmlNfc_virtual_open_and_configure(pphTmlNfc_Config_t pConfig,
+                                              void** pLinkHandle) {
+  UNUSED(pConfig);
+  NXPLOG_TML_D("Opening virtual NFCC");
+
+  if (0 != pipe2(gVirtualPipe, O_CLOEXEC)) {
+    NXPLOG_TML_E("%s: pipe failed errno = 0x%x", __func__, errno);
+    *pLinkHandle = NULL;
+    return NFCSTATUS_INVALID_DEVICE;
+  }
+  bVirtualRfActive = false;
+  *pLinkHandle = (void*)((intptr_t)gVirtualPipe[0]);
+
+  return NFCSTATUS_SUCCESS;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_read
+**
+** Description      Reads one packet sent by the virtual NFCC. Waits for up to
+**                  2 seconds like the I2C transport.
+**
+** Parameters       pDevHandle     - valid device handle
+**                  pBuffer        - buffer for read data
+**                  nNbBytesToRead - number of bytes requested to be read
+**
+** Returns          numRead   - number of successfully read bytes
+**                  -1        - read operation failure
+**
+*******************************************************************************/
+int phTmlNfc_virtual_read(void* pDevHandle, uint8_t* pBuffer,
+                          int nNbBytesToRead) {
+  int ret_Read;
+  int ret_Select;
+  int numRead = 0;
+  int nPayload;
+  struct timeval tv;
+  fd_set rfds;
+
+  if (NULL == pDevHandle) {
+    return -1;
+  }
+
+  FD_ZERO(&rfds);
+  FD_SET((intptr_t)pDevHandle, &rfds);
+  tv.tv_sec = 2;
+  tv.tv_usec = 1;
+
+  ret_Select =
+      select((int)((intptr_t)pDevHandle + (int)1), &rfds, NULL, NULL, &tv);
+  if (ret_Select <= 0) {
+    NXPLOG_TML_D("%s: select returned %d", __func__, ret_Select);
+    return -1;
+  }
+
+  /* Packets are queued whole, so header and payload are both available */
+  ret_Read = read((intptr_t)pDevHandle, pBuffer, VIRTUAL_HEADER_LEN);
+  if (ret_Read != VIRTUAL_HEADER_LEN) {
+    NXPLOG_TML_E("%s: header read failed %d", __func__, ret_Read);
+    return -1;
+  }
+  numRead = ret_Read;
+  nPayload = pBuffer[VIRTUAL_LEN_OFFSET];
+  if (numRead + nPayload > nNbBytesToRead) {
+    NXPLOG_TML_E("%s: packet exceeds buffer", __func__);
+    return -1;
+  }
+  while (nPayload > 0) {
+    ret_Read = read((intptr_t)pDevHandle, pBuffer + numRead, nPayload);
+    if (ret_Read <= 0) {
+      NXPLOG_TML_E("%s: payload read failed %d", __func__, ret_Read);
+      return -1;
+    }
+    numRead += ret_Read;
+    nPayload -= ret_Read;
+  }
+
+  return numRead;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_write
+**
+** Description      Hands one packet to the virtual NFCC, which queues its
+**                  answer before returning
+**
+** Parameters       pDevHandle      - valid device handle
+**                  pBuffer         - buffer for read data
+**                  nNbBytesToWrite - number of bytes requested to be written
+**
+** Returns          numWrote   - number of successfully written bytes
+**                  -1         - write operation failure
+**
+*******************************************************************************/
+int phTmlNfc_virtual_write(void* pDevHandle, uint8_t* pBuffer,
+                           int nNbBytesToWrite) {
+  uint8_t bMt;
+  uint8_t bLen;
+  const uint8_t* pPayload;
+
+  if (NULL == pDevHandle) {
+    return -1;
+  }
+  if (nNbBytesToWrite < VIRTUAL_HEADER_LEN) {
+    NXPLOG_TML_E("%s: truncated packet", __func__);
+    return -1;
+  }
+
+  bMt = pBuffer[0] & VIRTUAL_MT_MASK;
+  bLen = pBuffer[VIRTUAL_LEN_OFFSET];
+  pPayload = &pBuffer[VIRTUAL_HEADER_LEN];
+  if (bLen > nNbBytesToWrite - VIRTUAL_HEADER_LEN) {
+    bLen = (uint8_t)(nNbBytesToWrite - VIRTUAL_HEADER_LEN);
+  }
+
+  if (VIRTUAL_MT_DATA == bMt) {
+    phTmlNfc_virtual_data(pBuffer[0] & VIRTUAL_CONN_MASK);
+  } else if (VIRTUAL_MT_CMD == bMt) {
+    uint8_t bGid = pBuffer[0] & VIRTUAL_GID_MASK;
+    uint8_t bOid = pBuffer[1] & VIRTUAL_OID_MASK;
+    if (VIRTUAL_GID_CORE == bGid) {
+      phTmlNfc_virtual_core_cmd(bOid, pPayload, bLen);
+    } else if (VIRTUAL_GID_RF == bGid) {
+      phTmlNfc_virtual_rf_cmd(bOid, pPayload, bLen);
+    } else if ((VIRTUAL_GID_NFCEE == bGid) &&
+               (VIRTUAL_NFCEE_DISCOVER == bOid)) {
+      static const uint8_t aRsp[] = {0x00, 0x00}; /* No NFCEE */
+      phTmlNfc_virtual_send(VIRTUAL_MT_RSP | bGid, bOid, aRsp, sizeof(aRsp));
+    } else {
+      phTmlNfc_virtual_send_ok(bGid, bOid);
+    }
+  } else {
+    NXPLOG_TML_E("%s: unexpected message type 0x%02x", __func__, bMt);
+  }
+
+  return nNbBytesToWrite;
+}
+
+/*******************************************************************************
+**
+** Function         phTmlNfc_virtual_reset
+**
+** Description      Power cycles the virtual NFCC. Download mode (level 2) is
+**                  not supported.
+**
+** Parameters       pDevHandle     - valid device handle
+**                  level          - reset level
+**
+** Returns           0   - reset operation success
+**                  -1   - reset operation failure
+**
+*******************************************************************************/
+int phTmlNfc_virtual_reset(void* pDevHandle, long level) {
+  NXPLOG_TML_D("phTmlNfc_virtual_reset(), VEN level %ld", level);
+
+  if ((NULL == pDevHandle) || (level > 1)) {
+    return -1;
+  }
+  bVirtualRfActive = false;
+  return 0;
+}
+
+const phTmlNfc_Transport_t gphTmlNfc_VirtualTransport = {
+    "virtual",
+    phTmlNfc_virtual_open_and_configure,
+    phTmlNfc_virtual_read,
+    phTmlNfc_virtual_write,
+    phTmlNfc_virtual_reset,
+    phTmlNfc_virtual_close,
+    NULL,
+};
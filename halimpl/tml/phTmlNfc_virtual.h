@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TML virtual NFCC transport. Answers NCI commands in-process so that the
+ * HAL and TML can be exercised without a PN54X device.
+ */
+#ifndef PHTMLNFC_VIRTUAL_H
+#define PHTMLNFC_VIRTUAL_H
+
+#include <phNfcTypes.h>
+#include <phTmlNfc.h>
+
+/* Function declarations */
+void phTmlNfc_virtual_close(void* pDevHandle);
+NFCSTATUS phTmlNfc_virtual_open_and_configure(pphTmlNfc_Config_t pConfig,
+                                              void** pLinkHandle);
+int phTmlNfc_virtual_read(void* pDevHandle, uint8_t* pBuffer,
+                          int nNbBytesToRead);
+int phTmlNfc_virtual_write(void* pDevHandle, uint8_t* pBuffer,
+                           int nNbBytesToWrite);
+int phTmlNfc_virtual_reset(void* pDevHandle, long level);
+
+/* Transport backend emulating an NCI 2.0 NFCC */
+extern const phTmlNfc_Transport_t gphTmlNfc_VirtualTransport;
+
+#endif /* PHTMLNFC_VIRTUAL_H */
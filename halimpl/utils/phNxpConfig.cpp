@@ -53,7 +53,10 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <map>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <ctype.h>
 
 #include <phNxpLog.h>
 #include <android-base/properties.h>
@@ -89,6 +92,10 @@ const char tr_config_timestamp_path[] =
     "/data/vendor/nfc/libnfc-nxpTransitConfigState.bin";
 const char config_timestamp_path[] =
         "/data/vendor/nfc/libnfc-nxpConfigState.bin";
+const char block_config_state_path[] =
+        "/data/vendor/nfc/libnfc-nxpBlockState.bin";
+const char block_config_state_tmp_path[] =
+        "/data/vendor/nfc/libnfc-nxpBlockState.bin.tmp";
 const char default_nxp_config_path[] =
         "/vendor/etc/libnfc-nxp.conf";
 const char nxp_rf_config_path[] =
@@ -206,6 +213,9 @@ class CNfcConfig : public vector<const CNfcParam*> {
   bool isModified();
   bool isModified(const char* pName);
   void resetModified();
+  bool isBlockModified(const char* pSlot, uint32_t crc32);
+  void setBlockApplied(const char* pSlot, bool present, uint32_t crc32);
+  void updateBlockState(bool accepted);
 
   bool getValue(const char* name, char* pValue, size_t len) const;
   bool getValue(const char* name, unsigned long& rValue) const;
@@ -232,6 +242,12 @@ class CNfcConfig : public vector<const CNfcParam*> {
   uint32_t config_crc32_;
   uint32_t config_crc32_rf_;
   uint32_t config_crc32_tr_;
+  /* Digest of each configuration block last sent to the NFCC */
+  map<string, uint32_t> block_crc32_;
+  bool block_state_loaded_;
+  bool block_state_dirty_;
+
+  void readBlockState();
 
   string mCurrentFile;
 
@@ -797,7 +813,8 @@ bool CNfcConfig::readConfig(const char* name, bool bResetContent) {
 **
 *******************************************************************************/
 CNfcConfig::CNfcConfig() : mValidFile(true), mDynamConfig(true), config_crc32_(0),
-      config_crc32_rf_(0), config_crc32_tr_(0), state(0) {}
+      config_crc32_rf_(0), config_crc32_tr_(0), block_state_loaded_(false),
+      block_state_dirty_(false), state(0) {}
 
 /*******************************************************************************
 **
@@ -1238,6 +1255,155 @@ void CNfcConfig::resetModified() {
   }
 }
 
+/* Record of the block state file */
+typedef struct {
+  char name[32];
+  uint32_t crc32;
+} tBlockStateRecord;
+
+/*******************************************************************************
+**
+** Function:    isBlockStateRecordValid()
+**
+** Description: check that a record holds a configuration name, non empty,
+**              printable and NUL terminated
+**
+** Returns:     true if the record can be used
+**
+*******************************************************************************/
+static bool isBlockStateRecordValid(const tBlockStateRecord& record) {
+  size_t len = strnlen(record.name, sizeof(record.name));
+
+  if ((len == 0) || (len == sizeof(record.name))) return false;
+  for (size_t i = 0; i < len; i++) {
+    if (!isgraph((unsigned char)record.name[i])) return false;
+  }
+  return true;
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::readBlockState()
+**
+** Description: load the digests of the configuration blocks last sent to
+**              the NFCC, no block is known if the file cannot be read or
+**              holds an invalid record
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNfcConfig::readBlockState() {
+  tBlockStateRecord record;
+  size_t count;
+
+  block_crc32_.clear();
+  block_state_loaded_ = true;
+  block_state_dirty_ = false;
+  FILE* fd = fopen(block_config_state_path, "r");
+  if (fd == nullptr) {
+    ALOGD("%s No block state in '%s'", __func__, block_config_state_path);
+    return;
+  }
+  while ((count = fread(&record, 1, sizeof(record), fd)) == sizeof(record)) {
+    if (!isBlockStateRecordValid(record)) break;
+    block_crc32_[record.name] = record.crc32;
+  }
+  if ((count != 0) || ferror(fd)) {
+    ALOGE("%s Invalid block state in '%s', sending all blocks", __func__,
+          block_config_state_path);
+    block_crc32_.clear();
+  }
+  fclose(fd);
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::isBlockModified()
+**
+** Description: check if a configuration block differs from the one last
+**              sent to the NFCC in the same slot
+**
+** Returns:     true if the block has to be sent
+**
+*******************************************************************************/
+bool CNfcConfig::isBlockModified(const char* pSlot, uint32_t crc32) {
+  if (!block_state_loaded_) readBlockState();
+
+  map<string, uint32_t>::const_iterator it = block_crc32_.find(pSlot);
+  return (it == block_crc32_.end()) || (it->second != crc32);
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::setBlockApplied()
+**
+** Description: record the configuration block sent in a slot, or that the
+**              slot is empty. Recorded blocks are saved by
+**              updateBlockState().
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNfcConfig::setBlockApplied(const char* pSlot, bool present,
+                                 uint32_t crc32) {
+  if (!block_state_loaded_) readBlockState();
+
+  if (present) {
+    map<string, uint32_t>::iterator it = block_crc32_.find(pSlot);
+    if ((it != block_crc32_.end()) && (it->second == crc32)) return;
+    block_crc32_[pSlot] = crc32;
+  } else if (block_crc32_.erase(pSlot) == 0) {
+    return;
+  }
+  block_state_dirty_ = true;
+}
+
+/*******************************************************************************
+**
+** Function:    CNfcConfig::updateBlockState()
+**
+** Description: save the configuration blocks recorded since the last update
+**              if the NFCC accepted them, drop them otherwise. The file is
+**              written aside and renamed, so that it is either the previous
+**              or the new state after a power loss.
+**
+** Returns:     none
+**
+*******************************************************************************/
+void CNfcConfig::updateBlockState(bool accepted) {
+  tBlockStateRecord record;
+  bool written = true;
+
+  if (!block_state_dirty_) return;
+  block_state_dirty_ = false;
+  if (!accepted) {
+    block_state_loaded_ = false;
+    return;
+  }
+  FILE* fd = fopen(block_config_state_tmp_path, "w");
+  if (fd == nullptr) {
+    ALOGE("%s Unable to open file '%s' for writing", __func__,
+          block_config_state_tmp_path);
+    block_state_loaded_ = false;
+    return;
+  }
+  for (map<string, uint32_t>::const_iterator it = block_crc32_.begin();
+       it != block_crc32_.end(); ++it) {
+    memset(&record, 0, sizeof(record));
+    strlcpy(record.name, it->first.c_str(), sizeof(record.name));
+    record.crc32 = it->second;
+    if (fwrite(&record, sizeof(record), 1, fd) != 1) written = false;
+  }
+  if ((fflush(fd) != 0) || (fsync(fileno(fd)) != 0)) written = false;
+  if (fclose(fd) != 0) written = false;
+  if (!written ||
+      (rename(block_config_state_tmp_path, block_config_state_path) != 0)) {
+    ALOGE("%s Unable to save '%s'", __func__, block_config_state_path);
+    remove(block_config_state_tmp_path);
+    block_state_loaded_ = false;
+  }
+}
+
 /*******************************************************************************
 **
 ** Function:    CNfcParam::CNfcParam()
@@ -1429,3 +1595,53 @@ extern int updateNxpConfigTimestamp() {
   rConfig.resetModified();
   return 0;
 }
+
+/*******************************************************************************
+**
+** Function:    isNxpConfigBlockModified()
+**
+** Description: check if a configuration block differs from the one last
+**              accepted by the NFCC in the same slot. A slot names the
+**              setting the block applies, e.g. the selected TVDD block.
+**
+** Returns:     0 if not modified, 1 otherwise.
+**
+*******************************************************************************/
+extern int isNxpConfigBlockModified(const char* pSlot, const void* p_data,
+                                    long len) {
+  nxp::CNfcConfig& rConfig = nxp::CNfcConfig::GetInstance();
+  return rConfig.isBlockModified(pSlot, sparse_crc32(0, p_data, len));
+}
+
+/*******************************************************************************
+**
+** Function:    setNxpConfigBlockApplied()
+**
+** Description: record the configuration block sent in a slot, len is 0 if
+**              the slot is not configured
+**
+** Returns:     none
+**
+*******************************************************************************/
+extern void setNxpConfigBlockApplied(const char* pSlot, const void* p_data,
+                                     long len) {
+  nxp::CNfcConfig& rConfig = nxp::CNfcConfig::GetInstance();
+  rConfig.setBlockApplied(pSlot, (len > 0),
+                          (len > 0) ? sparse_crc32(0, p_data, len) : 0);
+}
+
+/*******************************************************************************
+**
+** Function:    updateNxpConfigBlockState()
+**
+** Description: save the configuration blocks recorded by
+**              setNxpConfigBlockApplied() if the NFCC accepted them
+**
+** Returns:     0
+**
+*******************************************************************************/
+extern int updateNxpConfigBlockState(bool accepted) {
+  nxp::CNfcConfig& rConfig = nxp::CNfcConfig::GetInstance();
+  rConfig.updateBlockState(accepted);
+  return 0;
+}
@@ -47,6 +47,11 @@ void resetNxpConfig(void);
 int isNxpRFConfigModified();
 int isNxpConfigModified();
 int updateNxpConfigTimestamp();
+int isNxpConfigBlockModified(const char* pSlot, const void* p_data,
+                             long len);
+void setNxpConfigBlockApplied(const char* pSlot, const void* p_data,
+                              long len);
+int updateNxpConfigBlockState(bool accepted);
 
 #define NAME_NXPLOG_EXTNS_LOGLEVEL "NXPLOG_EXTNS_LOGLEVEL"
 #define NAME_NXPLOG_NCIHAL_LOGLEVEL "NXPLOG_NCIHAL_LOGLEVEL"
@@ -92,6 +97,15 @@ int updateNxpConfigTimestamp();
 #define NAME_NXP_SWP_FULL_PWR_ON "NXP_SWP_FULL_PWR_ON"
 #define NAME_NXP_CORE_RF_FIELD "NXP_CORE_RF_FIELD"
 #define NAME_NXP_I2C_FRAGMENTATION_ENABLED "NXP_I2C_FRAGMENTATION_ENABLED"
+#define NAME_NXP_TML_EVENT_LOOP "NXP_TML_EVENT_LOOP"
+#define NAME_NXP_TML_READ_AHEAD "NXP_TML_READ_AHEAD"
+#define NAME_NXP_TML_TRANSPORT "NXP_TML_TRANSPORT"
+#define NAME_NXP_I2C_SINGLE_READ "NXP_I2C_SINGLE_READ"
+#define NAME_NXP_ASYNC_DATA_WRITE "NXP_ASYNC_DATA_WRITE"
+#define NAME_NXP_DATA_EXT_ALLOWLIST "NXP_DATA_EXT_ALLOWLIST"
+#define NAME_NXP_DATA_FAST_PATH_CONN_IDS "NXP_DATA_FAST_PATH_CONN_IDS"
+#define NAME_NXP_NCI_CAPTURE_FILE "NXP_NCI_CAPTURE_FILE"
+#define NAME_NXP_NCI_REPLAY_FILE "NXP_NCI_REPLAY_FILE"
 #define NAME_RF_STATUS_UPDATE_ENABLE "RF_STATUS_UPDATE_ENABLE"
 #define NAME_ISO_DEP_MAX_TRANSCEIVE "ISO_DEP_MAX_TRANSCEIVE"
 #define NAME_NFA_POLL_BAIL_OUT_MODE "NFA_POLL_BAIL_OUT_MODE"
@@ -36,6 +36,10 @@
 
 #include <phNxpNciHal_utils.h>
 #include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 #include <phNxpLog.h>
 
 /*********************** Link list functions **********************************/
@@ -261,6 +265,9 @@ void listDump(struct listHead* pList) {
 /****************** Semaphore and mutex helper functions **********************/
 
 static phNxpNciHal_Monitor_t* nxpncihal_monitor = NULL;
+/* Lock statistics, kept across monitor re-initialization */
+static phNxpNciHal_LockStats_t gLockStats[phNxpNciHal_e_LockCount];
+static pthread_mutex_t gLockStatsMutex = PTHREAD_MUTEX_INITIALIZER;
 
 /*******************************************************************************
 **
@@ -293,8 +300,25 @@ phNxpNciHal_Monitor_t* phNxpNciHal_init_monitor(void) {
       goto clean_and_return;
     }
 
-    if (listInit(&nxpncihal_monitor->sem_list) != 1) {
-      NXPLOG_NCIHAL_E("Semaphore List creation failed");
+    if (pthread_mutex_init(&nxpncihal_monitor->data_mutex, NULL) == -1) {
+      NXPLOG_NCIHAL_E("data_mutex creation returned 0x%08x", errno);
+      pthread_mutex_destroy(&nxpncihal_monitor->concurrency_mutex);
+      pthread_mutex_destroy(&nxpncihal_monitor->reentrance_mutex);
+      goto clean_and_return;
+    }
+
+    if (pthread_mutex_init(&nxpncihal_monitor->write_mutex, NULL) == -1) {
+      NXPLOG_NCIHAL_E("write_mutex creation returned 0x%08x", errno);
+      pthread_mutex_destroy(&nxpncihal_monitor->data_mutex);
+      pthread_mutex_destroy(&nxpncihal_monitor->concurrency_mutex);
+      pthread_mutex_destroy(&nxpncihal_monitor->reentrance_mutex);
+      goto clean_and_return;
+    }
+
+    if (pthread_mutex_init(&nxpncihal_monitor->sem_list_mutex, NULL) == -1) {
+      NXPLOG_NCIHAL_E("sem_list_mutex creation returned 0x%08x", errno);
+      pthread_mutex_destroy(&nxpncihal_monitor->write_mutex);
+      pthread_mutex_destroy(&nxpncihal_monitor->data_mutex);
       pthread_mutex_destroy(&nxpncihal_monitor->concurrency_mutex);
       pthread_mutex_destroy(&nxpncihal_monitor->reentrance_mutex);
       goto clean_and_return;
@@ -331,10 +355,12 @@ clean_and_return:
 void phNxpNciHal_cleanup_monitor(void) {
   if (nxpncihal_monitor != NULL) {
     pthread_mutex_destroy(&nxpncihal_monitor->concurrency_mutex);
+    pthread_mutex_destroy(&nxpncihal_monitor->data_mutex);
+    pthread_mutex_destroy(&nxpncihal_monitor->write_mutex);
     REENTRANCE_UNLOCK();
     pthread_mutex_destroy(&nxpncihal_monitor->reentrance_mutex);
     phNxpNciHal_releaseall_cb_data();
-    listDestroy(&nxpncihal_monitor->sem_list);
+    pthread_mutex_destroy(&nxpncihal_monitor->sem_list_mutex);
   }
 
   free(nxpncihal_monitor);
@@ -356,13 +382,293 @@ phNxpNciHal_Monitor_t* phNxpNciHal_get_monitor(void) {
   return nxpncihal_monitor;
 }
 
-/* Initialize the callback data */
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lock_now
+**
+** Description      Monotonic time used by the lock statistics
+**
+** Returns          Time in nanoseconds
+**
+*******************************************************************************/
+static uint64_t phNxpNciHal_lock_now(void) {
+  struct timespec tNow;
+
+  clock_gettime(CLOCK_MONOTONIC, &tNow);
+  return (uint64_t)tNow.tv_sec * 1000000000ULL + tNow.tv_nsec;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lock_mutex
+**
+** Description      Get the mutex of a monitor lock
+**
+** Returns          Pointer to mutex
+**
+*******************************************************************************/
+static pthread_mutex_t* phNxpNciHal_lock_mutex(phNxpNciHal_Monitor_t* pMonitor,
+                                               phNxpNciHal_LockId_t eLock) {
+  switch (eLock) {
+    case phNxpNciHal_e_ReentranceLock:
+      return &pMonitor->reentrance_mutex;
+    case phNxpNciHal_e_DataLock:
+      return &pMonitor->data_mutex;
+    case phNxpNciHal_e_WriteLock:
+      return &pMonitor->write_mutex;
+    case phNxpNciHal_e_ConcurrencyLock:
+    default:
+      return &pMonitor->concurrency_mutex;
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_lock
+**
+** Description      Take a monitor lock, measuring the wait if it is held by
+**                  another thread. Does nothing if there is no monitor.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_lock(phNxpNciHal_LockId_t eLock) {
+  phNxpNciHal_Monitor_t* pMonitor = phNxpNciHal_get_monitor();
+  pthread_mutex_t* pMutex;
+  uint64_t qwStart;
+  uint64_t qwWaitNs = 0;
+
+  if ((pMonitor == NULL) || (eLock >= phNxpNciHal_e_LockCount)) {
+    return;
+  }
+  pMutex = phNxpNciHal_lock_mutex(pMonitor, eLock);
+  if (pthread_mutex_trylock(pMutex) != 0) {
+    qwStart = phNxpNciHal_lock_now();
+    pthread_mutex_lock(pMutex);
+    /* Count a contended acquisition even if the wait rounds to 0 */
+    qwWaitNs = phNxpNciHal_lock_now() - qwStart + 1;
+  }
+  pMonitor->lock_wait_ns[eLock] = qwWaitNs;
+  pMonitor->lock_acquired_ns[eLock] = phNxpNciHal_lock_now();
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_unlock
+**
+** Description      Release a monitor lock and account its wait and hold
+**                  times. Does nothing if there is no monitor.
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_unlock(phNxpNciHal_LockId_t eLock) {
+  phNxpNciHal_Monitor_t* pMonitor = phNxpNciHal_get_monitor();
+  phNxpNciHal_LockStats_t* pStats;
+  uint64_t qwAcquired;
+  uint64_t qwWaitNs;
+  uint64_t qwHoldNs = 0;
+
+  if ((pMonitor == NULL) || (eLock >= phNxpNciHal_e_LockCount)) {
+    return;
+  }
+  qwAcquired = pMonitor->lock_acquired_ns[eLock];
+  qwWaitNs = pMonitor->lock_wait_ns[eLock];
+  if (qwAcquired != 0) {
+    qwHoldNs = phNxpNciHal_lock_now() - qwAcquired;
+  }
+  pMonitor->lock_acquired_ns[eLock] = 0;
+  pthread_mutex_unlock(phNxpNciHal_lock_mutex(pMonitor, eLock));
+
+  /* Release without a matching lock, as done by the monitor cleanup */
+  if (qwAcquired == 0) {
+    return;
+  }
+  pthread_mutex_lock(&gLockStatsMutex);
+  pStats = &gLockStats[eLock];
+  pStats->dwAcquired++;
+  if (qwWaitNs != 0) {
+    pStats->dwContended++;
+    pStats->qwWaitNs += qwWaitNs;
+    if (qwWaitNs > pStats->qwMaxWaitNs) {
+      pStats->qwMaxWaitNs = qwWaitNs;
+    }
+  }
+  pStats->qwHoldNs += qwHoldNs;
+  if (qwHoldNs > pStats->qwMaxHoldNs) {
+    pStats->qwMaxHoldNs = qwHoldNs;
+  }
+  pthread_mutex_unlock(&gLockStatsMutex);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_getLockStats
+**
+** Description      Get the contention statistics of a monitor lock, kept
+**                  across HAL sessions
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_getLockStats(phNxpNciHal_LockId_t eLock,
+                              phNxpNciHal_LockStats_t* pStats) {
+  if ((pStats == NULL) || (eLock >= phNxpNciHal_e_LockCount)) {
+    return;
+  }
+  pthread_mutex_lock(&gLockStatsMutex);
+  *pStats = gLockStats[eLock];
+  pthread_mutex_unlock(&gLockStatsMutex);
+}
+
+/* Completion object of the pool. The futex word counts the posts not yet
+ * waited for, as the value of a semaphore. */
+typedef struct phNxpNciHal_Completion {
+  uint32_t dwCount;
+} phNxpNciHal_Completion_t;
+
+/* Preallocated completion objects, kept across HAL sessions so that a
+ * waiter released by phNxpNciHal_cleanup_monitor still finds its object */
+static phNxpNciHal_Completion_t gCompletionPool[PHNXPNCIHAL_COMPLETION_POOL];
+/* One bit per free completion object */
+static uint32_t gCompletionFree = 0xFFFFFFFF;
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_get_completion
+**
+** Description      Take a completion object from the pool, without locking
+**
+** Returns          Completion object with no post pending, NULL if the pool
+**                  is empty
+**
+*******************************************************************************/
+static phNxpNciHal_Completion_t* phNxpNciHal_get_completion(void) {
+  uint32_t dwFree = __atomic_load_n(&gCompletionFree, __ATOMIC_RELAXED);
+  phNxpNciHal_Completion_t* pCompletion;
+  int i;
+
+  do {
+    if (dwFree == 0) {
+      return NULL;
+    }
+    i = __builtin_ctz(dwFree);
+  } while (!__atomic_compare_exchange_n(&gCompletionFree, &dwFree,
+                                        dwFree & ~(1U << i), true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+  pCompletion = &gCompletionPool[i];
+  __atomic_store_n(&pCompletion->dwCount, 0, __ATOMIC_RELAXED);
+  return pCompletion;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_put_completion
+**
+** Description      Return a completion object to the pool
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_put_completion(phNxpNciHal_Completion_t* pCompletion) {
+  __atomic_fetch_or(&gCompletionFree, 1U << (pCompletion - gCompletionPool),
+                    __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_sem_wait
+**
+** Description      Wait for the callback of the callback data, see SEM_WAIT
+**
+** Returns          0 if posted, -1 on error
+**
+*******************************************************************************/
+int phNxpNciHal_sem_wait(phNxpNciHal_Sem_t* pCallbackData) {
+  phNxpNciHal_Completion_t* pCompletion = pCallbackData->pCompletion;
+  uint32_t dwCount;
+
+  if (pCompletion == NULL) {
+    if (sem_wait(&pCallbackData->sem) == 0) return 0;
+    return (errno == EINTR) ? sem_wait(&pCallbackData->sem) : -1;
+  }
+  while (true) {
+    dwCount = __atomic_load_n(&pCompletion->dwCount, __ATOMIC_ACQUIRE);
+    while (dwCount != 0) {
+      if (__atomic_compare_exchange_n(&pCompletion->dwCount, &dwCount,
+                                      dwCount - 1, true, __ATOMIC_ACQUIRE,
+                                      __ATOMIC_ACQUIRE)) {
+        return 0;
+      }
+    }
+    if ((syscall(SYS_futex, &pCompletion->dwCount, FUTEX_WAIT_PRIVATE, 0,
+                 NULL, NULL, 0) == -1) &&
+        (errno != EAGAIN) && (errno != EINTR)) {
+      NXPLOG_NCIHAL_E("Completion wait failed (errno=0x%08x)", errno);
+      return -1;
+    }
+  }
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_sem_post
+**
+** Description      Signal the callback of the callback data, see SEM_POST
+**
+** Returns          0 if posted, -1 on error
+**
+*******************************************************************************/
+int phNxpNciHal_sem_post(phNxpNciHal_Sem_t* pCallbackData) {
+  phNxpNciHal_Completion_t* pCompletion = pCallbackData->pCompletion;
+
+  if (pCompletion == NULL) {
+    return sem_post(&pCallbackData->sem);
+  }
+  __atomic_fetch_add(&pCompletion->dwCount, 1, __ATOMIC_RELEASE);
+  syscall(SYS_futex, &pCompletion->dwCount, FUTEX_WAKE_PRIVATE, 1, NULL, NULL,
+          0);
+  return 0;
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_init_cb_data
+**
+** Description      Initialize the callback data and register it in the monitor
+**                  so that phNxpNciHal_releaseall_cb_data can release it. The
+**                  registry is linked through the callback data and the
+**                  completion object comes from a preallocated pool, nothing
+**                  is allocated. A semaphore is used once the pool is empty.
+**
+** Returns          NFCSTATUS_SUCCESS if initialized, NFCSTATUS_FAILED otherwise
+**
+*******************************************************************************/
 NFCSTATUS phNxpNciHal_init_cb_data(phNxpNciHal_Sem_t* pCallbackData,
                                    void* pContext) {
-  /* Create semaphore */
-  if (sem_init(&pCallbackData->sem, 0, 0) == -1) {
-    NXPLOG_NCIHAL_E("Semaphore creation failed (errno=0x%08x)", errno);
-    return NFCSTATUS_FAILED;
+  phNxpNciHal_Monitor_t* pMonitor = phNxpNciHal_get_monitor();
+  phNxpNciHal_Sem_t* pEntry;
+
+  /* The fields of a new callback data are not initialized, so an entry
+   * initialized again without cleanup is found by walking the registry,
+   * which only holds the few pending callbacks. It keeps its completion. */
+  pthread_mutex_lock(&pMonitor->sem_list_mutex);
+  for (pEntry = pMonitor->pSemList; pEntry != NULL; pEntry = pEntry->pNext) {
+    if (pEntry == pCallbackData) break;
+  }
+  pthread_mutex_unlock(&pMonitor->sem_list_mutex);
+
+  if ((pEntry != NULL) && (pCallbackData->pCompletion != NULL)) {
+    __atomic_store_n(&pCallbackData->pCompletion->dwCount, 0,
+                     __ATOMIC_RELAXED);
+  } else {
+    pCallbackData->pCompletion = phNxpNciHal_get_completion();
+    /* Create semaphore */
+    if ((pCallbackData->pCompletion == NULL) &&
+        (sem_init(&pCallbackData->sem, 0, 0) == -1)) {
+      NXPLOG_NCIHAL_E("Semaphore creation failed (errno=0x%08x)", errno);
+      return NFCSTATUS_FAILED;
+    }
   }
 
   /* Set default status value */
@@ -372,13 +678,46 @@ NFCSTATUS phNxpNciHal_init_cb_data(phNxpNciHal_Sem_t* pCallbackData,
   pCallbackData->pContext = pContext;
 
   /* Add to active semaphore list */
-  if (listAdd(&phNxpNciHal_get_monitor()->sem_list, pCallbackData) != 1) {
-    NXPLOG_NCIHAL_E("Failed to add the semaphore to the list");
+  if (pEntry == NULL) {
+    pthread_mutex_lock(&pMonitor->sem_list_mutex);
+    pCallbackData->pPrev = NULL;
+    pCallbackData->pNext = pMonitor->pSemList;
+    if (pMonitor->pSemList != NULL) {
+      pMonitor->pSemList->pPrev = pCallbackData;
+    }
+    pMonitor->pSemList = pCallbackData;
+    pCallbackData->bRegistered = true;
+    pthread_mutex_unlock(&pMonitor->sem_list_mutex);
   }
 
   return NFCSTATUS_SUCCESS;
 }
 
+/*******************************************************************************
+**
+** Function         phNxpNciHal_unlink_cb_data
+**
+** Description      Remove callback data from the monitor registry. Caller
+**                  holds sem_list_mutex.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_unlink_cb_data(phNxpNciHal_Monitor_t* pMonitor,
+                                       phNxpNciHal_Sem_t* pCallbackData) {
+  if (pCallbackData->pPrev != NULL) {
+    pCallbackData->pPrev->pNext = pCallbackData->pNext;
+  } else {
+    pMonitor->pSemList = pCallbackData->pNext;
+  }
+  if (pCallbackData->pNext != NULL) {
+    pCallbackData->pNext->pPrev = pCallbackData->pPrev;
+  }
+  pCallbackData->pNext = NULL;
+  pCallbackData->pPrev = NULL;
+  pCallbackData->bRegistered = false;
+}
+
 /*******************************************************************************
 **
 ** Function         phNxpNciHal_cleanup_cb_data
@@ -389,21 +728,26 @@ NFCSTATUS phNxpNciHal_init_cb_data(phNxpNciHal_Sem_t* pCallbackData,
 **
 *******************************************************************************/
 void phNxpNciHal_cleanup_cb_data(phNxpNciHal_Sem_t* pCallbackData) {
-  /* Destroy semaphore */
-  if (sem_destroy(&pCallbackData->sem)) {
+  phNxpNciHal_Monitor_t* pMonitor = phNxpNciHal_get_monitor();
+
+  /* Remove from active semaphore list, unless already released */
+  pthread_mutex_lock(&pMonitor->sem_list_mutex);
+  if (pCallbackData->bRegistered) {
+    phNxpNciHal_unlink_cb_data(pMonitor, pCallbackData);
+  }
+  pthread_mutex_unlock(&pMonitor->sem_list_mutex);
+
+  /* Return the completion object, or destroy the semaphore */
+  if (pCallbackData->pCompletion != NULL) {
+    phNxpNciHal_put_completion(pCallbackData->pCompletion);
+    pCallbackData->pCompletion = NULL;
+  } else if (sem_destroy(&pCallbackData->sem)) {
     NXPLOG_NCIHAL_E(
         "phNxpNciHal_cleanup_cb_data: Failed to destroy semaphore "
         "(errno=0x%08x)",
         errno);
   }
 
-  /* Remove from active semaphore list */
-  if (listRemove(&phNxpNciHal_get_monitor()->sem_list, pCallbackData) != 1) {
-    NXPLOG_NCIHAL_E(
-        "phNxpNciHal_cleanup_cb_data: Failed to remove semaphore from the "
-        "list");
-  }
-
   return;
 }
 
@@ -417,13 +761,16 @@ void phNxpNciHal_cleanup_cb_data(phNxpNciHal_Sem_t* pCallbackData) {
 **
 *******************************************************************************/
 void phNxpNciHal_releaseall_cb_data(void) {
+  phNxpNciHal_Monitor_t* pMonitor = phNxpNciHal_get_monitor();
   phNxpNciHal_Sem_t* pCallbackData;
 
-  while (listGetAndRemoveNext(&phNxpNciHal_get_monitor()->sem_list,
-                              (void**)&pCallbackData)) {
+  pthread_mutex_lock(&pMonitor->sem_list_mutex);
+  while ((pCallbackData = pMonitor->pSemList) != NULL) {
+    phNxpNciHal_unlink_cb_data(pMonitor, pCallbackData);
     pCallbackData->status = NFCSTATUS_FAILED;
-    sem_post(&pCallbackData->sem);
+    phNxpNciHal_sem_post(pCallbackData);
   }
+  pthread_mutex_unlock(&pMonitor->sem_list_mutex);
 
   return;
 }
@@ -432,44 +779,151 @@ void phNxpNciHal_releaseall_cb_data(void) {
 
 /**************************** Other functions *********************************/
 
+/* Packet trace ring, power of two */
+#define PACKET_TRACE_SLOTS (0x40)
+#define PACKET_TRACE_SLOT_MASK (PACKET_TRACE_SLOTS - 1)
+/* Bytes kept of each packet, enough for headers and the start of payload */
+#define PACKET_TRACE_MAX_BYTES (64)
+
+typedef struct phNxpNciHal_TraceSlot {
+  uint32_t dwSeq; /* Position + 1 once written, 0 while being written */
+  uint64_t qwTimestampNs; /* CLOCK_MONOTONIC */
+  uint16_t wLength;       /* Packet length, may exceed the bytes kept */
+  uint8_t bSend;          /* true if written to NFCC */
+  uint8_t aData[PACKET_TRACE_MAX_BYTES];
+} phNxpNciHal_TraceSlot_t;
+
+/* Last packets sent and received, oldest overwritten first */
+static phNxpNciHal_TraceSlot_t gPacketTrace[PACKET_TRACE_SLOTS];
+static uint32_t dwPacketTracePos = 0;
+
 /*******************************************************************************
 **
-** Function         phNxpNciHal_print_packet
+** Function         phNxpNciHal_hex_string
 **
-** Description      Print packet
+** Description      Format bytes as an hex string, pString holds len * 2 + 1
+**                  characters
 **
 ** Returns          None
 **
 *******************************************************************************/
-void phNxpNciHal_print_packet(const char* pString, const uint8_t* p_data,
-                              uint16_t len) {
+static void phNxpNciHal_hex_string(const uint8_t* p_data, uint16_t len,
+                                   char* pString) {
+  static const char kHexDigits[] = "0123456789ABCDEF";
   uint32_t i;
-  char print_buffer[len * 3 + 1];
 
-  memset(print_buffer, 0, sizeof(print_buffer));
   for (i = 0; i < len; i++) {
-    snprintf(&print_buffer[i * 2], 3, "%02X", p_data[i]);
-  }
-  if (0 == memcmp(pString, "SEND", 0x04)) {
-    NXPLOG_NCIX_D("len = %3d => %s", len, print_buffer);
-  } else if (0 == memcmp(pString, "RECV", 0x04)) {
-    NXPLOG_NCIR_D("len = %3d <= %s", len, print_buffer);
+    pString[i * 2] = kHexDigits[p_data[i] >> 4];
+    pString[i * 2 + 1] = kHexDigits[p_data[i] & 0x0F];
   }
+  pString[len * 2] = '\0';
+}
 
-  return;
+/*******************************************************************************
+**
+** Function         phNxpNciHal_trace_packet
+**
+** Description      Record a packet in the trace ring. Safe to call from any
+**                  thread, never blocks. A writer racing a full lap ahead
+**                  only makes the dump skip the slot.
+**
+** Returns          None
+**
+*******************************************************************************/
+static void phNxpNciHal_trace_packet(bool_t bSend, const uint8_t* p_data,
+                                     uint16_t len) {
+  phNxpNciHal_TraceSlot_t* pSlot;
+  struct timespec tNow;
+  uint32_t dwPos;
+
+  clock_gettime(CLOCK_MONOTONIC, &tNow);
+  dwPos = __atomic_fetch_add(&dwPacketTracePos, 1, __ATOMIC_RELAXED);
+  pSlot = &gPacketTrace[dwPos & PACKET_TRACE_SLOT_MASK];
+
+  __atomic_store_n(&pSlot->dwSeq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  pSlot->qwTimestampNs = (uint64_t)tNow.tv_sec * 1000000000ULL + tNow.tv_nsec;
+  pSlot->wLength = len;
+  pSlot->bSend = bSend;
+  memcpy(pSlot->aData, p_data,
+         (len < PACKET_TRACE_MAX_BYTES) ? len : PACKET_TRACE_MAX_BYTES);
+  __atomic_store_n(&pSlot->dwSeq, dwPos + 1, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+**
+** Function         phNxpNciHal_dump_packet_trace
+**
+** Description      Log the packets of the trace ring, oldest first. Packets
+**                  longer than the bytes kept are marked with "..".
+**
+** Returns          None
+**
+*******************************************************************************/
+void phNxpNciHal_dump_packet_trace(void) {
+  phNxpNciHal_TraceSlot_t tSlot;
+  char print_buffer[PACKET_TRACE_MAX_BYTES * 2 + 1];
+  uint32_t dwEnd = __atomic_load_n(&dwPacketTracePos, __ATOMIC_ACQUIRE);
+  uint32_t dwPos =
+      (dwEnd > PACKET_TRACE_SLOTS) ? (dwEnd - PACKET_TRACE_SLOTS) : 0;
+  uint16_t wKept;
+
+  NXPLOG_NCIHAL_E("Packet trace, %u packets", dwEnd);
+  for (; dwPos != dwEnd; dwPos++) {
+    phNxpNciHal_TraceSlot_t* pSlot =
+        &gPacketTrace[dwPos & PACKET_TRACE_SLOT_MASK];
+    if (__atomic_load_n(&pSlot->dwSeq, __ATOMIC_ACQUIRE) != dwPos + 1) {
+      continue;
+    }
+    memcpy(&tSlot, pSlot, sizeof(tSlot));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&pSlot->dwSeq, __ATOMIC_RELAXED) != dwPos + 1) {
+      /* Overwritten while copied */
+      continue;
+    }
+    wKept = (tSlot.wLength < PACKET_TRACE_MAX_BYTES) ? tSlot.wLength
+                                                     : PACKET_TRACE_MAX_BYTES;
+    phNxpNciHal_hex_string(tSlot.aData, wKept, print_buffer);
+    NXPLOG_NCIHAL_E("%llu.%06llu len = %3d %s %s%s",
+                    (unsigned long long)(tSlot.qwTimestampNs / 1000000000ULL),
+                    (unsigned long long)(tSlot.qwTimestampNs % 1000000000ULL) /
+                        1000,
+                    tSlot.wLength, tSlot.bSend ? "=>" : "<=", print_buffer,
+                    (wKept < tSlot.wLength) ? ".." : "");
+  }
 }
 
 /*******************************************************************************
 **
-** Function         phNxpNciHal_emergency_recovery
+** Function         phNxpNciHal_print_packet
 **
-** Description      Emergency recovery in case of no other way out
+** Description      Record a packet in the trace ring and print it if the
+**                  NCIX (SEND) or NCIR (RECV) debug level is enabled. The hex
+**                  string is only formatted when it is printed.
 **
 ** Returns          None
 **
 *******************************************************************************/
+void phNxpNciHal_print_packet(const char* pString, const uint8_t* p_data,
+                              uint16_t len) {
+  bool_t bSend = (strstr(pString, "SEND") != NULL);
 
-void phNxpNciHal_emergency_recovery(void) {
-  NXPLOG_NCIHAL_E("%s: abort()", __func__);
-  abort();
+  phNxpNciHal_trace_packet(bSend, p_data, len);
+
+  if (0 == memcmp(pString, "SEND", 0x04)) {
+    if (gLog_level.ncix_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL) {
+      char print_buffer[len * 2 + 1];
+      phNxpNciHal_hex_string(p_data, len, print_buffer);
+      NXPLOG_NCIX_D("len = %3d => %s", len, print_buffer);
+    }
+  } else if (0 == memcmp(pString, "RECV", 0x04)) {
+    if ((nfc_debug_enabled) ||
+        (gLog_level.ncir_log_level >= NXPLOG_LOG_DEBUG_LOGLEVEL)) {
+      char print_buffer[len * 2 + 1];
+      phNxpNciHal_hex_string(p_data, len, print_buffer);
+      NXPLOG_NCIR_D("len = %3d <= %s", len, print_buffer);
+    }
+  }
+
+  return;
 }
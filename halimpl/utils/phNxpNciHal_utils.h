@@ -56,26 +56,55 @@ struct listHead {
   pthread_mutex_t mutex;
 };
 
+/* Number of completion objects preallocated for the callback data */
+#define PHNXPNCIHAL_COMPLETION_POOL (32)
+
 /* Semaphore handling structure */
 typedef struct phNxpNciHal_Sem {
-  /* Semaphore used to wait for callback */
+  /* Semaphore used to wait for callback when no completion object of the
+   * pool is assigned, see phNxpNciHal_init_cb_data */
   sem_t sem;
 
+  /* Completion object taken from the pool, NULL if none */
+  struct phNxpNciHal_Completion* pCompletion;
+
   /* Used to store the status sent by the callback */
   NFCSTATUS status;
 
   /* Used to provide a local context to the callback */
   void* pContext;
 
+  /* Links in the monitor registry, valid while bRegistered is set */
+  struct phNxpNciHal_Sem* pNext;
+  struct phNxpNciHal_Sem* pPrev;
+  uint8_t bRegistered;
+
 } phNxpNciHal_Sem_t;
 
 /* Semaphore helper macros */
-#define SEM_WAIT(cb_data)                                                   \
-  ((sem_wait(&((cb_data).sem)) == 0) ? 0 : (errno == EINTR)                 \
-                                               ? sem_wait(&((cb_data).sem)) \
-                                               : -1)
-
-#define SEM_POST(p_cb_data) sem_post(&((p_cb_data)->sem))
+#define SEM_WAIT(cb_data) phNxpNciHal_sem_wait(&(cb_data))
+
+#define SEM_POST(p_cb_data) phNxpNciHal_sem_post(p_cb_data)
+
+/* Locks of the monitor, also index the lock statistics. When several are
+ * taken they are taken in this order. */
+typedef enum {
+  phNxpNciHal_e_ReentranceLock = 0, /* Client thread message dispatch */
+  phNxpNciHal_e_DataLock,           /* NCI data packet writes */
+  phNxpNciHal_e_ConcurrencyLock,    /* NCI command writes and sequences */
+  phNxpNciHal_e_WriteLock,          /* Single write pending in TML */
+  phNxpNciHal_e_LockCount
+} phNxpNciHal_LockId_t;
+
+/* Contention statistics of a monitor lock */
+typedef struct phNxpNciHal_LockStats {
+  uint32_t dwAcquired;  /* Number of times the lock was taken */
+  uint32_t dwContended; /* Number of times the lock was already held */
+  uint64_t qwWaitNs;    /* Total time spent waiting for the lock */
+  uint64_t qwMaxWaitNs; /* Longest wait */
+  uint64_t qwHoldNs;    /* Total time the lock was held */
+  uint64_t qwMaxHoldNs; /* Longest hold */
+} phNxpNciHal_LockStats_t;
 
 /* Semaphore and mutex monitor */
 typedef struct phNxpNciHal_Monitor {
@@ -85,8 +114,23 @@ typedef struct phNxpNciHal_Monitor {
   /* Mutex protecting native library against concurrency */
   pthread_mutex_t concurrency_mutex;
 
-  /* List used to track pending semaphores waiting for callback */
-  struct listHead sem_list;
+  /* Mutex serializing NCI data packet writes, independent of commands */
+  pthread_mutex_t data_mutex;
+
+  /* Mutex held while a packet is written to TML, which accepts a single
+   * pending write */
+  pthread_mutex_t write_mutex;
+
+  /* Acquisition time and wait of each lock, written by its holder */
+  uint64_t lock_acquired_ns[phNxpNciHal_e_LockCount];
+  uint64_t lock_wait_ns[phNxpNciHal_e_LockCount];
+
+  /* Mutex protecting the registry of pending semaphores */
+  pthread_mutex_t sem_list_mutex;
+
+  /* Registry of pending semaphores waiting for callback, linked through the
+   * callback data itself so registering does not allocate */
+  phNxpNciHal_Sem_t* pSemList;
 
 } phNxpNciHal_Monitor_t;
 
@@ -107,23 +151,24 @@ NFCSTATUS phNxpNciHal_init_cb_data(phNxpNciHal_Sem_t* pCallbackData,
                                    void* pContext);
 void phNxpNciHal_cleanup_cb_data(phNxpNciHal_Sem_t* pCallbackData);
 void phNxpNciHal_releaseall_cb_data(void);
+int phNxpNciHal_sem_wait(phNxpNciHal_Sem_t* pCallbackData);
+int phNxpNciHal_sem_post(phNxpNciHal_Sem_t* pCallbackData);
+void phNxpNciHal_lock(phNxpNciHal_LockId_t eLock);
+void phNxpNciHal_unlock(phNxpNciHal_LockId_t eLock);
+void phNxpNciHal_getLockStats(phNxpNciHal_LockId_t eLock,
+                              phNxpNciHal_LockStats_t* pStats);
 void phNxpNciHal_print_packet(const char* pString, const uint8_t* p_data,
                               uint16_t len);
-void phNxpNciHal_emergency_recovery(void);
+void phNxpNciHal_dump_packet_trace(void);
 
 /* Lock unlock helper macros */
-/* Lock unlock helper macros */
-#define REENTRANCE_LOCK()        \
-  if (phNxpNciHal_get_monitor()) \
-  pthread_mutex_lock(&phNxpNciHal_get_monitor()->reentrance_mutex)
-#define REENTRANCE_UNLOCK()      \
-  if (phNxpNciHal_get_monitor()) \
-  pthread_mutex_unlock(&phNxpNciHal_get_monitor()->reentrance_mutex)
-#define CONCURRENCY_LOCK()       \
-  if (phNxpNciHal_get_monitor()) \
-  pthread_mutex_lock(&phNxpNciHal_get_monitor()->concurrency_mutex)
-#define CONCURRENCY_UNLOCK()     \
-  if (phNxpNciHal_get_monitor()) \
-  pthread_mutex_unlock(&phNxpNciHal_get_monitor()->concurrency_mutex)
+#define REENTRANCE_LOCK() phNxpNciHal_lock(phNxpNciHal_e_ReentranceLock)
+#define REENTRANCE_UNLOCK() phNxpNciHal_unlock(phNxpNciHal_e_ReentranceLock)
+#define CONCURRENCY_LOCK() phNxpNciHal_lock(phNxpNciHal_e_ConcurrencyLock)
+#define CONCURRENCY_UNLOCK() phNxpNciHal_unlock(phNxpNciHal_e_ConcurrencyLock)
+#define DATA_LOCK() phNxpNciHal_lock(phNxpNciHal_e_DataLock)
+#define DATA_UNLOCK() phNxpNciHal_unlock(phNxpNciHal_e_DataLock)
+#define WRITE_LOCK() phNxpNciHal_lock(phNxpNciHal_e_WriteLock)
+#define WRITE_UNLOCK() phNxpNciHal_unlock(phNxpNciHal_e_WriteLock)
 
 #endif /* _PHNXPNCIHAL_UTILS_H_ */